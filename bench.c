@@ -0,0 +1,252 @@
+// Benchmark harness for the timetable generator.
+//
+// Generates seeded synthetic departments, then times loading, solving and
+// writing each one separately through the library interface. Build with:
+//
+//   gcc -O2 -o bench bench.c maincode.c -DTIMETABLE_LIBRARY -lpthread -lm
+//
+// Every run uses instance seed and solver seed 1..N, so two builds can be
+// compared on exactly the same inputs.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h> // For peak RSS
+#include "timetable.h"
+
+#define WEEK_CELLS 36 // Teaching cells per section: 6 days x 6 slots
+
+typedef struct {
+    int sections;
+    double tightness;         // Fraction of a section's week taken by required classes
+    double labFraction;       // Share of subjects that are 2-hour labs
+    int faculty;              // Size of the faculty pool
+    int facultyPerSubject;    // Faculty members listed on each subject
+} GeneratorOptions;
+
+// splitmix64, so instances only depend on the seed (the library symbols
+// are not static, so the bench uses its own names)
+uint64_t generatorNext(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+int generatorBelow(uint64_t *state, int n) {
+    return (int)(generatorNext(state) % (uint64_t)n);
+}
+
+// Write a synthetic department in the Subjects.txt format. Theory subjects
+// meet 3 times a week and labs once for 2 hours, the same defaults the
+// generator applies to real input. Returns the number of subjects.
+int generateInstance(const GeneratorOptions *gen, uint64_t seed, const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        printf("Cannot write instance file %s\n", filename);
+        return -1;
+    }
+
+    uint64_t state = seed;
+    int target = (int)(gen->tightness * WEEK_CELLS + 0.5);
+    int hours = 0;
+    int subjects = 0;
+    int picked[gen->facultyPerSubject > 0 ? gen->facultyPerSubject : 1];
+
+    while (hours < target) {
+        int lab = hours + 2 <= target &&
+                  (hours + 3 > target || generatorNext(&state) % 1000 < gen->labFraction * 1000);
+        hours += lab ? 2 : 3;
+        fprintf(fp, "%s%d,%d,", lab ? "LAB" : "SUB", subjects + 1, lab ? 2 : 1);
+
+        // Distinct faculty members drawn from the pool
+        int count = gen->facultyPerSubject < gen->faculty ? gen->facultyPerSubject : gen->faculty;
+        for (int i = 0; i < count; i++) {
+            int id;
+            int repeat;
+            do {
+                id = generatorBelow(&state, gen->faculty);
+                repeat = 0;
+                for (int j = 0; j < i; j++) {
+                    if (picked[j] == id) repeat = 1;
+                }
+            } while (repeat);
+            picked[i] = id;
+            fprintf(fp, "%sFaculty %d", i > 0 ? ";" : "", id + 1);
+        }
+        fprintf(fp, "\n");
+        subjects++;
+    }
+
+    fclose(fp);
+    return subjects;
+}
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long peakRssKilobytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Delete the files a run wrote into the scratch directory
+void cleanDirectory(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            char file[4096];
+            snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+            unlink(file);
+        }
+    }
+    closedir(dir);
+}
+
+void printUsage(const char *program) {
+    printf("Usage: %s [--seeds=N] [--sections=N] [--tightness=0..1] [--labs=0..1]\n"
+           "          [--faculty=N] [--faculty-per-subject=N]\n"
+           "          [--solver=greedy|backtrack|sat] [--order=dsatur|degree|duration]\n"
+           "          [--portfolio=THREADS] [--optimize=MOVES] [--lns=ROUNDS]\n"
+           "          [--generate=FILE] [--seed=N]\n", program);
+}
+
+int main(int argc, char *argv[]) {
+    GeneratorOptions gen = {3, 0.8, 0.25, 24, 2};
+    SolverOptions options;
+    schedulerDefaultOptions(&options);
+    int seeds = 10;
+    const char *generateFile = NULL;
+    uint64_t generateSeed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--seeds=", 8) == 0) {
+            seeds = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--sections=", 11) == 0) {
+            gen.sections = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--tightness=", 12) == 0) {
+            gen.tightness = atof(argv[i] + 12);
+        } else if (strncmp(argv[i], "--labs=", 7) == 0) {
+            gen.labFraction = atof(argv[i] + 7);
+        } else if (strncmp(argv[i], "--faculty=", 10) == 0) {
+            gen.faculty = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--faculty-per-subject=", 22) == 0) {
+            gen.facultyPerSubject = atoi(argv[i] + 22);
+        } else if (strcmp(argv[i], "--solver=greedy") == 0) {
+            options.solver = SOLVER_GREEDY;
+        } else if (strcmp(argv[i], "--solver=backtrack") == 0) {
+            options.solver = SOLVER_BACKTRACK;
+        } else if (strcmp(argv[i], "--solver=sat") == 0) {
+            options.solver = SOLVER_SAT;
+        } else if (strcmp(argv[i], "--order=dsatur") == 0) {
+            options.ordering = ORDER_DSATUR;
+        } else if (strcmp(argv[i], "--order=degree") == 0) {
+            options.ordering = ORDER_DEGREE;
+        } else if (strcmp(argv[i], "--order=duration") == 0) {
+            options.ordering = ORDER_DURATION;
+        } else if (strncmp(argv[i], "--portfolio=", 12) == 0) {
+            options.threads = atoi(argv[i] + 12);
+        } else if (strncmp(argv[i], "--optimize=", 11) == 0) {
+            options.optimizeMoves = atol(argv[i] + 11);
+        } else if (strncmp(argv[i], "--lns=", 6) == 0) {
+            options.lnsRounds = atol(argv[i] + 6);
+        } else if (strncmp(argv[i], "--generate=", 11) == 0) {
+            generateFile = argv[i] + 11;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            generateSeed = strtoull(argv[i] + 7, NULL, 10);
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (seeds < 1 || gen.sections < 1 || gen.faculty < 1 || gen.facultyPerSubject < 0 ||
+        gen.tightness <= 0 || gen.tightness > 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Only write one instance, e.g. to run the main program on it
+    if (generateFile) {
+        int subjects = generateInstance(&gen, generateSeed, generateFile);
+        if (subjects < 0) return 1;
+        printf("Wrote %d subjects to %s (use --sections=%d)\n", subjects, generateFile, gen.sections);
+        return 0;
+    }
+
+    // Instances and output files live in a scratch directory
+    char scratch[] = "/tmp/timetable-bench.XXXXXX";
+    if (!mkdtemp(scratch) || chdir(scratch) != 0) {
+        printf("Cannot create a scratch directory\n");
+        return 1;
+    }
+
+    static const char *solverNames[] = {"greedy", "backtrack", "sat"};
+    static const char *orderNames[] = {"dsatur", "degree", "duration"};
+    printf("sections=%d tightness=%.2f labs=%.2f faculty=%d faculty/subject=%d solver=%s order=%s threads=%d\n",
+           gen.sections, gen.tightness, gen.labFraction, gen.faculty, gen.facultyPerSubject,
+           solverNames[options.solver], orderNames[options.ordering],
+           options.threads);
+    printf("%6s %9s %9s %10s %10s %9s %14s\n",
+           "seed", "subjects", "unplaced", "load ms", "solve ms", "write ms", "checks/s");
+
+    int solved = 0;
+    long totalUnplaced = 0;
+    long totalChecks = 0;
+    double totalLoad = 0, totalSolve = 0, totalWrite = 0;
+
+    for (int seed = 1; seed <= seeds; seed++) {
+        if (generateInstance(&gen, (uint64_t)seed, "instance.txt") < 0) return 1;
+
+        options.seed = (unsigned long long)seed;
+        SchedulerContext *ctx = schedulerInit(&options);
+        if (!ctx || schedulerSetSections(ctx, gen.sections) != 0) {
+            printf("ERROR: Out of memory\n");
+            return 1;
+        }
+
+        double t0 = nowSeconds();
+        int subjects = schedulerLoadFile(ctx, "instance.txt");
+        double t1 = nowSeconds();
+        int status = schedulerSolve(ctx);
+        double t2 = nowSeconds();
+        schedulerWriteOutputs(ctx, OUTPUT_TEXT);
+        double t3 = nowSeconds();
+
+        int unplaced = schedulerUnplaced(ctx);
+        long checks = schedulerPlacementChecks(ctx);
+        solved += status == SOLVE_FEASIBLE;
+        totalUnplaced += unplaced;
+        totalChecks += checks;
+        totalLoad += t1 - t0;
+        totalSolve += t2 - t1;
+        totalWrite += t3 - t2;
+
+        printf("%6d %9d %9d %10.3f %10.3f %9.3f %14.0f\n", seed, subjects, unplaced,
+               (t1 - t0) * 1e3, (t2 - t1) * 1e3, (t3 - t2) * 1e3,
+               t2 > t1 ? checks / (t2 - t1) : 0.0);
+
+        schedulerFree(ctx);
+        cleanDirectory(".");
+    }
+
+    if (chdir("/") == 0) rmdir(scratch);
+
+    printf("\nSuccess rate:      %d/%d (%.0f%%)\n", solved, seeds, 100.0 * solved / seeds);
+    printf("Unplaced (mean):   %.2f\n", (double)totalUnplaced / seeds);
+    printf("Load (mean):       %.3f ms\n", totalLoad / seeds * 1e3);
+    printf("Solve (mean):      %.3f ms\n", totalSolve / seeds * 1e3);
+    printf("Write (mean):      %.3f ms\n", totalWrite / seeds * 1e3);
+    printf("Checks per second: %.0f\n", totalSolve > 0 ? totalChecks / totalSolve : 0.0);
+    printf("Peak RSS:          %ld KB\n", peakRssKilobytes());
+    return 0;
+}
@@ -1,645 +1,7685 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h> // For getcwd()
-#include <time.h>   // For random seed
-
-#define MAX_SUBJECTS 50
-#define MAX_FACULTIES 100
-#define MAX_NAME_LEN 100
-#define MAX_SECTIONS 3
-#define MAX_DAYS 6
-#define MAX_SLOTS_PER_DAY 7 // 9:40 to 4:20 with 1-hour slots & 1 lunch break
-#define MAX_TOTAL_SLOTS (MAX_DAYS * MAX_SLOTS_PER_DAY)
-#define LUNCH_SLOT 3 // 4th slot is lunch break
-
-typedef struct {
-    char name[MAX_NAME_LEN];
-    int duration;
-    int facultyCount;
-    char faculties[MAX_FACULTIES][MAX_NAME_LEN];
-    int assigned[MAX_SECTIONS]; // Track assignment status per section
-    int occurrences;  // How many times this subject should appear per week
-    int section_specific; // If 1, this subject is tied to a specific section
-    int target_section;   // Which section this subject is for (if section_specific is 1)
-} Subject;
-
-Subject subjects[MAX_SUBJECTS];
-int subjectCount = 0;
-
-// The timetable for all sections
-int timetable[MAX_SECTIONS][MAX_DAYS][MAX_SLOTS_PER_DAY];
-
-// Faculty availability tracking
-int facultyBusy[MAX_FACULTIES][MAX_DAYS][MAX_SLOTS_PER_DAY];
-int totalFaculties = 0;
-char allFaculties[MAX_FACULTIES][MAX_NAME_LEN];
-
-// Find or add faculty
-int getFacultyIndex(const char *name) {
-    // Skip empty names
-    if (name == NULL || name[0] == '\0') {
-        return -1;
-    }
-    
-    for (int i = 0; i < totalFaculties; i++) {
-        if (strcmp(allFaculties[i], name) == 0) {
-            return i;
-        }
-    }
-    
-    // Not found, add new faculty
-    if (totalFaculties < MAX_FACULTIES) {
-        strcpy(allFaculties[totalFaculties], name);
-        return totalFaculties++;
-    }
-    
-    // Too many faculties, return error
-    printf("ERROR: Maximum faculty limit reached!\n");
-    return -1;
-}
-
-// Check if faculty is available
-int isFacultyAvailable(const char *name, int day, int slot) {
-    // Skip empty names
-    if (name == NULL || name[0] == '\0') {
-        return 1;  // Empty faculty is always available
-    }
-    
-    int idx = getFacultyIndex(name);
-    if (idx == -1) return 1;  // If faculty not found, assume available
-    
-    return !facultyBusy[idx][day][slot];
-}
-
-// Mark faculty as busy
-void markFacultyBusy(const char *name, int day, int slot) {
-    // Skip empty names
-    if (name == NULL || name[0] == '\0') {
-        return;
-    }
-    
-    int idx = getFacultyIndex(name);
-    if (idx == -1) return;  // Skip if faculty index invalid
-    
-    facultyBusy[idx][day][slot] = 1;
-}
-
-// Set default occurrences for subjects based on their type and name
-void setDefaultOccurrences(Subject *subject) {
-    // Reset default value
-    subject->occurrences = 1;
-    
-    // Check if this is a lab subject (2-hour duration)
-    if (subject->duration == 2) {
-        // Labs typically appear once per week
-        subject->occurrences = 1;
-    } else {
-        // Theory subjects appear multiple times per week
-        if (strstr(subject->name, "HVPE") != NULL || 
-            strcmp(subject->name, "Sports") == 0 || 
-            strcmp(subject->name, "Library") == 0 ||
-            strcmp(subject->name, "Mentoring") == 0) {
-            subject->occurrences = 1;
-        } else if (strcmp(subject->name, "OE-II") == 0) {
-            subject->occurrences = 2;  // Based on the timetable image showing OE-II twice a week
-        } else {
-            // Regular theory subjects appear 3 times per week
-            subject->occurrences = 3;
-        }
-    }
-    
-    printf("Set occurrences for %s: %d\n", subject->name, subject->occurrences);
-}
-
-void readSubjectsFromFile(const char *filename) {
-    printf("Attempting to open file: %s\n", filename);
-    
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        printf("Cannot open file: %s\n", filename);
-        printf("Try using full path or check if file exists in current directory.\n");
-        exit(1);
-    }
-    
-    printf("File opened successfully.\n");
-    
-    char line[512];
-    while (fgets(line, sizeof(line), fp)) {
-        // Remove newline character
-        size_t len = strlen(line);
-        if (len > 0 && line[len-1] == '\n') {
-            line[len-1] = '\0';
-        }
-        
-        printf("Processing line: %s\n", line);
-
-        char *token = strtok(line, ",");
-        if (!token) {
-            printf("Warning: Invalid line format (no subject name)\n");
-            continue;
-        }
-        
-        strcpy(subjects[subjectCount].name, token);
-        printf("Subject name: %s\n", subjects[subjectCount].name);
-
-        token = strtok(NULL, ",");
-        if (!token) {
-            printf("Warning: Invalid line format (no duration) for subject %s\n", subjects[subjectCount].name);
-            continue;
-        }
-        
-        subjects[subjectCount].duration = atoi(token);
-        printf("Duration: %d\n", subjects[subjectCount].duration);
-
-        subjects[subjectCount].facultyCount = 0;
-        token = strtok(NULL, "\n");
-        if (token && token[0] != '\0') {
-            char facultyCopy[512];
-            strcpy(facultyCopy, token);
-            
-            char *faculty = strtok(facultyCopy, ";");
-            while (faculty && subjects[subjectCount].facultyCount < MAX_FACULTIES) {
-                strcpy(subjects[subjectCount].faculties[subjects[subjectCount].facultyCount++], faculty);
-                printf("Faculty %d: %s\n", subjects[subjectCount].facultyCount, faculty);
-                faculty = strtok(NULL, ";");
-            }
-        } else {
-            printf("No faculties for this subject\n");
-        }
-
-        // Initialize assignment status for all sections
-        for (int s = 0; s < MAX_SECTIONS; s++) {
-            subjects[subjectCount].assigned[s] = 0;
-        }
-        
-        // By default, subject is not section-specific
-        subjects[subjectCount].section_specific = 0;
-        subjects[subjectCount].target_section = -1;
-        
-        // Set default occurrences based on subject type
-        setDefaultOccurrences(&subjects[subjectCount]);
-        
-        subjectCount++;
-        
-        if (subjectCount >= MAX_SUBJECTS) {
-            printf("Warning: Maximum subject limit reached. Some subjects may be ignored.\n");
-            break;
-        }
-    }
-
-    fclose(fp);
-    printf("Total subjects read: %d\n", subjectCount);
-}
-
-// Check if a subject can be placed at a specific day and time slot
-int canPlaceSubject(int subIdx, int day, int slot, int section) {
-    // Check if subject is section-specific but not for this section
-    if (subjects[subIdx].section_specific && 
-        subjects[subIdx].target_section != section) {
-        return 0;
-    }
-    
-    // Check if the slot is already occupied
-    if (timetable[section][day][slot] != -1) {
-        return 0;
-    }
-    
-    // Check if slot is lunch break
-    if (slot == LUNCH_SLOT) {
-        return 0;
-    }
-    
-    // For 2-hour subjects, check if we have two consecutive slots available
-    if (subjects[subIdx].duration == 2) {
-        // Can't place 2-hour subject in last slot of the day
-        if (slot == MAX_SLOTS_PER_DAY - 1) {
-            return 0;
-        }
-        
-        // Check if next slot is available and not lunch
-        if (slot + 1 == LUNCH_SLOT || timetable[section][day][slot + 1] != -1) {
-            return 0;
-        }
-    }
-    
-    // Check faculty availability
-    for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
-        if (!isFacultyAvailable(subjects[subIdx].faculties[f], day, slot)) {
-            return 0;
-        }
-        
-        // For 2-hour subjects, check faculty availability for next hour
-        if (subjects[subIdx].duration == 2 && slot + 1 < MAX_SLOTS_PER_DAY) {
-            if (!isFacultyAvailable(subjects[subIdx].faculties[f], day, slot + 1)) {
-                return 0;
-            }
-        }
-    }
-    
-    // Check if this subject has already been scheduled on this day
-    for (int s = 0; s < MAX_SLOTS_PER_DAY; s++) {
-        if (timetable[section][day][s] == subIdx) {
-            return 0;
-        }
-    }
-    
-    return 1;
-}
-
-// Count how many times a subject appears in a section's timetable
-int countSubjectOccurrences(int subIdx, int section) {
-    int count = 0;
-    for (int d = 0; d < MAX_DAYS; d++) {
-        for (int s = 0; s < MAX_SLOTS_PER_DAY; s++) {
-            if (timetable[section][d][s] == subIdx) {
-                // For 2-hour subjects, only count once per occurrence
-                if (s == 0 || timetable[section][d][s-1] != subIdx) {
-                    count++;
-                }
-            }
-        }
-    }
-    return count;
-}
-
-// Place subject in timetable and mark faculty as busy
-void placeSubject(int subIdx, int day, int slot, int section, int occurrence) {
-    printf("Placing subject %s on day %d, slot %d for section %d (occurrence %d)\n", 
-           subjects[subIdx].name, day, slot, section, occurrence);
-           
-    timetable[section][day][slot] = subIdx;
-    
-    // For 2-hour subjects, occupy two slots
-    if (subjects[subIdx].duration == 2 && slot + 1 < MAX_SLOTS_PER_DAY) {
-        timetable[section][day][slot + 1] = subIdx;
-    }
-    
-    // Mark faculty as busy
-    for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
-        markFacultyBusy(subjects[subIdx].faculties[f], day, slot);
-        
-        // For 2-hour subjects
-        if (subjects[subIdx].duration == 2 && slot + 1 < MAX_SLOTS_PER_DAY) {
-            markFacultyBusy(subjects[subIdx].faculties[f], day, slot + 1);
-        }
-    }
-    
-    // Mark as fully assigned if all occurrences are scheduled
-    if (occurrence >= subjects[subIdx].occurrences) {
-        subjects[subIdx].assigned[section] = 1;
-    }
-}
-
-// Try to place a specific subject in the timetable
-// Returns 1 if successful, 0 if failed
-int tryPlaceSubject(int subIdx, int section) {
-    int occurCount = 0;
-    
-    while (occurCount < subjects[subIdx].occurrences) {
-        int placed = 0;
-        
-        // Try different days and slots randomly to increase variety
-        int days[MAX_DAYS];
-        int slots[MAX_SLOTS_PER_DAY];
-        
-        // Initialize the arrays
-        for (int i = 0; i < MAX_DAYS; i++) days[i] = i;
-        for (int i = 0; i < MAX_SLOTS_PER_DAY; i++) slots[i] = i;
-        
-        // Shuffle days
-        for (int i = MAX_DAYS - 1; i > 0; i--) {
-            int j = rand() % (i + 1);
-            int temp = days[i];
-            days[i] = days[j];
-            days[j] = temp;
-        }
-        
-        // Shuffle slots
-        for (int i = MAX_SLOTS_PER_DAY - 1; i > 0; i--) {
-            int j = rand() % (i + 1);
-            int temp = slots[i];
-            slots[i] = slots[j];
-            slots[j] = temp;
-        }
-        
-        // Try each day and slot in random order
-        for (int di = 0; di < MAX_DAYS && !placed; di++) {
-            int d = days[di];
-            for (int si = 0; si < MAX_SLOTS_PER_DAY && !placed; si++) {
-                int s = slots[si];
-                
-                if (canPlaceSubject(subIdx, d, s, section)) {
-                    placeSubject(subIdx, d, s, section, occurCount + 1);
-                    placed = 1;
-                    occurCount++;
-                }
-            }
-        }
-        
-        if (!placed) {
-            printf("WARNING: Could not place subject: %s occurrence %d for section %d\n", 
-                   subjects[subIdx].name, occurCount + 1, section + 1);
-            return 0;
-        }
-    }
-    
-    return 1;
-}
-
-// Generate timetable using an improved approach with better distribution
-void generateTimetable() {
-    printf("Starting timetable generation...\n");
-    
-    // Seed the random number generator for shuffling
-    srand(time(NULL));
-    
-    // Initialize timetable with -1 (free)
-    for (int s = 0; s < MAX_SECTIONS; s++) {
-        for (int d = 0; d < MAX_DAYS; d++) {
-            for (int p = 0; p < MAX_SLOTS_PER_DAY; p++) {
-                timetable[s][d][p] = -1;
-            }
-        }
-    }
-    
-    // Initialize faculty availability
-    for (int f = 0; f < MAX_FACULTIES; f++) {
-        for (int d = 0; d < MAX_DAYS; d++) {
-            for (int p = 0; p < MAX_SLOTS_PER_DAY; p++) {
-                facultyBusy[f][d][p] = 0;
-            }
-        }
-    }
-    
-    // Create a priority queue of subjects (prioritize 2-hour subjects and higher occurrence counts)
-    int priorityOrder[MAX_SUBJECTS];
-    
-    // Initialize the priority order
-    for (int i = 0; i < subjectCount; i++) {
-        priorityOrder[i] = i;
-    }
-    
-    // Sort by priority (2-hour subjects first, then by occurrence count)
-    for (int i = 0; i < subjectCount - 1; i++) {
-        for (int j = i + 1; j < subjectCount; j++) {
-            int iIdx = priorityOrder[i];
-            int jIdx = priorityOrder[j];
-            
-            // Higher duration gets higher priority
-            if (subjects[jIdx].duration > subjects[iIdx].duration) {
-                int temp = priorityOrder[i];
-                priorityOrder[i] = priorityOrder[j];
-                priorityOrder[j] = temp;
-            }
-            // If same duration, higher occurrence count gets higher priority
-            else if (subjects[jIdx].duration == subjects[iIdx].duration && 
-                     subjects[jIdx].occurrences > subjects[iIdx].occurrences) {
-                int temp = priorityOrder[i];
-                priorityOrder[i] = priorityOrder[j];
-                priorityOrder[j] = temp;
-            }
-        }
-    }
-    
-    printf("Placement order of subjects:\n");
-    for (int i = 0; i < subjectCount; i++) {
-        int subIdx = priorityOrder[i];
-        printf("%d. %s (Duration: %d, Occurrences: %d)\n", 
-               i+1, subjects[subIdx].name, subjects[subIdx].duration, subjects[subIdx].occurrences);
-    }
-    
-    // Use the priority order to place subjects
-    for (int i = 0; i < subjectCount; i++) {
-        int subIdx = priorityOrder[i];
-        
-        for (int s = 0; s < MAX_SECTIONS; s++) {
-            if (subjects[subIdx].section_specific && subjects[subIdx].target_section != s) {
-                // Skip this section if the subject is not for it
-                continue;
-            }
-            
-            printf("Trying to place subject: %s for section %d\n", subjects[subIdx].name, s+1);
-            
-            if (!tryPlaceSubject(subIdx, s)) {
-                printf("WARNING: Failed to place subject %s for section %d. Backtracking needed.\n", 
-                       subjects[subIdx].name, s+1);
-                // In a more sophisticated version, we could implement backtracking here
-            }
-        }
-    }
-    
-    // Check for empty slots and try to fill them with additional subjects
-    for (int s = 0; s < MAX_SECTIONS; s++) {
-        for (int d = 0; d < MAX_DAYS; d++) {
-            for (int p = 0; p < MAX_SLOTS_PER_DAY; p++) {
-                if (p != LUNCH_SLOT && timetable[s][d][p] == -1) {
-                    // Try to find a subject to place here
-                    for (int subIdx = 0; subIdx < subjectCount; subIdx++) {
-                        // Skip 2-hour subjects for simplicity
-                        if (subjects[subIdx].duration == 1 && canPlaceSubject(subIdx, d, p, s)) {
-                            // Place an extra occurrence of this subject
-                            int currOccur = countSubjectOccurrences(subIdx, s) + 1;
-                            placeSubject(subIdx, d, p, s, currOccur);
-                            break;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    
-    printf("Timetable generation completed.\n");
-}
-
-void printTimetablesToFiles() {
-    printf("Generating timetable output files...\n");
-    
-    const char *timeSlots[MAX_SLOTS_PER_DAY] = {
-        "9:40-10:40", "10:40-11:40", "11:40-12:40", 
-        "12:40-1:20 (Lunch)", "1:20-2:20", "2:20-3:20", "3:20-4:20"
-    };
-    
-    const char *days[MAX_DAYS] = {
-        "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"
-    };
-
-    const char *sectionNames[MAX_SECTIONS] = {
-        "IT-A", "IT-B", "IT-C"
-    };
-
-    for (int sec = 0; sec < MAX_SECTIONS; sec++) {
-        char filename[50];
-        sprintf(filename, "section%s_timetable.txt", sectionNames[sec]);
-        printf("Creating file: %s\n", filename);
-        
-        FILE *fp = fopen(filename, "w");
-        if (!fp) {
-            printf("Error writing to file %s\n", filename);
-            printf("Check if you have write permissions in this directory.\n");
-            continue;
-        }
-
-        fprintf(fp, "=========== VASAVI COLLEGE OF ENGINEERING (AUTONOMOUS) ===========\n");
-        fprintf(fp, "=========== DEPARTMENT OF INFORMATION TECHNOLOGY ===========\n");
-        fprintf(fp, "=========== TIMETABLE - 2024-25 EVEN SEMESTER ===========\n");
-        fprintf(fp, "COURSE: B.E\t\tSEMESTER: IV\t\tBranch/Section: %s\t\tROOM NO.: VS-%d01\n\n", 
-                sectionNames[sec], sec+2);
-
-        // Print header
-        fprintf(fp, "%-12s", "DAY/TIME");
-        for (int s = 0; s < MAX_SLOTS_PER_DAY; s++) {
-            fprintf(fp, "%-15s", timeSlots[s]);
-        }
-        fprintf(fp, "\n");
-        
-        // Print separator line
-        for (int i = 0; i < 12 + 15 * MAX_SLOTS_PER_DAY; i++) {
-            fprintf(fp, "-");
-        }
-        fprintf(fp, "\n");
-        
-        // Print rows
-        for (int d = 0; d < MAX_DAYS; d++) {
-            fprintf(fp, "%-12s", days[d]);
-            
-            for (int s = 0; s < MAX_SLOTS_PER_DAY; s++) {
-                if (s == LUNCH_SLOT) { // Lunch break
-                    fprintf(fp, "%-15s", "LUNCH");
-                } else {
-                    int subIdx = timetable[sec][d][s];
-                    
-                    if (subIdx >= 0 && subIdx < subjectCount) {
-                        // Check for continued 2-hour subjects
-                        if (s > 0 && timetable[sec][d][s] == timetable[sec][d][s-1] && 
-                            subjects[subIdx].duration == 2) {
-                            fprintf(fp, "%-15s", "(continued)");
-                        } else {
-                            fprintf(fp, "%-15s", subjects[subIdx].name);
-                        }
-                    } else {
-                        fprintf(fp, "%-15s", "FREE");
-                    }
-                }
-            }
-            fprintf(fp, "\n");
-        }
-
-        // Print subject details
-        fprintf(fp, "\n\n=========== SUBJECT DETAILS ===========\n\n");
-        for (int i = 0; i < subjectCount; i++) {
-            fprintf(fp, "Subject: %s\n", subjects[i].name);
-            fprintf(fp, "Duration: %d hour(s)\n", subjects[i].duration);
-            fprintf(fp, "Weekly Occurrences: %d\n", subjects[i].occurrences);
-            fprintf(fp, "Faculty: ");
-            if (subjects[i].facultyCount == 0) {
-                fprintf(fp, "None assigned");
-            } else {
-                for (int f = 0; f < subjects[i].facultyCount; f++) {
-                    fprintf(fp, "%s", subjects[i].faculties[f]);
-                    if (f < subjects[i].facultyCount - 1) fprintf(fp, ", ");
-                }
-            }
-            fprintf(fp, "\n\n");
-        }
-
-        fclose(fp);
-        printf("Successfully generated timetable for Section %s\n", sectionNames[sec]);
-    }
-    
-    // Generate a faculty workload report
-    FILE *fpFaculty = fopen("faculty_workload.txt", "w");
-    if (fpFaculty) {
-        fprintf(fpFaculty, "=========== FACULTY WORKLOAD REPORT ===========\n\n");
-        
-        for (int f = 0; f < totalFaculties; f++) {
-            int totalHours = 0;
-            fprintf(fpFaculty, "Faculty: %s\n", allFaculties[f]);
-            fprintf(fpFaculty, "Schedule:\n");
-            
-            for (int d = 0; d < MAX_DAYS; d++) {
-                for (int s = 0; s < MAX_SLOTS_PER_DAY; s++) {
-                    if (s == LUNCH_SLOT) continue; // Skip lunch break
-                    
-                    for (int sec = 0; sec < MAX_SECTIONS; sec++) {
-                        int subIdx = timetable[sec][d][s];
-                        if (subIdx >= 0) {
-                            for (int i = 0; i < subjects[subIdx].facultyCount; i++) {
-                                if (strcmp(subjects[subIdx].faculties[i], allFaculties[f]) == 0) {
-                                    // Don't double-count continued 2-hour slots
-                                    if (!(s > 0 && timetable[sec][d][s] == timetable[sec][d][s-1] && 
-                                        subjects[subIdx].duration == 2)) {
-                                        fprintf(fpFaculty, "  %s, %s, Section %s, %s\n", 
-                                                days[d], timeSlots[s], sectionNames[sec], subjects[subIdx].name);
-                                        totalHours++;
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-            
-            fprintf(fpFaculty, "Total Hours: %d\n\n", totalHours);
-        }
-        
-        fclose(fpFaculty);
-        printf("Faculty workload report generated.\n");
-    }
-    
-    printf("All timetable files have been generated.\n");
-}
-
-int main() {
-    printf("Timetable Generator starting...\n");
-    
-    // Read subjects - try different possible filenames
-    const char* filenames[] = {
-        "Subjects.txt",
-        "subjects.txt",
-        "Subjects .txt", // Note the space
-        "../Subjects.txt",
-        "./Subjects.txt"
-    };
-    
-    int file_found = 0;
-    for (int i = 0; i < 5 && !file_found; i++) {
-        FILE *test = fopen(filenames[i], "r");
-        if (test) {
-            fclose(test);
-            printf("Found file: %s\n", filenames[i]);
-            readSubjectsFromFile(filenames[i]);
-            file_found = 1;
-        }
-    }
-    
-    if (!file_found) {
-        printf("\nERROR: Could not find Subjects.txt file!\n");
-        printf("Please ensure the file exists in the current directory.\n");
-        printf("Current working directory is: ");
-        char cwd[256];
-        if (getcwd(cwd, sizeof(cwd)) != NULL) {
-            printf("%s\n", cwd);
-        } else {
-            printf("unknown\n");
-        }
-        return 1;
-    }
-    
-    if (subjectCount == 0) {
-        printf("No subjects were read from the file. Exiting.\n");
-        return 1;
-    }
-    
-    printf("Successfully read %d subjects from file\n", subjectCount);
-    
-    // Generate timetable
-    generateTimetable();
-    
-    // Generate output files
-    printTimetablesToFiles();
-    
-    printf("Timetable generation completed successfully!\n");
-    
-    return 0;
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h> // For the buffered writers
+#include <unistd.h> // For getcwd()
+#include <fcntl.h>  // For opening compiled instances
+#include <sys/mman.h> // For mapping compiled instances
+#include <sys/stat.h> // Also for creating batch output directories
+#include <errno.h>
+#include <strings.h> // For strncasecmp()
+#include <time.h>   // For random seed
+#include <math.h>   // For the annealing schedule
+#include <stdint.h> // For 64-bit slot masks
+#include <pthread.h>   // For the portfolio thread pool
+#include <stdatomic.h> // For cancelling portfolio attempts
+#include <signal.h>     // For ignoring SIGPIPE in daemon mode
+#include <sys/socket.h> // For the daemon's Unix domain socket
+#include <sys/un.h>
+#include <poll.h>     // For waking the accept loop on shutdown
+#include "timetable.h"
+
+#define DEFAULT_SECTIONS 3 // Sections when the caller does not choose a count
+
+// Limits of a calendar grid (see Grid); the grid itself is chosen at run time
+#define MAX_DAYS 7           // Day sets must fit into the bits of subjectDays
+#define MAX_SLOTS_PER_DAY 16
+#define MAX_TOTAL_SLOTS 64   // Cells of a week mask, and of a section's timetable row
+#define MAX_DURATION 4       // Longest block of consecutive slots
+#define GRID_LABEL_LEN 24
+
+// Each week is laid out as one 64-bit mask: bit (day * slotsPerDay + slot)
+// of the context's grid
+#define CELL_INDEX(grid, day, slot) ((day) * (grid)->slotsPerDay + (slot))
+#define CELL_BIT(grid, day, slot) (1ULL << CELL_INDEX(grid, day, slot))
+#define CELL_DAY(grid, cell) ((cell) / (grid)->slotsPerDay)
+#define CELL_SLOT(grid, cell) ((cell) % (grid)->slotsPerDay)
+#define POPCOUNT64(x) __builtin_popcountll(x)
+#define CTZ64(x) __builtin_ctzll(x)
+
+// Messages above this level are compiled out, so quiet builds pay nothing
+// for the logging inside the placement loops
+#ifndef TIMETABLE_MAX_LOG_LEVEL
+#define TIMETABLE_MAX_LOG_LEVEL LOG_DEBUG
+#endif
+#define LOG_ENABLED(verbose, level) ((level) <= TIMETABLE_MAX_LOG_LEVEL && (verbose) >= (level))
+#define LOG(verbose, level, ...) \
+    do { if (LOG_ENABLED(verbose, level)) printf(__VA_ARGS__); } while (0)
+
+// Below LOG_QUIET: the work copies of the portfolio, anytime and LNS runs
+// print nothing, not even warnings, since only the kept schedule reports
+#define LOG_SILENT (-1)
+
+// Solver counters beyond placement checks and nodes; -DTIMETABLE_STATS=0 removes them
+#ifndef TIMETABLE_STATS
+#define TIMETABLE_STATS 1
+#endif
+#if TIMETABLE_STATS
+#define STAT_ADD(sch, counter, n) ((sch)->stats.counter += (n))
+#else
+#define STAT_ADD(sch, counter, n) ((void)0)
+#endif
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// Bump allocator: input data is carved out of large blocks and released in
+// one shot when the input is replaced or the context is freed
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+} Arena;
+
+// Allocate zeroed, 16-byte aligned memory from the arena (NULL when out of memory)
+void *arenaAlloc(Arena *arena, size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        size_t blockSize = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(ArenaBlock) + blockSize);
+        if (!block) return NULL;
+        block->next = arena->head;
+        block->used = 0;
+        block->size = blockSize;
+        arena->head = block;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+// Release every block at once
+void arenaFree(Arena *arena) {
+    while (arena->head) {
+        ArenaBlock *next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+}
+
+// Subjects keep only the hot scheduling fields inline; the name and the
+// faculty ID list live in the context's arena.
+typedef struct {
+    const char *name;
+    int duration;
+    int occurrences;  // How many times this subject should appear per week
+    const int *facultyIds; // Interned faculty IDs (indexes into allFaculties)
+    int facultyCount;
+    int section_specific; // If 1, this subject is tied to a specific section
+    int target_section;   // Which section this subject is for (if section_specific is 1)
+    int roomType;         // ROOM_* the subject is taught in
+} Subject;
+
+// Kinds of room an input can declare
+enum {
+    ROOM_CLASSROOM,
+    ROOM_LAB,
+    ROOM_TYPES
+};
+
+// Rooms of one type are a bitmask per cell
+#define MAX_ROOMS_PER_TYPE 64
+
+const char *roomTypeNames[] = {"classroom", "lab"};
+
+// An occurrence fixed by the input (@pin); solvers place it first and
+// never move it
+typedef struct {
+    int section;
+    int subIdx;
+    int cell;     // Start cell
+} Pin;
+
+// A room declared by the input (@room)
+typedef struct {
+    const char *name;
+    int type;     // ROOM_*
+    int bit;      // Position among the rooms of its type
+} Room;
+
+// Section names are short generated labels ("IT-A", ..., "IT-AA", ...)
+#define SECTION_NAME_LEN 16
+
+// The calendar grid: days of equally long slots, some of which are breaks
+// on every day, and days that end early. Campuses differ, so the grid comes
+// from the input (or a grid file) instead of being compiled in. The masks
+// below it are derived once per grid by buildGrid(), and the placement
+// code only ever looks at those.
+typedef struct {
+    int days;
+    int slotsPerDay;          // Slots of the longest day, which is the row stride
+    int cells;                // days * slotsPerDay, the cells of the week in use
+    int daySlots[MAX_DAYS];   // Slots taught on each day (a half-day has fewer)
+    uint32_t breakSlots;      // Bit per slot that is a break on every day
+    char dayNames[MAX_DAYS][GRID_LABEL_LEN];
+    char slotTimes[MAX_SLOTS_PER_DAY][GRID_LABEL_LEN];  // Column headers
+    char breakNames[MAX_SLOTS_PER_DAY][GRID_LABEL_LEN]; // Printed in break cells
+    
+    uint64_t teachingMask;    // Cells a class may use
+    uint64_t startMask[MAX_DURATION + 1]; // Cells where d teaching cells of one day follow in a row
+    uint64_t dayCells[1 << MAX_DAYS];     // Cells covered by a set of days
+} Grid;
+
+// What one solve did. Rejections count start cells, since every check
+// evaluates a whole week: a cell is charged to the first constraint that
+// rules it out, in the order listed here.
+typedef struct {
+    long checks;             // feasibleStarts() calls, each one checks a whole week
+    long rejectedLunch;      // Block would run into a break or the end of the day
+    long rejectedOccupied;   // Section already has a class there
+    long rejectedFaculty;    // A faculty member is busy or unavailable
+    long rejectedRoom;       // Every room of the subject's type is booked
+    long rejectedSameDay;    // Subject already meets that day
+    long placements;         // Occurrences placed, including ones later undone
+    long fillInsertions;     // Extra occurrences added by the fill pass
+    long nodes;              // Backtracking nodes
+} SolveStats;
+
+// Add one attempt's counters to a total
+void addStats(SolveStats *total, const SolveStats *stats) {
+    total->checks += stats->checks;
+    total->rejectedLunch += stats->rejectedLunch;
+    total->rejectedOccupied += stats->rejectedOccupied;
+    total->rejectedFaculty += stats->rejectedFaculty;
+    total->rejectedRoom += stats->rejectedRoom;
+    total->rejectedSameDay += stats->rejectedSameDay;
+    total->placements += stats->placements;
+    total->fillInsertions += stats->fillInsertions;
+    total->nodes += stats->nodes;
+}
+
+// Timed phases of a run, reported by schedulerWriteStats()
+enum {
+    PHASE_LOAD,
+    PHASE_SOLVE,
+    PHASE_REPAIR,
+    PHASE_FILL,
+    PHASE_OPTIMIZE,
+    PHASE_WRITE,
+    PHASE_COUNT
+};
+
+const char *phaseNames[PHASE_COUNT] = {
+    "load", "solve", "repair", "fill", "optimize", "write"
+};
+
+#define MAX_CORE_FACULTY 64  // Faculty members an unsat core names at most
+
+// An open decision log (see logDecision())
+typedef struct {
+    FILE *fp;
+    long records;             // Records written so far
+} DecisionLog;
+
+// Everything a solver attempt changes. The subject list and faculty table
+// are read-only while solving, so several schedules can be built at once.
+typedef struct {
+    const SchedulerContext *ctx; // The instance being scheduled
+    
+    // The timetable for all sections: subject index per cell, -1 if free
+    int *timetable;            // sectionCount * MAX_TOTAL_SLOTS
+    
+    // Availability masks: a set bit means the section/faculty is busy in that cell
+    uint64_t *sectionBusy;     // sectionCount
+    uint64_t *facultyBusy;     // totalFaculties
+    uint64_t *pinnedCells;     // sectionCount: cells held by pins, which nothing may move
+    
+    // Rooms: the room booked per section and cell (-1 if none), the rooms of
+    // each type still free in a cell (bit = Room.bit), and the start cells
+    // where some room of the type is free for a block of 1 .. MAX_DURATION
+    // hours. Types without declared rooms are not limited, so their start
+    // masks are all set.
+    int *roomOf;               // sectionCount * MAX_TOTAL_SLOTS
+    uint64_t roomFree[ROOM_TYPES][MAX_TOTAL_SLOTS];
+    uint64_t roomStarts[ROOM_TYPES][MAX_DURATION];
+    
+    // Reverse index of the timetable: the section each faculty member teaches
+    // in a cell (-1 if none). With facultyBusy it answers a faculty member's
+    // week without scanning the sections.
+    int *facultySection;       // totalFaculties * MAX_TOTAL_SLOTS
+    
+    // Days (bit per day) on which a subject is already scheduled for a section
+    unsigned char *subjectDays; // sectionCount * subjectCount
+    
+    // Track assignment status per section and subject
+    unsigned char *assigned;    // sectionCount * subjectCount
+    
+    void *storage;         // One allocation backing the arrays above
+    size_t storageSize;
+    
+    int unplaced;          // Required occurrences the solver could not place
+    SolveStats stats;      // Counters of the current run
+    int status;            // SOLVE_* result of the last run
+    uint64_t rngState;     // Private random number generator state
+    int verbose;           // Print every placement decision
+    atomic_int *cancel;    // Set by another thread to stop this attempt early (may be NULL)
+    double deadline;       // Wall-clock time at which solving stops (0 = no deadline)
+    long nodeLimit;        // Backtracking nodes for this run (0 = options.maxNodes)
+    int coreFaculty[MAX_CORE_FACULTY]; // Faculty in the unsat core of a SAT solve that proved infeasibility
+    int coreFacultyCount;
+    DecisionLog *decisions; // Records every change of the timetable (NULL = off)
+} Schedule;
+
+#define TIMETABLE_AT(sch, section, day, slot) \
+    ((sch)->timetable[(section) * MAX_TOTAL_SLOTS + CELL_INDEX(&(sch)->ctx->grid, day, slot)])
+#define SUBJECT_DAYS(sch, section, subIdx) \
+    ((sch)->subjectDays[(section) * (sch)->ctx->subjectCount + (subIdx)])
+#define ASSIGNED(sch, section, subIdx) \
+    ((sch)->assigned[(section) * (sch)->ctx->subjectCount + (subIdx)])
+#define FACULTY_SECTION(sch, facultyId, cell) \
+    ((sch)->facultySection[(facultyId) * MAX_TOTAL_SLOTS + (cell)])
+
+// One department instance: its input, the solver options and the schedules
+// built for it. Nothing outside the context changes while solving.
+struct SchedulerContext {
+    Arena arena;              // Input text, subjects, faculty lists and tables
+    void *mapping;            // Compiled instance the tables point into (NULL for text input)
+    size_t mappingSize;
+    
+    Subject *subjects;
+    int subjectCount;
+    
+    int totalFaculties;
+    const char **allFaculties;
+    int facultyCapacity;
+    
+    // Symbol table mapping faculty names to their IDs (-1 = empty bucket)
+    int *facultyHash;
+    int facultyHashSize;      // Power of two, at least twice facultyCapacity
+    
+    // Subjects that share at least one faculty member (read-only while solving)
+    unsigned char *sharesFaculty; // subjectCount * subjectCount
+    
+    // The same relation as adjacency lists, built on the first solve: the
+    // subjects sharing faculty with subject i (i itself included when it has
+    // faculty) are conflictSubjects[conflictFirst[i] .. conflictFirst[i + 1])
+    int *conflictFirst;       // subjectCount + 1
+    int *conflictSubjects;
+    
+    // Cells in which a faculty member is unavailable (seeded into facultyBusy)
+    uint64_t *facultyBlocked; // totalFaculties
+    
+    // Fixed placements and rooms declared by the input
+    Pin *pins;
+    int pinCount;
+    Room *rooms;
+    int roomCount;
+    int roomTypeCount[ROOM_TYPES];  // Rooms declared of each type
+    int typeRooms[ROOM_TYPES][MAX_ROOMS_PER_TYPE]; // Room index by type and Room.bit
+    int inputSections;        // Section count set by the input (@sections), 0 if none
+    
+    // Calendar grid of the loaded input, and the grid every new input starts
+    // from (the built-in one, or one read by schedulerLoadGrid())
+    Grid grid;
+    Grid baseGrid;
+    
+    int sectionCount;
+    char (*sectionNames)[SECTION_NAME_LEN];
+    
+    SolverOptions options;
+    
+    Schedule *schedule;       // Result of the last solve
+    Schedule *workers;        // Scratch schedules for portfolio threads, kept between solves
+    int workerCount;
+    
+    double phaseSeconds[PHASE_COUNT]; // Wall-clock time of the last run of every phase
+    
+    char *outputDirectory;    // Where output files are written (NULL = current directory)
+    char *decisionLogFile;    // Where solves log their decisions (NULL = off)
+    uint64_t seed;            // Seed of the last solve or repair
+    
+    SchedulerProgressCallback progress; // Called during anytime solves (may be NULL)
+    void *progressData;
+    double progressInterval;  // Seconds between progress calls
+};
+
+// Seed a schedule's private generator (splitmix64 scrambles nearby seeds)
+void seedSchedule(Schedule *sch, uint64_t seed) {
+    uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    sch->rngState = z ? z : 1; // xorshift state must never be zero
+}
+
+// xorshift64* step; each schedule owns its state so threads never share it
+uint32_t nextRandom(Schedule *sch) {
+    uint64_t x = sch->rngState;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    sch->rngState = x;
+    return (uint32_t)((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+// Uniform-enough random integer in [0, n)
+int randomBelow(Schedule *sch, int n) {
+    return (int)(nextRandom(sch) % (uint32_t)n);
+}
+
+// Check if another portfolio attempt asked this one to stop
+int isCancelled(const Schedule *sch) {
+    return sch->cancel != NULL && atomic_load_explicit(sch->cancel, memory_order_relaxed);
+}
+
+// FNV-1a hash of a faculty name
+unsigned int hashFacultyName(const char *name) {
+    unsigned int h = 2166136261u;
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Intern a faculty name: return its ID, adding it to the table if it is new.
+// Names are resolved once while reading the input, so the placement code
+// only ever deals with integer IDs.
+int internFaculty(SchedulerContext *ctx, const char *name) {
+    // Skip empty names
+    if (name == NULL || name[0] == '\0') {
+        return -1;
+    }
+    
+    unsigned int mask = ctx->facultyHashSize - 1;
+    unsigned int h = hashFacultyName(name) & mask;
+    while (ctx->facultyHash[h] != -1) {
+        if (strcmp(ctx->allFaculties[ctx->facultyHash[h]], name) == 0) {
+            return ctx->facultyHash[h];
+        }
+        h = (h + 1) & mask;
+    }
+    
+    // Not found, add new faculty (the name stays in the input buffer)
+    if (ctx->totalFaculties < ctx->facultyCapacity) {
+        ctx->allFaculties[ctx->totalFaculties] = name;
+        ctx->facultyHash[h] = ctx->totalFaculties;
+        return ctx->totalFaculties++;
+    }
+    
+    // Too many faculties, return error
+    printf("ERROR: Maximum faculty limit reached!\n");
+    return -1;
+}
+
+// Look up a faculty ID by name without adding it (-1 if unknown)
+int findFaculty(const SchedulerContext *ctx, const char *name) {
+    if (ctx->facultyHashSize == 0) return -1;
+    unsigned int mask = ctx->facultyHashSize - 1;
+    unsigned int h = hashFacultyName(name) & mask;
+    while (ctx->facultyHash[h] != -1) {
+        if (strcmp(ctx->allFaculties[ctx->facultyHash[h]], name) == 0) {
+            return ctx->facultyHash[h];
+        }
+        h = (h + 1) & mask;
+    }
+    return -1;
+}
+
+// Mark faculty as busy for every cell in the given mask
+void markFacultyBusy(Schedule *sch, int facultyId, uint64_t cells) {
+    sch->facultyBusy[facultyId] |= cells;
+}
+
+// Derive the masks describing the shape of the week from a grid's days,
+// slots and breaks. Returns 0, or -1 if the week does not fit the limits.
+int buildGrid(Grid *grid) {
+    if (grid->days < 1 || grid->days > MAX_DAYS || grid->slotsPerDay < 1 ||
+        grid->slotsPerDay > MAX_SLOTS_PER_DAY || grid->days * grid->slotsPerDay > MAX_TOTAL_SLOTS) {
+        return -1;
+    }
+    
+    grid->cells = grid->days * grid->slotsPerDay;
+    grid->teachingMask = 0;
+    for (int d = 0; d < grid->days; d++) {
+        if (grid->daySlots[d] < 0 || grid->daySlots[d] > grid->slotsPerDay) return -1;
+        for (int s = 0; s < grid->daySlots[d]; s++) {
+            if (!(grid->breakSlots & (1u << s))) grid->teachingMask |= CELL_BIT(grid, d, s);
+        }
+    }
+    
+    // A block of length slots extends a block of length - 1 by one more
+    // teaching cell, which must not be the first cell of the next day
+    uint64_t rowStart = 0;
+    for (int d = 0; d < grid->days; d++) {
+        rowStart |= CELL_BIT(grid, d, 0);
+    }
+    grid->startMask[0] = 0;
+    grid->startMask[1] = grid->teachingMask;
+    for (int length = 2; length <= MAX_DURATION; length++) {
+        uint64_t last = (grid->teachingMask & ~rowStart) >> (length - 1);
+        grid->startMask[length] = grid->startMask[length - 1] & last;
+    }
+    
+    for (int days = 0; days < (1 << MAX_DAYS); days++) {
+        grid->dayCells[days] = 0;
+        for (int d = 0; d < grid->days; d++) {
+            if (days & (1 << d)) {
+                grid->dayCells[days] |= ((1ULL << grid->slotsPerDay) - 1) << CELL_INDEX(grid, d, 0);
+            }
+        }
+    }
+    return 0;
+}
+
+// The grid used before any input asks for another one: Monday to Saturday,
+// 9:40 to 4:20 in 1-hour slots with the lunch break as the 4th slot
+void setDefaultGrid(Grid *grid) {
+    static const char *days[] = {
+        "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"
+    };
+    static const char *times[] = {
+        "9:40-10:40", "10:40-11:40", "11:40-12:40",
+        "12:40-1:20 (Lunch)", "1:20-2:20", "2:20-3:20", "3:20-4:20"
+    };
+    memset(grid, 0, sizeof(*grid));
+    grid->days = 6;
+    grid->slotsPerDay = 7;
+    for (int d = 0; d < grid->days; d++) {
+        strcpy(grid->dayNames[d], days[d]);
+        grid->daySlots[d] = grid->slotsPerDay;
+    }
+    for (int s = 0; s < grid->slotsPerDay; s++) {
+        strcpy(grid->slotTimes[s], times[s]);
+    }
+    grid->breakSlots = 1u << 3;
+    strcpy(grid->breakNames[3], "LUNCH");
+    buildGrid(grid);
+}
+
+// Cells occupied by a subject starting at the given cell
+uint64_t subjectBlock(const Subject *subject, int cell) {
+    return ((1ULL << subject->duration) - 1) << cell;
+}
+
+// Strip leading/trailing whitespace (including the '\r' of CRLF input) in place
+char *trimName(char *name) {
+    while (*name == ' ' || *name == '\t') name++;
+    size_t len = strlen(name);
+    while (len > 0 && (name[len-1] == ' ' || name[len-1] == '\t' ||
+                       name[len-1] == '\r' || name[len-1] == '\n')) {
+        name[--len] = '\0';
+    }
+    return name;
+}
+
+// Day index for a day name or an abbreviation of at least 3 letters
+// ("Mon", "tues"), or -1
+int parseDay(const Grid *grid, const char *text, size_t length) {
+    for (int d = 0; d < grid->days; d++) {
+        if (length >= 3 && length <= strlen(grid->dayNames[d]) &&
+            strncasecmp(grid->dayNames[d], text, length) == 0) {
+            return d;
+        }
+    }
+    return -1;
+}
+
+// Section index for a section name ("IT-B") or a 1-based number ("2"), or -1.
+// Names are generated from the index (see schedulerSetSections()), so they
+// resolve before the section count is known.
+int sectionIndex(const char *name) {
+    if (name[0] >= '0' && name[0] <= '9') {
+        if (strspn(name, "0123456789") != strlen(name) || strlen(name) > 6) return -1;
+        return atoi(name) - 1;
+    }
+    if (strncmp(name, "IT-", 3) != 0 || name[3] == '\0' || strlen(name + 3) > 6) return -1;
+    int number = 0;
+    for (const char *p = name + 3; *p; p++) {
+        if (*p < 'A' || *p > 'Z') return -1;
+        number = number * 26 + (*p - 'A' + 1);
+    }
+    return number - 1;
+}
+
+// Apply one blackout FACULTY@DAY[:SLOT[-SLOT]], e.g. "Dr. X@Mon:2-4", from
+// --unavailable or an @unavailable line (slots count from 1; without a slot
+// the whole day is blocked). Returns 0, or -1 if it is invalid.
+int applyUnavailable(SchedulerContext *ctx, const char *spec) {
+    const char *at = strrchr(spec, '@');
+    if (!at || at == spec) return -1;
+    
+    char faculty[256];
+    snprintf(faculty, sizeof(faculty), "%.*s", (int)(at - spec), spec);
+    const char *dayText = at + 1;
+    const char *colon = strchr(dayText, ':');
+    int day = parseDay(&ctx->grid, dayText, colon ? (size_t)(colon - dayText) : strlen(dayText));
+    if (day == -1) return -1;
+    if (!colon) return schedulerBlockFaculty(ctx, trimName(faculty), day, -1);
+    
+    char *end;
+    long first = strtol(colon + 1, &end, 10);
+    long last = *end == '-' ? strtol(end + 1, &end, 10) : first;
+    if (*end != '\0' || first < 1 || last < first || last > ctx->grid.slotsPerDay) return -1;
+    for (long slot = first; slot <= last; slot++) {
+        if (schedulerBlockFaculty(ctx, trimName(faculty), day, (int)slot - 1) != 0) return -1;
+    }
+    return 0;
+}
+
+// Set default occurrences for subjects based on their type and name
+void setDefaultOccurrences(Subject *subject) {
+    // Reset default value
+    subject->occurrences = 1;
+    
+    // Check if this is a lab subject (a block of 2 hours or more)
+    if (subject->duration >= 2) {
+        // Labs typically appear once per week
+        subject->occurrences = 1;
+    } else {
+        // Theory subjects appear multiple times per week
+        if (strstr(subject->name, "HVPE") != NULL || 
+            strcmp(subject->name, "Sports") == 0 || 
+            strcmp(subject->name, "Library") == 0 ||
+            strcmp(subject->name, "Mentoring") == 0) {
+            subject->occurrences = 1;
+        } else if (strcmp(subject->name, "OE-II") == 0) {
+            subject->occurrences = 2;  // Based on the timetable image showing OE-II twice a week
+        } else {
+            // Regular theory subjects appear 3 times per week
+            subject->occurrences = 3;
+        }
+    }
+    
+}
+
+// Precompute which subjects compete for a faculty member
+int buildFacultyConflicts(SchedulerContext *ctx) {
+    int n = ctx->subjectCount;
+    ctx->sharesFaculty = arenaAlloc(&ctx->arena, (size_t)n * n + 1);
+    if (!ctx->sharesFaculty) return -1;
+    
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            unsigned char *shares = &ctx->sharesFaculty[i * n + j];
+            for (int a = 0; a < ctx->subjects[i].facultyCount && !*shares; a++) {
+                for (int b = 0; b < ctx->subjects[j].facultyCount; b++) {
+                    if (ctx->subjects[i].facultyIds[a] == ctx->subjects[j].facultyIds[b]) {
+                        *shares = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Build the faculty-conflict graph from the faculty lists: group the
+// subjects by faculty member, then merge each subject's groups. Runs in
+// time proportional to the edges. Returns 0, or -1 when out of memory.
+int buildConflictGraph(SchedulerContext *ctx) {
+    int n = ctx->subjectCount;
+    int faculties = ctx->totalFaculties;
+    int *teachingFirst = arenaAlloc(&ctx->arena, (faculties + 1) * sizeof(int));
+    int *stamp = malloc((n + 1) * sizeof(int));
+    int *first = arenaAlloc(&ctx->arena, (n + 1) * sizeof(int));
+    if (!teachingFirst || !stamp || !first) goto fail;
+    
+    // Subjects taught by faculty f are teaching[teachingFirst[f] .. teachingFirst[f + 1])
+    int links = 0;
+    for (int i = 0; i < n; i++) {
+        for (int a = 0; a < ctx->subjects[i].facultyCount; a++) {
+            teachingFirst[ctx->subjects[i].facultyIds[a] + 1]++;
+            links++;
+        }
+    }
+    for (int f = 0; f < faculties; f++) {
+        teachingFirst[f + 1] += teachingFirst[f];
+    }
+    int *teaching = arenaAlloc(&ctx->arena, (links + 1) * sizeof(int));
+    int *fillAt = malloc((faculties + 1) * sizeof(int));
+    if (!teaching || !fillAt) {
+        free(fillAt);
+        goto fail;
+    }
+    memcpy(fillAt, teachingFirst, faculties * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        for (int a = 0; a < ctx->subjects[i].facultyCount; a++) {
+            teaching[fillAt[ctx->subjects[i].facultyIds[a]]++] = i;
+        }
+    }
+    free(fillAt);
+    
+    // Two passes over every subject's faculty groups: count the distinct
+    // neighbours, then list them (stamp[j] marks j as seen for subject i)
+    int *list = NULL;
+    for (int pass = 0; pass < 2; pass++) {
+        int edges = 0;
+        for (int j = 0; j < n; j++) stamp[j] = -1;
+        for (int i = 0; i < n; i++) {
+            first[i] = edges;
+            for (int a = 0; a < ctx->subjects[i].facultyCount; a++) {
+                int f = ctx->subjects[i].facultyIds[a];
+                for (int k = teachingFirst[f]; k < teachingFirst[f + 1]; k++) {
+                    int j = teaching[k];
+                    if (stamp[j] == i) continue;
+                    stamp[j] = i;
+                    if (list) list[edges] = j;
+                    edges++;
+                }
+            }
+        }
+        first[n] = edges;
+        if (pass == 0) {
+            list = arenaAlloc(&ctx->arena, (edges + 1) * sizeof(int));
+            if (!list) goto fail;
+        }
+    }
+    free(stamp);
+    
+    ctx->conflictFirst = first;
+    ctx->conflictSubjects = list;
+    return 0;
+    
+fail:
+    free(stamp);
+    return -1;
+}
+
+// Apply one key=value field that follows a subject's faculty list:
+// occurrences=N, section=IT-B (or a 1-based number) and room=lab|classroom.
+// Returns 0, or -1 (after a warning) if the field is not understood.
+int applySubjectField(Subject *subject, char *field) {
+    char *value = strchr(field, '=');
+    if (value) *value++ = '\0';
+    char *key = trimName(field);
+    value = value ? trimName(value) : "";
+    
+    if (strcmp(key, "occurrences") == 0 && value[0] != '\0' &&
+        strspn(value, "0123456789") == strlen(value) && strlen(value) < 6) {
+        subject->occurrences = atoi(value);
+    } else if (strcmp(key, "section") == 0 && sectionIndex(value) >= 0) {
+        subject->section_specific = 1;
+        subject->target_section = sectionIndex(value);
+    } else if (strcmp(key, "room") == 0 && strcmp(value, roomTypeNames[ROOM_LAB]) == 0) {
+        subject->roomType = ROOM_LAB;
+    } else if (strcmp(key, "room") == 0 && strcmp(value, roomTypeNames[ROOM_CLASSROOM]) == 0) {
+        subject->roomType = ROOM_CLASSROOM;
+    } else {
+        printf("Warning: Ignoring field '%s=%s' for subject %s\n", key, value, subject->name);
+        return -1;
+    }
+    return 0;
+}
+
+// Give a room its position among the rooms of its type. Returns 0, or -1
+// when the type already has MAX_ROOMS_PER_TYPE rooms.
+int indexRoom(SchedulerContext *ctx, int room) {
+    Room *declared = &ctx->rooms[room];
+    if (ctx->roomTypeCount[declared->type] >= MAX_ROOMS_PER_TYPE) return -1;
+    declared->bit = ctx->roomTypeCount[declared->type]++;
+    ctx->typeRooms[declared->type][declared->bit] = room;
+    return 0;
+}
+
+// Find a subject by name (-1 if there is none)
+int findSubject(const SchedulerContext *ctx, const char *name) {
+    for (int i = 0; i < ctx->subjectCount; i++) {
+        if (strcmp(ctx->subjects[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+// Split a directive line "@name argument" in place; returns the name
+char *splitDirective(char *line, char **argument) {
+    char *name = line + 1;
+    size_t length = strcspn(name, " \t\r");
+    *argument = trimName(name + length);
+    name[length] = '\0';
+    return name;
+}
+
+// Order in which directives are applied: @days and @slots reset the breaks
+// and day lengths, and every other directive names the grid's days and slots
+int directivePass(const char *name) {
+    if (strcmp(name, "days") == 0 || strcmp(name, "slots") == 0) return 0;
+    if (strcmp(name, "break") == 0 || strcmp(name, "dayslots") == 0) return 1;
+    return 2;
+}
+
+// Apply one grid directive (names and labels are cut to GRID_LABEL_LEN - 1
+// characters):
+//   @days NAME,NAME,...      the days of the week
+//   @slots LABEL,LABEL,...   the column header of every slot of a day
+//   @break SLOT[,NAME]       a slot that is a break on every day (NAME, by
+//                            default BREAK, is printed in its cells)
+//   @dayslots DAY,N          a day that only has its first N slots (a half-day)
+// Returns 1 if it was applied, 0 if name is not a grid directive, or -1
+// (after a warning) if the argument is invalid.
+int applyGridDirective(Grid *grid, const char *name, char *argument) {
+    if (directivePass(name) == 0) {
+        int days = strcmp(name, "days") == 0;
+        int limit = days ? MAX_DAYS : MAX_SLOTS_PER_DAY;
+        char labels[MAX_SLOTS_PER_DAY][GRID_LABEL_LEN];
+        int count = 0;
+        for (char *label = strtok(argument, ","); label && count >= 0; label = strtok(NULL, ",")) {
+            label = trimName(label);
+            if (label[0] == '\0' || count == limit) {
+                count = -1;
+            } else {
+                snprintf(labels[count++], GRID_LABEL_LEN, "%s", label);
+            }
+        }
+        if (count < 1) {
+            printf("Warning: Ignoring @%s (expected 1 to %d names separated by commas)\n", name, limit);
+            return -1;
+        }
+        if (days) {
+            grid->days = count;
+            memcpy(grid->dayNames, labels, count * sizeof(labels[0]));
+        } else {
+            grid->slotsPerDay = count;
+            memcpy(grid->slotTimes, labels, count * sizeof(labels[0]));
+            grid->breakSlots = 0;
+        }
+        for (int d = 0; d < MAX_DAYS; d++) {
+            grid->daySlots[d] = grid->slotsPerDay;
+        }
+        return 1;
+    }
+    if (strcmp(name, "break") == 0) {
+        char *comma = strchr(argument, ',');
+        if (comma) *comma = '\0';
+        char *end;
+        long slot = strtol(argument, &end, 10);
+        if (*trimName(end) != '\0' || end == argument || slot < 1 || slot > grid->slotsPerDay) {
+            printf("Warning: Ignoring @break %s (expected a slot from 1 to %d)\n", argument, grid->slotsPerDay);
+            return -1;
+        }
+        grid->breakSlots |= 1u << (slot - 1);
+        snprintf(grid->breakNames[slot - 1], GRID_LABEL_LEN, "%s",
+                 comma && trimName(comma + 1)[0] != '\0' ? trimName(comma + 1) : "BREAK");
+        return 1;
+    }
+    if (strcmp(name, "dayslots") == 0) {
+        char *comma = strchr(argument, ',');
+        if (comma) *comma = '\0';
+        char *dayName = trimName(argument);
+        int day = comma ? parseDay(grid, dayName, strlen(dayName)) : -1;
+        char *end = "";
+        long slots = comma ? strtol(comma + 1, &end, 10) : -1;
+        if (day < 0 || *trimName(end) != '\0' || slots < 0 || slots > grid->slotsPerDay) {
+            printf("Warning: Ignoring @dayslots %s (expected DAY,N with N from 0 to %d)\n",
+                   argument, grid->slotsPerDay);
+            return -1;
+        }
+        grid->daySlots[day] = (int)slots;
+        return 1;
+    }
+    return 0;
+}
+
+// Apply the grid directives among count split directive lines, in
+// directivePass() order, and derive the grid's masks. Returns 0, or -1
+// (after an error) if the resulting week does not fit the limits.
+int applyGridDirectives(Grid *grid, char **names, char **arguments, int count) {
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < count; i++) {
+            if (directivePass(names[i]) == pass) applyGridDirective(grid, names[i], arguments[i]);
+        }
+    }
+    if (buildGrid(grid) != 0) {
+        printf("ERROR: A week of %d days with %d slots does not fit into %d cells\n",
+               grid->days, grid->slotsPerDay, MAX_TOTAL_SLOTS);
+        return -1;
+    }
+    return 0;
+}
+
+// Apply the directive lines of a text input once its subjects and faculty
+// are known, setting up the grid and building the pin and room tables:
+//   @days, @slots, @break, @dayslots (see applyGridDirective())
+//   @sections N
+//   @unavailable FACULTY@DAY[:SLOT[-SLOT]]
+//   @pin SECTION,DAY,SLOT,SUBJECT    (the order of saved solutions)
+//   @room NAME,lab|classroom
+// A line that cannot be applied is reported and skipped. Returns 0, or -1
+// (after an error) when out of memory or the grid is invalid.
+int applyDirectives(SchedulerContext *ctx, char **lines, int count) {
+    int verbose = ctx->options.verbose;
+    char **arguments = arenaAlloc(&ctx->arena, (count + 1) * sizeof(char *));
+    ctx->pins = arenaAlloc(&ctx->arena, (count + 1) * sizeof(Pin));
+    ctx->rooms = arenaAlloc(&ctx->arena, (count + 1) * sizeof(Room));
+    if (!arguments || !ctx->pins || !ctx->rooms) {
+        printf("ERROR: Out of memory while applying the directives\n");
+        return -1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        lines[i] = splitDirective(lines[i], &arguments[i]);
+    }
+    if (applyGridDirectives(&ctx->grid, lines, arguments, count) != 0) return -1;
+    LOG(verbose, LOG_DEBUG, "Grid: %d days of %d slots, %d teaching cells\n",
+        ctx->grid.days, ctx->grid.slotsPerDay, POPCOUNT64(ctx->grid.teachingMask));
+    
+    for (int i = 0; i < count; i++) {
+        char *name = lines[i];
+        char *argument = arguments[i];
+        
+        if (directivePass(name) < 2) {
+            continue;
+        } else if (strcmp(name, "sections") == 0) {
+            int sections = strspn(argument, "0123456789") == strlen(argument) && strlen(argument) < 6 ?
+                           atoi(argument) : 0;
+            if (sections < 1 || schedulerSetSections(ctx, sections) != 0) {
+                printf("Warning: Ignoring @sections %s\n", argument);
+                continue;
+            }
+            ctx->inputSections = sections;
+            LOG(verbose, LOG_DEBUG, "Sections: %d\n", sections);
+        } else if (strcmp(name, "unavailable") == 0) {
+            if (applyUnavailable(ctx, argument) != 0) {
+                printf("Warning: Ignoring @unavailable %s (unknown faculty, day or slot)\n", argument);
+                continue;
+            }
+            LOG(verbose, LOG_DEBUG, "Unavailable: %s\n", argument);
+        } else if (strcmp(name, "pin") == 0) {
+            char *fields[4] = {NULL, NULL, NULL, NULL};
+            for (int f = 0; f < 4; f++) {
+                fields[f] = strtok(f == 0 ? argument : NULL, f < 3 ? "," : "\n");
+                if (!fields[f]) break;
+                fields[f] = trimName(fields[f]);
+            }
+            int section = fields[0] ? sectionIndex(fields[0]) : -1;
+            int day = fields[1] ? parseDay(&ctx->grid, fields[1], strlen(fields[1])) : -1;
+            int slot = fields[2] ? atoi(fields[2]) - 1 : -1;
+            int subIdx = fields[3] ? findSubject(ctx, fields[3]) : -1;
+            if (section < 0 || day < 0 || slot < 0 || slot >= ctx->grid.slotsPerDay || subIdx < 0) {
+                printf("Warning: Ignoring @pin %s,%s,%s,%s (unknown section, day, slot or subject)\n",
+                       fields[0] ? fields[0] : "", fields[1] ? fields[1] : "",
+                       fields[2] ? fields[2] : "", fields[3] ? fields[3] : "");
+                continue;
+            }
+            ctx->pins[ctx->pinCount++] = (Pin){section, subIdx, CELL_INDEX(&ctx->grid, day, slot)};
+            LOG(verbose, LOG_DEBUG, "Pinned %s for section %d on %s slot %d\n",
+                ctx->subjects[subIdx].name, section + 1, ctx->grid.dayNames[day], slot + 1);
+        } else if (strcmp(name, "room") == 0) {
+            char *comma = strrchr(argument, ',');
+            char *type = comma ? trimName(comma + 1) : "";
+            if (comma) *comma = '\0';
+            Room *room = &ctx->rooms[ctx->roomCount];
+            room->name = trimName(argument);
+            if (strcmp(type, roomTypeNames[ROOM_LAB]) == 0) {
+                room->type = ROOM_LAB;
+            } else if (strcmp(type, roomTypeNames[ROOM_CLASSROOM]) == 0) {
+                room->type = ROOM_CLASSROOM;
+            } else {
+                printf("Warning: Ignoring @room %s (expected NAME,lab or NAME,classroom)\n", room->name);
+                continue;
+            }
+            if (room->name[0] == '\0') {
+                printf("Warning: Ignoring @room without a name\n");
+                continue;
+            }
+            if (indexRoom(ctx, ctx->roomCount) != 0) {
+                printf("Warning: Ignoring @room %s (at most %d rooms of one type)\n", room->name, MAX_ROOMS_PER_TYPE);
+                continue;
+            }
+            ctx->roomCount++;
+            LOG(verbose, LOG_DEBUG, "Room %s: %s\n", room->name, roomTypeNames[room->type]);
+        } else {
+            printf("Warning: Unknown directive @%s\n", name);
+        }
+    }
+    return 0;
+}
+
+// Read the whole file into the arena as one NUL-terminated buffer
+char *readFileToArena(Arena *arena, FILE *fp, size_t *length) {
+    if (fseek(fp, 0, SEEK_END) != 0) return NULL;
+    long size = ftell(fp);
+    if (size < 0 || fseek(fp, 0, SEEK_SET) != 0) return NULL;
+    
+    char *buffer = arenaAlloc(arena, (size_t)size + 1);
+    if (!buffer) return NULL;
+    *length = fread(buffer, 1, (size_t)size, fp);
+    buffer[*length] = '\0';
+    return buffer;
+}
+
+// Read a grid file: @days, @slots, @break and @dayslots lines applied to
+// the built-in grid. Returns 0, or -1 if the file cannot be read or the
+// grid is invalid.
+int readGridFile(Grid *grid, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        printf("Cannot open grid file: %s\n", filename);
+        return -1;
+    }
+    
+    Arena arena = {0};
+    size_t length = 0;
+    char *text = readFileToArena(&arena, fp, &length);
+    fclose(fp);
+    int maxLines = 1;
+    for (size_t i = 0; text && i < length; i++) {
+        if (text[i] == '\n') maxLines++;
+    }
+    char **names = text ? arenaAlloc(&arena, maxLines * sizeof(char *)) : NULL;
+    char **arguments = text ? arenaAlloc(&arena, maxLines * sizeof(char *)) : NULL;
+    if (!names || !arguments) {
+        printf("ERROR: Could not read grid file %s\n", filename);
+        arenaFree(&arena);
+        return -1;
+    }
+    
+    int count = 0;
+    char *next = text;
+    while (*next) {
+        char *line = next;
+        char *newline = strchr(line, '\n');
+        if (newline) {
+            *newline = '\0';
+            next = newline + 1;
+        } else {
+            next = line + strlen(line);
+        }
+        line = trimName(line);
+        if (line[0] == '\0') continue;
+        
+        names[count] = line[0] == '@' ? splitDirective(line, &arguments[count]) : line;
+        if (line[0] != '@' || directivePass(names[count]) == 2) {
+            printf("Warning: Ignoring '%s' in grid file %s\n", line, filename);
+            continue;
+        }
+        count++;
+    }
+    
+    setDefaultGrid(grid);
+    int result = applyGridDirectives(grid, names, arguments, count);
+    arenaFree(&arena);
+    return result;
+}
+
+// Parse subjects text held in the context's arena; the subject and faculty
+// names point into it. filename only labels the messages.
+int readSubjectsFromText(SchedulerContext *ctx, char *text, size_t length, const char *filename) {
+    int verbose = ctx->options.verbose; // Log every field only when asked to
+    
+    // Size every table from the input: one subject per line at most, and
+    // no more faculty entries than names separated by ';'
+    int maxSubjects = 1;
+    int maxFacultyRefs = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\n') maxSubjects++;
+        if (text[i] == '\n' || text[i] == ';') maxFacultyRefs++;
+    }
+    ctx->facultyCapacity = maxFacultyRefs;
+    ctx->facultyHashSize = 16;
+    while (ctx->facultyHashSize < 2 * maxFacultyRefs) {
+        ctx->facultyHashSize *= 2;
+    }
+    ctx->subjects = arenaAlloc(&ctx->arena, maxSubjects * sizeof(Subject));
+    ctx->allFaculties = arenaAlloc(&ctx->arena, maxFacultyRefs * sizeof(const char *));
+    ctx->facultyHash = arenaAlloc(&ctx->arena, ctx->facultyHashSize * sizeof(int));
+    int *facultyPool = arenaAlloc(&ctx->arena, maxFacultyRefs * sizeof(int));
+    char **directives = arenaAlloc(&ctx->arena, maxSubjects * sizeof(char *));
+    int directiveCount = 0;
+    if (!ctx->subjects || !ctx->allFaculties || !ctx->facultyHash || !facultyPool || !directives) {
+        printf("ERROR: Out of memory while reading %s\n", filename);
+        return -1;
+    }
+    for (int i = 0; i < ctx->facultyHashSize; i++) {
+        ctx->facultyHash[i] = -1;
+    }
+    
+    char *next = text;
+    while (*next) {
+        // Cut the next line out of the buffer
+        char *line = next;
+        char *newline = strchr(line, '\n');
+        if (newline) {
+            *newline = '\0';
+            next = newline + 1;
+        } else {
+            next = line + strlen(line);
+        }
+        
+        LOG(verbose, LOG_DEBUG, "Processing line: %s\n", line);
+        
+        // Directives refer to subjects and faculty, so they wait for the whole file
+        if (line[0] == '@') {
+            directives[directiveCount++] = line;
+            continue;
+        }
+
+        Subject *subject = &ctx->subjects[ctx->subjectCount];
+        char *token = strtok(line, ",");
+        if (!token) {
+            printf("Warning: Invalid line format (no subject name)\n");
+            continue;
+        }
+        
+        subject->name = trimName(token);
+        LOG(verbose, LOG_DEBUG, "Subject name: %s\n", subject->name);
+
+        token = strtok(NULL, ",");
+        if (!token) {
+            printf("Warning: Invalid line format (no duration) for subject %s\n", subject->name);
+            continue;
+        }
+        
+        subject->duration = atoi(token);
+        if (subject->duration < 1 || subject->duration > MAX_DURATION) {
+            printf("Warning: Invalid duration for subject %s (must be 1 to %d hours)\n",
+                   subject->name, MAX_DURATION);
+            continue;
+        }
+        LOG(verbose, LOG_DEBUG, "Duration: %d\n", subject->duration);
+
+        // The faculty list runs up to the first comma; key=value fields follow
+        token = strtok(NULL, "\n");
+        char *fields = token ? strchr(token, ',') : NULL;
+        if (fields) *fields++ = '\0';
+        
+        // Faculty IDs are appended to the shared pool
+        int *ids = facultyPool;
+        subject->facultyIds = ids;
+        subject->facultyCount = 0;
+        if (token && trimName(token)[0] != '\0') {
+            char *faculty = strtok(token, ";");
+            while (faculty) {
+                int id = internFaculty(ctx, trimName(faculty));
+                if (id != -1) {
+                    ids[subject->facultyCount++] = id;
+                    LOG(verbose, LOG_DEBUG, "Faculty %d: %s\n", subject->facultyCount, ctx->allFaculties[id]);
+                }
+                faculty = strtok(NULL, ";");
+            }
+        } else {
+            LOG(verbose, LOG_DEBUG, "No faculties for this subject\n");
+        }
+        facultyPool += subject->facultyCount;
+
+        // By default, subject is not section-specific and labs need a lab room
+        subject->section_specific = 0;
+        subject->target_section = -1;
+        subject->roomType = subject->duration >= 2 ? ROOM_LAB : ROOM_CLASSROOM;
+        
+        // Set default occurrences based on subject type
+        setDefaultOccurrences(subject);
+        
+        // Explicit fields override the defaults
+        while (fields) {
+            char *field = fields;
+            fields = strchr(fields, ',');
+            if (fields) *fields++ = '\0';
+            applySubjectField(subject, field);
+        }
+        LOG(verbose, LOG_DEBUG, "Set occurrences for %s: %d\n", subject->name, subject->occurrences);
+        
+        ctx->subjectCount++;
+    }
+
+    LOG(verbose, LOG_INFO, "Total subjects read: %d\n", ctx->subjectCount);
+    
+    ctx->facultyBlocked = arenaAlloc(&ctx->arena, (ctx->totalFaculties + 1) * sizeof(uint64_t));
+    if (!ctx->facultyBlocked || buildFacultyConflicts(ctx) != 0) {
+        printf("ERROR: Out of memory while reading %s\n", filename);
+        return -1;
+    }
+    if (applyDirectives(ctx, directives, directiveCount) != 0) return -1;
+    return ctx->subjectCount;
+}
+
+int readSubjectsFromFile(SchedulerContext *ctx, const char *filename) {
+    LOG(ctx->options.verbose, LOG_DEBUG, "Attempting to open file: %s\n", filename);
+    
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        printf("Cannot open file: %s\n", filename);
+        printf("Try using full path or check if file exists in current directory.\n");
+        return -1;
+    }
+    
+    LOG(ctx->options.verbose, LOG_DEBUG, "File opened successfully.\n");
+    
+    size_t length = 0;
+    char *text = readFileToArena(&ctx->arena, fp, &length);
+    fclose(fp);
+    if (!text) {
+        printf("ERROR: Could not read file %s\n", filename);
+        return -1;
+    }
+    return readSubjectsFromText(ctx, text, length, filename);
+}
+
+// ---------------------------------------------------------------------------
+// Compiled instances
+//
+// `--compile` validates the text input once and writes it as a binary file
+// that holds the interned faculty table with its hash, the subject records,
+// the faculty conflict matrix and the input's grid, blackouts, pins, rooms
+// and section count. Loading maps the file read-only and points the context
+// straight into it; only the records that hold pointers and the writable
+// blackout masks are built at load time.
+// All offsets are from the start of the file; every table is 8-byte aligned.
+// ---------------------------------------------------------------------------
+
+#define COMPILED_MAGIC "TTINST\r\n"
+#define COMPILED_VERSION 3
+#define COMPILED_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;      // COMPILED_BYTE_ORDER as written by the compiling host
+    uint64_t fileSize;
+    int32_t subjectCount;
+    int32_t totalFaculties;
+    int32_t facultyRefCount; // Entries in the faculty ID pool
+    int32_t facultyHashSize;
+    uint64_t subjectsOffset; // CompiledSubject[subjectCount]
+    uint64_t facultyIdsOffset; // int32_t[facultyRefCount]
+    uint64_t facultyNamesOffset; // uint32_t[totalFaculties], offsets into the string pool
+    uint64_t facultyHashOffset; // int32_t[facultyHashSize]
+    uint64_t sharesOffset;   // unsigned char[subjectCount * subjectCount]
+    uint64_t blockedOffset;  // uint64_t[totalFaculties], blackouts set by the input
+    uint64_t pinsOffset;     // CompiledPin[pinCount]
+    uint64_t roomsOffset;    // CompiledRoom[roomCount]
+    uint64_t gridOffset;     // CompiledGrid
+    int32_t pinCount;
+    int32_t roomCount;
+    int32_t sectionCount;    // Set by the input, 0 to keep the caller's count
+    int32_t reserved;
+    uint64_t stringsOffset;  // NUL-terminated names
+    uint64_t stringsSize;
+} CompiledHeader;
+
+typedef struct {
+    uint32_t nameOffset;     // Into the string pool
+    int32_t duration;
+    int32_t occurrences;
+    int32_t facultyStart;    // Index of the first ID in the faculty ID pool
+    int32_t facultyCount;
+    int32_t sectionSpecific;
+    int32_t targetSection;
+    int32_t roomType;
+} CompiledSubject;
+
+typedef struct {
+    int32_t section;
+    int32_t subjectIndex;
+    int32_t cell;
+} CompiledPin;
+
+typedef struct {
+    uint32_t nameOffset;     // Into the string pool
+    int32_t type;
+} CompiledRoom;
+
+// The grid's days, slots and breaks; its masks are derived again at load time
+typedef struct {
+    int32_t days;
+    int32_t slotsPerDay;
+    int32_t daySlots[MAX_DAYS];
+    uint32_t breakSlots;
+    char dayNames[MAX_DAYS][GRID_LABEL_LEN];
+    char slotTimes[MAX_SLOTS_PER_DAY][GRID_LABEL_LEN];
+    char breakNames[MAX_SLOTS_PER_DAY][GRID_LABEL_LEN];
+} CompiledGrid;
+
+#define ALIGN8(x) (((x) + 7) & ~(uint64_t)7)
+
+// Check a loaded text instance before it is compiled. Returns the number of
+// errors found (each one is printed).
+int validateInstance(const SchedulerContext *ctx) {
+    int errors = 0;
+    for (int i = 0; i < ctx->subjectCount; i++) {
+        const Subject *subject = &ctx->subjects[i];
+        if (subject->name[0] == '\0') {
+            printf("ERROR: Subject %d has no name\n", i + 1);
+            errors++;
+        }
+        if (ctx->grid.startMask[subject->duration] == 0) {
+            printf("ERROR: Subject %s takes %d hours, but no day has that many slots in a row\n",
+                   subject->name, subject->duration);
+            errors++;
+        }
+        if (subject->occurrences > ctx->grid.days) {
+            printf("ERROR: Subject %s needs %d days a week\n", subject->name, subject->occurrences);
+            errors++;
+        }
+        if (subject->section_specific && subject->target_section >= ctx->sectionCount) {
+            printf("ERROR: Subject %s is for section %d, but there are only %d sections\n",
+                   subject->name, subject->target_section + 1, ctx->sectionCount);
+            errors++;
+        }
+        for (int j = 0; j < i; j++) {
+            if (strcmp(ctx->subjects[j].name, subject->name) == 0) {
+                printf("ERROR: Subject %s is listed twice\n", subject->name);
+                errors++;
+                break;
+            }
+        }
+    }
+    return errors;
+}
+
+// Write the loaded instance as a compiled file. Returns 0 on success.
+int writeCompiledInstance(const SchedulerContext *ctx, const char *filename) {
+    int n = ctx->subjectCount;
+    int refs = 0;
+    uint64_t stringsSize = 0;
+    for (int i = 0; i < n; i++) {
+        refs += ctx->subjects[i].facultyCount;
+        stringsSize += strlen(ctx->subjects[i].name) + 1;
+    }
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        stringsSize += strlen(ctx->allFaculties[f]) + 1;
+    }
+    for (int r = 0; r < ctx->roomCount; r++) {
+        stringsSize += strlen(ctx->rooms[r].name) + 1;
+    }
+    
+    CompiledHeader header = {0};
+    memcpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+    header.version = COMPILED_VERSION;
+    header.byteOrder = COMPILED_BYTE_ORDER;
+    header.subjectCount = n;
+    header.totalFaculties = ctx->totalFaculties;
+    header.facultyRefCount = refs;
+    header.facultyHashSize = ctx->facultyHashSize;
+    header.subjectsOffset = ALIGN8(sizeof(CompiledHeader));
+    header.facultyIdsOffset = ALIGN8(header.subjectsOffset + (uint64_t)n * sizeof(CompiledSubject));
+    header.facultyNamesOffset = ALIGN8(header.facultyIdsOffset + (uint64_t)refs * sizeof(int32_t));
+    header.facultyHashOffset = ALIGN8(header.facultyNamesOffset + (uint64_t)ctx->totalFaculties * sizeof(uint32_t));
+    header.sharesOffset = ALIGN8(header.facultyHashOffset + (uint64_t)ctx->facultyHashSize * sizeof(int32_t));
+    header.blockedOffset = ALIGN8(header.sharesOffset + (uint64_t)n * n);
+    header.pinsOffset = ALIGN8(header.blockedOffset + (uint64_t)ctx->totalFaculties * sizeof(uint64_t));
+    header.roomsOffset = ALIGN8(header.pinsOffset + (uint64_t)ctx->pinCount * sizeof(CompiledPin));
+    header.gridOffset = ALIGN8(header.roomsOffset + (uint64_t)ctx->roomCount * sizeof(CompiledRoom));
+    header.pinCount = ctx->pinCount;
+    header.roomCount = ctx->roomCount;
+    header.sectionCount = ctx->inputSections;
+    header.stringsOffset = ALIGN8(header.gridOffset + sizeof(CompiledGrid));
+    header.stringsSize = stringsSize;
+    header.fileSize = header.stringsOffset + stringsSize;
+    
+    char *image = calloc(1, header.fileSize);
+    if (!image) {
+        printf("ERROR: Out of memory while compiling\n");
+        return -1;
+    }
+    memcpy(image, &header, sizeof(header));
+    
+    CompiledSubject *records = (CompiledSubject *)(image + header.subjectsOffset);
+    int32_t *ids = (int32_t *)(image + header.facultyIdsOffset);
+    uint32_t *names = (uint32_t *)(image + header.facultyNamesOffset);
+    char *strings = image + header.stringsOffset;
+    uint32_t used = 0;
+    int next = 0;
+    for (int i = 0; i < n; i++) {
+        const Subject *subject = &ctx->subjects[i];
+        records[i] = (CompiledSubject){used, subject->duration, subject->occurrences, next,
+                                       subject->facultyCount, subject->section_specific,
+                                       subject->target_section, subject->roomType};
+        strcpy(strings + used, subject->name);
+        used += strlen(subject->name) + 1;
+        for (int f = 0; f < subject->facultyCount; f++) {
+            ids[next++] = subject->facultyIds[f];
+        }
+    }
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        names[f] = used;
+        strcpy(strings + used, ctx->allFaculties[f]);
+        used += strlen(ctx->allFaculties[f]) + 1;
+    }
+    CompiledRoom *rooms = (CompiledRoom *)(image + header.roomsOffset);
+    for (int r = 0; r < ctx->roomCount; r++) {
+        rooms[r] = (CompiledRoom){used, ctx->rooms[r].type};
+        strcpy(strings + used, ctx->rooms[r].name);
+        used += strlen(ctx->rooms[r].name) + 1;
+    }
+    CompiledPin *pins = (CompiledPin *)(image + header.pinsOffset);
+    for (int p = 0; p < ctx->pinCount; p++) {
+        pins[p] = (CompiledPin){ctx->pins[p].section, ctx->pins[p].subIdx, ctx->pins[p].cell};
+    }
+    memcpy(image + header.facultyHashOffset, ctx->facultyHash, ctx->facultyHashSize * sizeof(int32_t));
+    memcpy(image + header.sharesOffset, ctx->sharesFaculty, (size_t)n * n);
+    memcpy(image + header.blockedOffset, ctx->facultyBlocked, ctx->totalFaculties * sizeof(uint64_t));
+    
+    const Grid *grid = &ctx->grid;
+    CompiledGrid *compiledGrid = (CompiledGrid *)(image + header.gridOffset);
+    compiledGrid->days = grid->days;
+    compiledGrid->slotsPerDay = grid->slotsPerDay;
+    for (int d = 0; d < MAX_DAYS; d++) {
+        compiledGrid->daySlots[d] = grid->daySlots[d];
+    }
+    compiledGrid->breakSlots = grid->breakSlots;
+    memcpy(compiledGrid->dayNames, grid->dayNames, sizeof(grid->dayNames));
+    memcpy(compiledGrid->slotTimes, grid->slotTimes, sizeof(grid->slotTimes));
+    memcpy(compiledGrid->breakNames, grid->breakNames, sizeof(grid->breakNames));
+    
+    FILE *fp = fopen(filename, "wb");
+    int ok = fp && fwrite(image, 1, header.fileSize, fp) == header.fileSize;
+    if (fp && fclose(fp) != 0) ok = 0;
+    free(image);
+    if (!ok) {
+        printf("Error writing to file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// Check that a table of count elements lies inside the mapped file
+int tableFits(const CompiledHeader *header, uint64_t offset, uint64_t count, uint64_t size) {
+    return offset % 8 == 0 && offset <= header->fileSize &&
+           count <= (header->fileSize - offset) / size;
+}
+
+// Map a compiled instance and point the context into it. The caller has
+// already released the previous input. Returns the number of subjects, or
+// -1 if the file is not a valid compiled instance for this build.
+int loadCompiledInstance(SchedulerContext *ctx, int fd, size_t fileSize, const char *filename) {
+    void *map = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        printf("ERROR: Could not map file %s\n", filename);
+        return -1;
+    }
+    ctx->mapping = map;
+    ctx->mappingSize = fileSize;
+    
+    const char *image = map;
+    const CompiledHeader *header = map;
+    int n = header->subjectCount;
+    if (header->version != COMPILED_VERSION || header->byteOrder != COMPILED_BYTE_ORDER) {
+        printf("ERROR: %s was compiled by a different version; compile it again\n", filename);
+        return -1;
+    }
+    if (header->fileSize != fileSize || n < 0 || header->totalFaculties < 0 ||
+        header->facultyRefCount < 0 || header->facultyHashSize <= 0 ||
+        (header->facultyHashSize & (header->facultyHashSize - 1)) != 0 ||
+        !tableFits(header, header->subjectsOffset, n, sizeof(CompiledSubject)) ||
+        !tableFits(header, header->facultyIdsOffset, header->facultyRefCount, sizeof(int32_t)) ||
+        !tableFits(header, header->facultyNamesOffset, header->totalFaculties, sizeof(uint32_t)) ||
+        !tableFits(header, header->facultyHashOffset, header->facultyHashSize, sizeof(int32_t)) ||
+        !tableFits(header, header->sharesOffset, (uint64_t)n * n, 1) ||
+        header->pinCount < 0 || header->roomCount < 0 || header->sectionCount < 0 ||
+        !tableFits(header, header->blockedOffset, header->totalFaculties, sizeof(uint64_t)) ||
+        !tableFits(header, header->pinsOffset, header->pinCount, sizeof(CompiledPin)) ||
+        !tableFits(header, header->roomsOffset, header->roomCount, sizeof(CompiledRoom)) ||
+        !tableFits(header, header->gridOffset, 1, sizeof(CompiledGrid)) ||
+        header->stringsOffset > fileSize || header->stringsSize != fileSize - header->stringsOffset ||
+        header->stringsSize == 0 || image[fileSize - 1] != '\0') {
+        printf("ERROR: %s is not a valid compiled instance\n", filename);
+        return -1;
+    }
+    
+    const CompiledSubject *records = (const CompiledSubject *)(image + header->subjectsOffset);
+    const int32_t *ids = (const int32_t *)(image + header->facultyIdsOffset);
+    const uint32_t *names = (const uint32_t *)(image + header->facultyNamesOffset);
+    const char *strings = image + header->stringsOffset;
+    
+    ctx->subjects = arenaAlloc(&ctx->arena, (n + 1) * sizeof(Subject));
+    ctx->allFaculties = arenaAlloc(&ctx->arena, (header->totalFaculties + 1) * sizeof(const char *));
+    ctx->facultyBlocked = arenaAlloc(&ctx->arena, (header->totalFaculties + 1) * sizeof(uint64_t));
+    ctx->pins = arenaAlloc(&ctx->arena, (header->pinCount + 1) * sizeof(Pin));
+    ctx->rooms = arenaAlloc(&ctx->arena, (header->roomCount + 1) * sizeof(Room));
+    if (!ctx->subjects || !ctx->allFaculties || !ctx->facultyBlocked || !ctx->pins || !ctx->rooms ||
+        (header->sectionCount > 0 && schedulerSetSections(ctx, header->sectionCount) != 0)) {
+        printf("ERROR: Out of memory while reading %s\n", filename);
+        return -1;
+    }
+    
+    // The grid comes first, since the records are checked against it
+    const CompiledGrid *compiledGrid = (const CompiledGrid *)(image + header->gridOffset);
+    Grid *grid = &ctx->grid;
+    grid->days = compiledGrid->days;
+    grid->slotsPerDay = compiledGrid->slotsPerDay;
+    for (int d = 0; d < MAX_DAYS; d++) {
+        grid->daySlots[d] = compiledGrid->daySlots[d];
+    }
+    grid->breakSlots = compiledGrid->breakSlots;
+    memcpy(grid->dayNames, compiledGrid->dayNames, sizeof(grid->dayNames));
+    memcpy(grid->slotTimes, compiledGrid->slotTimes, sizeof(grid->slotTimes));
+    memcpy(grid->breakNames, compiledGrid->breakNames, sizeof(grid->breakNames));
+    for (int d = 0; d < MAX_DAYS; d++) grid->dayNames[d][GRID_LABEL_LEN - 1] = '\0';
+    for (int s = 0; s < MAX_SLOTS_PER_DAY; s++) {
+        grid->slotTimes[s][GRID_LABEL_LEN - 1] = '\0';
+        grid->breakNames[s][GRID_LABEL_LEN - 1] = '\0';
+    }
+    if (buildGrid(grid) != 0) goto corrupt;
+    
+    const int32_t *hash = (const int32_t *)(image + header->facultyHashOffset);
+    int emptyBuckets = 0;
+    for (int h = 0; h < header->facultyHashSize; h++) {
+        if (hash[h] < -1 || hash[h] >= header->totalFaculties) goto corrupt;
+        emptyBuckets += hash[h] == -1;
+    }
+    if (emptyBuckets == 0) goto corrupt; // Lookups would never terminate
+    
+    for (int f = 0; f < header->totalFaculties; f++) {
+        if (names[f] >= header->stringsSize) goto corrupt;
+        ctx->allFaculties[f] = strings + names[f];
+    }
+    for (int i = 0; i < n; i++) {
+        const CompiledSubject *record = &records[i];
+        if (record->nameOffset >= header->stringsSize || record->facultyStart < 0 ||
+            record->duration < 1 || record->duration > MAX_DURATION ||
+            record->occurrences < 0 || record->occurrences > grid->days ||
+            record->facultyCount < 0 ||
+            record->facultyCount > header->facultyRefCount - record->facultyStart ||
+            (record->sectionSpecific && record->targetSection < 0) ||
+            (record->roomType != ROOM_CLASSROOM && record->roomType != ROOM_LAB)) {
+            goto corrupt;
+        }
+        for (int f = 0; f < record->facultyCount; f++) {
+            int id = ids[record->facultyStart + f];
+            if (id < 0 || id >= header->totalFaculties) goto corrupt;
+        }
+        ctx->subjects[i] = (Subject){strings + record->nameOffset, record->duration,
+                                     record->occurrences, ids + record->facultyStart,
+                                     record->facultyCount, record->sectionSpecific,
+                                     record->targetSection, record->roomType};
+    }
+    
+    const CompiledPin *pins = (const CompiledPin *)(image + header->pinsOffset);
+    for (int p = 0; p < header->pinCount; p++) {
+        if (pins[p].section < 0 || pins[p].subjectIndex < 0 || pins[p].subjectIndex >= n ||
+            pins[p].cell < 0 || pins[p].cell >= grid->days * grid->slotsPerDay) {
+            goto corrupt;
+        }
+        ctx->pins[p] = (Pin){pins[p].section, pins[p].subjectIndex, pins[p].cell};
+    }
+    const CompiledRoom *rooms = (const CompiledRoom *)(image + header->roomsOffset);
+    for (int r = 0; r < header->roomCount; r++) {
+        if (rooms[r].nameOffset >= header->stringsSize ||
+            (rooms[r].type != ROOM_CLASSROOM && rooms[r].type != ROOM_LAB)) {
+            goto corrupt;
+        }
+        ctx->rooms[r] = (Room){strings + rooms[r].nameOffset, rooms[r].type, 0};
+        if (indexRoom(ctx, r) != 0) goto corrupt;
+    }
+    memcpy(ctx->facultyBlocked, image + header->blockedOffset, header->totalFaculties * sizeof(uint64_t));
+    
+    // The hash table and conflict matrix are only read after loading
+    ctx->facultyHash = (int *)hash;
+    ctx->facultyHashSize = header->facultyHashSize;
+    ctx->sharesFaculty = (unsigned char *)(image + header->sharesOffset);
+    ctx->totalFaculties = header->totalFaculties;
+    ctx->facultyCapacity = header->totalFaculties;
+    ctx->subjectCount = n;
+    ctx->pinCount = header->pinCount;
+    ctx->roomCount = header->roomCount;
+    ctx->inputSections = header->sectionCount;
+    return n;
+    
+corrupt:
+    printf("ERROR: %s is not a valid compiled instance\n", filename);
+    return -1;
+}
+
+// Cells where a block of duration cells that are all set in free starts,
+// within one day of the grid: one shift-and-AND per extra hour
+uint64_t blockStarts(const Grid *grid, uint64_t free, int duration) {
+    uint64_t starts = free;
+    for (int h = 1; h < duration; h++) {
+        starts &= free >> h;
+    }
+    return starts & grid->startMask[duration];
+}
+
+// All cells where an occurrence of the subject could start for a section.
+// Combines the section and faculty masks in one pass; a longer block
+// additionally needs the following cells free (see blockStarts()).
+uint64_t feasibleStarts(Schedule *sch, int subIdx, int section) {
+    const Subject *subjects = sch->ctx->subjects;
+    const Grid *grid = &sch->ctx->grid;
+    sch->stats.checks++;
+    // Check if subject is section-specific but not for this section
+    if (subjects[subIdx].section_specific && 
+        subjects[subIdx].target_section != section) {
+        return 0;
+    }
+    
+    uint64_t busy = sch->sectionBusy[section];
+    for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
+        busy |= sch->facultyBusy[subjects[subIdx].facultyIds[f]];
+    }
+    
+    int duration = subjects[subIdx].duration;
+    uint64_t free = ~busy & grid->teachingMask;
+    if (duration > 1) {
+        free = blockStarts(grid, free, duration);
+    }
+    uint64_t roomed = free & sch->roomStarts[subjects[subIdx].roomType][duration - 1];
+    
+    // The subject may only appear once per day
+    uint64_t starts = roomed & ~grid->dayCells[SUBJECT_DAYS(sch, section, subIdx)];
+    
+#if TIMETABLE_STATS
+    // Replay the constraints one at a time to charge every rejected cell
+    uint64_t shape = grid->startMask[duration];
+    uint64_t open = blockStarts(grid, ~sch->sectionBusy[section] & grid->teachingMask, duration);
+    sch->stats.rejectedLunch += POPCOUNT64(grid->teachingMask & ~shape);
+    sch->stats.rejectedOccupied += POPCOUNT64(shape & ~open);
+    sch->stats.rejectedFaculty += POPCOUNT64(open & ~free);
+    sch->stats.rejectedRoom += POPCOUNT64(free & ~roomed);
+    sch->stats.rejectedSameDay += POPCOUNT64(roomed & ~starts);
+#endif
+    return starts;
+}
+
+// ---------------------------------------------------------------------------
+// Decision log: an optional binary record of every change to a schedule
+// while it is solved, so that a run can be replayed step by step on another
+// machine (see replayDecisions()). The file starts with DECISION_MAGIC and
+// a header of varints (version, seed, solver, sections, subjects and cells
+// of the grid). Each record is a kind byte followed by its fields as LEB128
+// varints, which keeps a record to a few bytes on any host:
+//   DECISION_RESET       the timetable was reset to the pins
+//   DECISION_PLACE       section, subject, start cell
+//   DECISION_REMOVE      section, subject, start cell
+//   DECISION_REJECT      section, subject, start cell + 1 (0 when no start
+//                        is left for the subject), REJECT_* reason
+//   DECISION_CHECKPOINT  count, then section, subject, start cell and
+//                        room + 1 (0 when it has none; version 1 logs
+//                        leave the room out) of every placement that is
+//                        not a pin. Written when
+//                        a repair starts and whenever a whole schedule is
+//                        copied in (a better attempt, a restored snapshot)
+//   DECISION_ROOM        section, room, start cell: the occurrence there
+//                        moved to another room of its type (version 2)
+// ---------------------------------------------------------------------------
+
+#define DECISION_MAGIC "TTDLOG\r\n"
+#define DECISION_VERSION 2
+
+enum {
+    DECISION_RESET,
+    DECISION_PLACE,
+    DECISION_REMOVE,
+    DECISION_REJECT,
+    DECISION_CHECKPOINT,
+    DECISION_ROOM
+};
+
+// Why a start cell was rejected, in the order feasibleStarts() applies
+// the constraints
+enum {
+    REJECT_SECTION,   // The subject belongs to another section
+    REJECT_BREAK,     // Block would run into a break or the end of the day
+    REJECT_OCCUPIED,  // Section already has a class there
+    REJECT_FACULTY,   // A faculty member is busy or unavailable
+    REJECT_ROOM,      // Every room of the subject's type is booked
+    REJECT_SAME_DAY,  // Subject already meets that day
+    REJECT_NO_START,  // No start cell is left for the subject at all
+    REJECT_REASONS
+};
+
+const char *rejectNames[REJECT_REASONS] = {
+    "other section", "break", "section busy", "faculty busy", "no room", "same day", "no start left"
+};
+
+// First constraint that rules out a start cell (REJECT_REASONS if none)
+int rejectReason(const Schedule *sch, int subIdx, int section, int cell) {
+    const Subject *subject = &sch->ctx->subjects[subIdx];
+    const Grid *grid = &sch->ctx->grid;
+    uint64_t bit = 1ULL << cell;
+    uint64_t block = subjectBlock(subject, cell);
+    if (subject->section_specific && subject->target_section != section) return REJECT_SECTION;
+    if (!(grid->startMask[subject->duration] & bit)) return REJECT_BREAK;
+    if (sch->sectionBusy[section] & block) return REJECT_OCCUPIED;
+    for (int f = 0; f < subject->facultyCount; f++) {
+        if (sch->facultyBusy[subject->facultyIds[f]] & block) return REJECT_FACULTY;
+    }
+    if (!(sch->roomStarts[subject->roomType][subject->duration - 1] & bit)) return REJECT_ROOM;
+    if (grid->dayCells[SUBJECT_DAYS(sch, section, subIdx)] & bit) return REJECT_SAME_DAY;
+    return REJECT_REASONS;
+}
+
+// Append value as a LEB128 varint; returns the bytes used (at most 10)
+size_t encodeVarint(unsigned char *out, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (unsigned char)value;
+    return n;
+}
+
+// Write one record to the schedule's decision log. Placements and removals
+// use section, subIdx and cell; rejections also reason; resets none.
+void logDecision(Schedule *sch, int kind, int subIdx, int section, int cell, int reason) {
+    unsigned char record[1 + 4 * 10];
+    size_t n = 0;
+    record[n++] = (unsigned char)kind;
+    if (kind != DECISION_RESET) {
+        n += encodeVarint(record + n, (uint64_t)section);
+        n += encodeVarint(record + n, (uint64_t)subIdx);
+        n += encodeVarint(record + n, (uint64_t)(kind == DECISION_REJECT ? cell + 1 : cell));
+    }
+    if (kind == DECISION_REJECT) {
+        n += encodeVarint(record + n, (uint64_t)reason);
+    }
+    fwrite(record, 1, n, sch->decisions->fp);
+    sch->decisions->records++;
+}
+
+// Write every placement of the schedule except the pins as one record
+void logCheckpoint(Schedule *sch) {
+    const SchedulerContext *ctx = sch->ctx;
+    unsigned char buffer[4 * 10];
+    long count = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        // The first pass counts the placements, the second writes them
+        if (pass == 1) {
+            buffer[0] = DECISION_CHECKPOINT;
+            fwrite(buffer, 1, 1 + encodeVarint(buffer + 1, (uint64_t)count), sch->decisions->fp);
+        }
+        for (int s = 0; s < ctx->sectionCount; s++) {
+            const int *row = &sch->timetable[s * MAX_TOTAL_SLOTS];
+            for (int c = 0; c < ctx->grid.cells; c++) {
+                // A placement starts where its subject does not continue one
+                if (row[c] == -1 || (sch->pinnedCells[s] >> c) & 1 ||
+                    (CELL_SLOT(&ctx->grid, c) > 0 && row[c - 1] == row[c])) {
+                    continue;
+                }
+                if (pass == 0) {
+                    count++;
+                    continue;
+                }
+                size_t n = encodeVarint(buffer, (uint64_t)s);
+                n += encodeVarint(buffer + n, (uint64_t)row[c]);
+                n += encodeVarint(buffer + n, (uint64_t)c);
+                n += encodeVarint(buffer + n, (uint64_t)(sch->roomOf[s * MAX_TOTAL_SLOTS + c] + 1));
+                fwrite(buffer, 1, n, sch->decisions->fp);
+            }
+        }
+    }
+    sch->decisions->records++;
+}
+
+// Start logging the decisions of a schedule to filename. Returns 0, or -1
+// (with a message) if the file cannot be created.
+int openDecisionLog(Schedule *sch, const char *filename, uint64_t seed, int solver) {
+    DecisionLog *log = malloc(sizeof(DecisionLog));
+    FILE *fp = log ? fopen(filename, "wb") : NULL;
+    if (!fp) {
+        printf("Error writing to file %s\n", filename);
+        free(log);
+        return -1;
+    }
+    const SchedulerContext *ctx = sch->ctx;
+    unsigned char header[8 + 6 * 10];
+    memcpy(header, DECISION_MAGIC, 8);
+    size_t n = 8;
+    n += encodeVarint(header + n, DECISION_VERSION);
+    n += encodeVarint(header + n, seed);
+    n += encodeVarint(header + n, (uint64_t)solver);
+    n += encodeVarint(header + n, (uint64_t)ctx->sectionCount);
+    n += encodeVarint(header + n, (uint64_t)ctx->subjectCount);
+    n += encodeVarint(header + n, (uint64_t)ctx->grid.cells);
+    fwrite(header, 1, n, fp);
+    
+    log->fp = fp;
+    log->records = 0;
+    sch->decisions = log;
+    return 0;
+}
+
+// Stop logging and close the file. Returns 0, or -1 if a write failed.
+int closeDecisionLog(Schedule *sch, const char *filename) {
+    DecisionLog *log = sch->decisions;
+    if (!log) return 0;
+    sch->decisions = NULL;
+    int failed = ferror(log->fp);
+    if (fclose(log->fp) != 0) failed = 1;
+    if (failed) {
+        printf("ERROR: Could not write the decision log %s\n", filename);
+    } else {
+        LOG(sch->verbose, LOG_INFO, "Decision log: %ld record(s) written to %s\n", log->records, filename);
+    }
+    free(log);
+    return failed ? -1 : 0;
+}
+
+// Check if a subject can be placed at a specific day and time slot
+int canPlaceSubject(Schedule *sch, int subIdx, int day, int slot, int section) {
+    int cell = CELL_INDEX(&sch->ctx->grid, day, slot);
+    int fits = (feasibleStarts(sch, subIdx, section) >> cell) & 1;
+    if (!fits && sch->decisions) {
+        logDecision(sch, DECISION_REJECT, subIdx, section, cell, rejectReason(sch, subIdx, section, cell));
+    }
+    return fits;
+}
+
+// Count how many times a subject appears in a section's timetable
+int countSubjectOccurrences(const Schedule *sch, int subIdx, int section) {
+    // A subject is placed at most once per day
+    return POPCOUNT64(SUBJECT_DAYS(sch, section, subIdx));
+}
+
+// Recompute the room start masks of a type for the starts whose block
+// covers a cell that changed
+void updateRoomStarts(Schedule *sch, int type, int cell) {
+    const Grid *grid = &sch->ctx->grid;
+    const uint64_t *free = sch->roomFree[type];
+    uint64_t *starts = sch->roomStarts[type];
+    for (int c = cell >= MAX_DURATION - 1 ? cell - (MAX_DURATION - 1) : 0; c <= cell; c++) {
+        uint64_t bit = 1ULL << c;
+        uint64_t rooms = ~0ULL;
+        for (int length = 1; length <= MAX_DURATION; length++) {
+            // A block that starts at c and covers cell lies inside the grid
+            rooms = (grid->startMask[length] & bit) ? rooms & free[c + length - 1] : 0;
+            starts[length - 1] = rooms ? starts[length - 1] | bit : starts[length - 1] & ~bit;
+        }
+    }
+}
+
+// Book the room with the given bit (see Room) of the subject's type for an
+// occurrence; the caller has checked that it is free throughout
+void bookRoomBit(Schedule *sch, const Subject *subject, int section, int cell, int bit) {
+    const SchedulerContext *ctx = sch->ctx;
+    int type = subject->roomType;
+    for (int c = cell; c < cell + subject->duration; c++) {
+        sch->roomFree[type][c] &= ~(1ULL << bit);
+        sch->roomOf[section * MAX_TOTAL_SLOTS + c] = ctx->typeRooms[type][bit];
+        updateRoomStarts(sch, type, c);
+    }
+}
+
+// Book the first room of the subject's type that is free for the whole
+// occurrence; the free-room masks make this one AND and a bit scan.
+// Returns 0, or -1 when no room of the type is free throughout (which
+// feasibleStarts() rules out).
+int bookRoom(Schedule *sch, const Subject *subject, int section, int cell) {
+    const SchedulerContext *ctx = sch->ctx;
+    int type = subject->roomType;
+    if (ctx->roomTypeCount[type] == 0) return 0;
+    
+    uint64_t *free = sch->roomFree[type];
+    uint64_t rooms = ~0ULL;
+    for (int c = cell; c < cell + subject->duration; c++) {
+        rooms &= free[c];
+    }
+    if (!rooms) return -1;
+    
+    bookRoomBit(sch, subject, section, cell, CTZ64(rooms));
+    return 0;
+}
+
+// Give back the room booked for an occurrence starting at cell
+void releaseRoom(Schedule *sch, const Subject *subject, int section, int cell) {
+    int room = sch->roomOf[section * MAX_TOTAL_SLOTS + cell];
+    if (room < 0) return;
+    
+    const Room *booked = &sch->ctx->rooms[room];
+    for (int c = cell; c < cell + subject->duration; c++) {
+        sch->roomFree[booked->type][c] |= 1ULL << booked->bit;
+        sch->roomOf[section * MAX_TOTAL_SLOTS + c] = -1;
+        updateRoomStarts(sch, booked->type, c);
+    }
+}
+
+// Move the occurrence starting at cell of a section to the room with the
+// given bit of its type. Returns 0, or -1 when it has no room booked or
+// that room is not free throughout.
+int moveRoom(Schedule *sch, int section, int cell, int bit) {
+    const SchedulerContext *ctx = sch->ctx;
+    int room = sch->roomOf[section * MAX_TOTAL_SLOTS + cell];
+    if (room < 0) return -1;
+    if (ctx->rooms[room].bit == bit) return 0;
+    
+    const Subject *subject = &ctx->subjects[sch->timetable[section * MAX_TOTAL_SLOTS + cell]];
+    int type = subject->roomType;
+    if (bit >= ctx->roomTypeCount[type]) return -1;
+    for (int c = cell; c < cell + subject->duration; c++) {
+        if (!(sch->roomFree[type][c] & (1ULL << bit))) return -1;
+    }
+    
+    if (sch->decisions) logDecision(sch, DECISION_ROOM, ctx->typeRooms[type][bit], section, cell, 0);
+    releaseRoom(sch, subject, section, cell);
+    bookRoomBit(sch, subject, section, cell, bit);
+    return 0;
+}
+
+// Occupy the cells of one occurrence (used by the solvers). Unlike
+// placeSubject() it leaves the statistics and the assigned flag alone; an
+// open decision log still records the placement. Returns 0, or -1 without
+// changing anything when no room is free for the occurrence.
+int occupySlots(Schedule *sch, int subIdx, int day, int slot, int section) {
+    const Subject *subjects = sch->ctx->subjects;
+    int cell = CELL_INDEX(&sch->ctx->grid, day, slot);
+    if (bookRoom(sch, &subjects[subIdx], section, cell) != 0) return -1;
+    if (sch->decisions) logDecision(sch, DECISION_PLACE, subIdx, section, cell, 0);
+    
+    // A longer subject occupies the slots that follow
+    for (int h = 0; h < subjects[subIdx].duration; h++) {
+        sch->timetable[section * MAX_TOTAL_SLOTS + cell + h] = subIdx;
+    }
+    
+    uint64_t block = subjectBlock(&subjects[subIdx], cell);
+    sch->sectionBusy[section] |= block;
+    SUBJECT_DAYS(sch, section, subIdx) |= 1 << day;
+    
+    // Mark faculty as busy
+    for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
+        int id = subjects[subIdx].facultyIds[f];
+        markFacultyBusy(sch, id, block);
+        for (int h = 0; h < subjects[subIdx].duration; h++) {
+            FACULTY_SECTION(sch, id, cell + h) = section;
+        }
+    }
+    return 0;
+}
+
+// Remove one occurrence placed by occupySlots() and free its faculty
+void unplaceSubject(Schedule *sch, int subIdx, int day, int slot, int section) {
+    const Subject *subjects = sch->ctx->subjects;
+    int cell = CELL_INDEX(&sch->ctx->grid, day, slot);
+    if (sch->decisions) logDecision(sch, DECISION_REMOVE, subIdx, section, cell, 0);
+    for (int h = 0; h < subjects[subIdx].duration; h++) {
+        sch->timetable[section * MAX_TOTAL_SLOTS + cell + h] = -1;
+    }
+    
+    uint64_t block = subjectBlock(&subjects[subIdx], cell);
+    sch->sectionBusy[section] &= ~block;
+    SUBJECT_DAYS(sch, section, subIdx) &= ~(1 << day);
+    releaseRoom(sch, &subjects[subIdx], section, cell);
+    
+    for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
+        int id = subjects[subIdx].facultyIds[f];
+        sch->facultyBusy[id] &= ~block;
+        for (int h = 0; h < subjects[subIdx].duration; h++) {
+            FACULTY_SECTION(sch, id, cell + h) = -1;
+        }
+    }
+    ASSIGNED(sch, section, subIdx) = 0;
+}
+
+// Start cell of the occurrence covering a cell of a section. A subject
+// meets at most once a day, so the cells before it in the same day that
+// hold the same subject belong to the same occurrence.
+int placementStart(const Schedule *sch, int section, int cell) {
+    const int *row = &sch->timetable[section * MAX_TOTAL_SLOTS];
+    int first = cell - CELL_SLOT(&sch->ctx->grid, cell);
+    while (cell > first && row[cell - 1] == row[cell]) {
+        cell--;
+    }
+    return cell;
+}
+
+// Place subject in timetable and mark faculty as busy. Returns 0, or -1
+// when no room is free for it (see occupySlots()).
+int placeSubject(Schedule *sch, int subIdx, int day, int slot, int section, int occurrence) {
+    const Subject *subjects = sch->ctx->subjects;
+    LOG(sch->verbose, LOG_DEBUG, "Placing subject %s on day %d, slot %d for section %d (occurrence %d)\n",
+        subjects[subIdx].name, day, slot, section, occurrence);
+    
+    if (occupySlots(sch, subIdx, day, slot, section) != 0) return -1;
+    STAT_ADD(sch, placements, 1);
+    
+    // Mark as fully assigned if all occurrences are scheduled
+    if (occurrence >= subjects[subIdx].occurrences) {
+        ASSIGNED(sch, section, subIdx) = 1;
+    }
+    return 0;
+}
+
+// Size a schedule's arrays for a context. The storage is only reallocated
+// when the instance grew, so repeated solves reuse it. Returns 0 on success.
+int scheduleInit(Schedule *sch, const SchedulerContext *ctx) {
+    size_t cells = (size_t)ctx->sectionCount * MAX_TOTAL_SLOTS;
+    size_t facultyCells = (size_t)ctx->totalFaculties * MAX_TOTAL_SLOTS;
+    size_t pairs = (size_t)ctx->sectionCount * ctx->subjectCount;
+    size_t size = (2 * ctx->sectionCount + ctx->totalFaculties) * sizeof(uint64_t) +
+                  (2 * cells + facultyCells) * sizeof(int) + 2 * pairs;
+    
+    if (size > sch->storageSize) {
+        void *storage = realloc(sch->storage, size);
+        if (!storage) return -1;
+        sch->storage = storage;
+        sch->storageSize = size;
+    }
+    
+    // 64-bit masks first so every array stays aligned
+    char *p = sch->storage;
+    sch->sectionBusy = (uint64_t *)p;
+    p += ctx->sectionCount * sizeof(uint64_t);
+    sch->facultyBusy = (uint64_t *)p;
+    p += ctx->totalFaculties * sizeof(uint64_t);
+    sch->pinnedCells = (uint64_t *)p;
+    p += ctx->sectionCount * sizeof(uint64_t);
+    sch->timetable = (int *)p;
+    p += cells * sizeof(int);
+    sch->roomOf = (int *)p;
+    p += cells * sizeof(int);
+    sch->facultySection = (int *)p;
+    p += facultyCells * sizeof(int);
+    sch->subjectDays = (unsigned char *)p;
+    p += pairs;
+    sch->assigned = (unsigned char *)p;
+    
+    sch->ctx = ctx;
+    return 0;
+}
+
+// Copy the solver state of one schedule into another of the same context.
+// dst keeps its own decision log, which records the copy as a checkpoint.
+// Returns 0 on success, -1 when dst cannot be grown.
+int scheduleCopy(Schedule *dst, const Schedule *src) {
+    void *storage = dst->storage;
+    size_t storageSize = dst->storageSize;
+    DecisionLog *decisions = dst->decisions;
+    *dst = *src;
+    dst->storage = storage;
+    dst->storageSize = storageSize;
+    dst->decisions = decisions;
+    if (scheduleInit(dst, src->ctx) != 0) return -1;
+    memcpy(dst->storage, src->storage, src->storageSize < dst->storageSize ? src->storageSize : dst->storageSize);
+    if (decisions) logCheckpoint(dst);
+    return 0;
+}
+
+void scheduleRelease(Schedule *sch) {
+    free(sch->storage);
+    sch->storage = NULL;
+    sch->storageSize = 0;
+}
+
+// Place the input's pins into a cleared schedule. A pin that does not fit
+// (its section is not scheduled, it clashes with another pin, a blackout or
+// break, or the subject has fewer occurrences than pins) is left out and,
+// if report is not NULL, printed with that prefix. Returns how many were
+// left out.
+int placePins(Schedule *sch, const char *report) {
+    const SchedulerContext *ctx = sch->ctx;
+    int skipped = 0;
+    for (int i = 0; i < ctx->pinCount; i++) {
+        const Pin *pin = &ctx->pins[i];
+        const Subject *subject = &ctx->subjects[pin->subIdx];
+        int day = CELL_DAY(&ctx->grid, pin->cell);
+        int slot = CELL_SLOT(&ctx->grid, pin->cell);
+        const char *reason = NULL;
+        if (pin->section >= ctx->sectionCount) {
+            reason = "there is no such section";
+        } else if (countSubjectOccurrences(sch, pin->subIdx, pin->section) >= subject->occurrences) {
+            reason = "the subject has more pins than occurrences";
+        } else if (!canPlaceSubject(sch, pin->subIdx, day, slot, pin->section)) {
+            reason = "it clashes with another pin, a blackout or a break";
+        }
+        if (reason) {
+            if (report) {
+                printf("%s: Pinned %s for section %d on %s slot %d does not fit: %s\n",
+                       report, subject->name, pin->section + 1, ctx->grid.dayNames[day], slot + 1, reason);
+            }
+            skipped++;
+            continue;
+        }
+        
+        occupySlots(sch, pin->subIdx, day, slot, pin->section);
+        sch->pinnedCells[pin->section] |= subjectBlock(subject, pin->cell);
+        if (countSubjectOccurrences(sch, pin->subIdx, pin->section) >= subject->occurrences) {
+            ASSIGNED(sch, pin->section, pin->subIdx) = 1;
+        }
+    }
+    return skipped;
+}
+
+// Clear the timetable and reset all availability masks
+void clearTimetable(Schedule *sch) {
+    int subjectCount = sch->ctx->subjectCount;
+    int sectionCount = sch->ctx->sectionCount;
+    
+    // Initialize timetable with -1 (free)
+    for (int i = 0; i < sectionCount * MAX_TOTAL_SLOTS; i++) {
+        sch->timetable[i] = -1;
+    }
+    
+    // Initialize section and faculty availability
+    memset(sch->sectionBusy, 0, sectionCount * sizeof(uint64_t));
+    memcpy(sch->facultyBusy, sch->ctx->facultyBlocked, sch->ctx->totalFaculties * sizeof(uint64_t));
+    memset(sch->subjectDays, 0, (size_t)sectionCount * subjectCount);
+    memset(sch->assigned, 0, (size_t)sectionCount * subjectCount);
+    memset(sch->pinnedCells, 0, sectionCount * sizeof(uint64_t));
+    sch->unplaced = 0;
+    
+    // Every declared room is free in every teaching cell
+    const Grid *grid = &sch->ctx->grid;
+    for (int i = 0; i < sectionCount * MAX_TOTAL_SLOTS; i++) {
+        sch->roomOf[i] = -1;
+    }
+    for (int i = 0; i < sch->ctx->totalFaculties * MAX_TOTAL_SLOTS; i++) {
+        sch->facultySection[i] = -1;
+    }
+    for (int type = 0; type < ROOM_TYPES; type++) {
+        int count = sch->ctx->roomTypeCount[type];
+        uint64_t rooms = count < 64 ? (1ULL << count) - 1 : ~0ULL;
+        for (int c = 0; c < MAX_TOTAL_SLOTS; c++) {
+            sch->roomFree[type][c] = (grid->teachingMask >> c) & 1 ? rooms : 0;
+        }
+        for (int length = 1; length <= MAX_DURATION; length++) {
+            sch->roomStarts[type][length - 1] = count > 0 ? grid->startMask[length] : ~0ULL;
+        }
+    }
+}
+
+// Reset the timetable to the pins alone
+void resetTimetable(Schedule *sch) {
+    // A replayed reset places the pins itself, so they are not logged
+    DecisionLog *decisions = sch->decisions;
+    sch->decisions = NULL;
+    clearTimetable(sch);
+    placePins(sch, NULL);
+    sch->decisions = decisions;
+    if (decisions) logDecision(sch, DECISION_RESET, 0, 0, 0, 0);
+}
+
+// Check that the pins of an instance fit together with its blackouts.
+// Returns the number of errors found (each one is printed).
+int checkPins(const SchedulerContext *ctx) {
+    if (ctx->pinCount == 0) return 0;
+    Schedule check = {0};
+    if (scheduleInit(&check, ctx) != 0) {
+        printf("ERROR: Out of memory while checking the pins\n");
+        return 1;
+    }
+    clearTimetable(&check);
+    int errors = placePins(&check, "ERROR");
+    scheduleRelease(&check);
+    return errors;
+}
+
+// ---------------------------------------------------------------------------
+// Soft constraints
+//
+// The hard rules only say where an occurrence may go. Among valid
+// timetables we prefer the one with the lowest weighted cost of:
+//  - the same subject on consecutive days in a section (poor spread);
+//  - faculty hours beyond FACULTY_DAILY_CAP on a day;
+//  - idle cells between a section's first and last class of a day;
+//  - unbalanced faculty load (sum of squared weekly hours).
+// Every term is a popcount over the busy masks, so the cost of the few
+// entities a move touches is evaluated directly before and after the move,
+// and the cost an occurrence would add is scored for all its start cells
+// at once.
+// ---------------------------------------------------------------------------
+
+#define WEIGHT_SPREAD 3
+#define WEIGHT_OVERLOAD 10
+#define WEIGHT_GAP 2
+#define WEIGHT_BALANCE 1
+#define FACULTY_DAILY_CAP 4
+
+// Greedy start weights: a start's weight halves for every GREEDY_COST_STEP
+// of soft cost above the cheapest, down to GREEDY_WEIGHT >> GREEDY_WEIGHT_BITS
+#define GREEDY_COST_STEP 4
+#define GREEDY_WEIGHT_BITS 8
+#define GREEDY_WEIGHT (1 << GREEDY_WEIGHT_BITS)
+
+// Idle teaching cells between the first and last busy cell of a day
+int dayGaps(const Grid *grid, uint64_t busy, int day) {
+    uint64_t row = busy & grid->dayCells[1 << day] & grid->teachingMask;
+    if (!row) return 0;
+    uint64_t span = (~0ULL >> __builtin_clzll(row)) & ~((1ULL << CTZ64(row)) - 1);
+    return POPCOUNT64(span & ~row & grid->teachingMask);
+}
+
+// Weekly hours of a faculty member (blackout cells are not teaching)
+int facultyHours(const Schedule *sch, int facultyId) {
+    return POPCOUNT64(sch->facultyBusy[facultyId] & ~sch->ctx->facultyBlocked[facultyId]);
+}
+
+// Hours beyond the daily cap
+int facultyOverload(const Schedule *sch, int facultyId, int day) {
+    uint64_t taught = sch->facultyBusy[facultyId] & ~sch->ctx->facultyBlocked[facultyId];
+    int hours = POPCOUNT64(taught & sch->ctx->grid.dayCells[1 << day]);
+    return hours > FACULTY_DAILY_CAP ? hours - FACULTY_DAILY_CAP : 0;
+}
+
+// Consecutive days on which a subject meets a section
+int spreadPenalty(const Schedule *sch, int section, int subIdx) {
+    unsigned int days = SUBJECT_DAYS(sch, section, subIdx);
+    return POPCOUNT64(days & (days >> 1));
+}
+
+// Soft cost of everything a move can change: the section's gaps and the
+// faculty overload on the given days, the spread of the given subjects in
+// the section, and the weekly hours of their faculty. Each faculty member
+// is counted once even if several of the subjects share them.
+int moveCost(const Schedule *sch, int section, const int *subIdx, int count, unsigned int days) {
+    const Subject *subjects = sch->ctx->subjects;
+    const Grid *grid = &sch->ctx->grid;
+    int cost = 0;
+    
+    for (int d = 0; d < grid->days; d++) {
+        if (days & (1 << d)) cost += WEIGHT_GAP * dayGaps(grid, sch->sectionBusy[section], d);
+    }
+    
+    for (int i = 0; i < count; i++) {
+        cost += WEIGHT_SPREAD * spreadPenalty(sch, section, subIdx[i]);
+        
+        for (int f = 0; f < subjects[subIdx[i]].facultyCount; f++) {
+            int id = subjects[subIdx[i]].facultyIds[f];
+            int seen = 0;
+            for (int j = 0; j < i && !seen; j++) {
+                for (int g = 0; g < subjects[subIdx[j]].facultyCount; g++) {
+                    if (subjects[subIdx[j]].facultyIds[g] == id) seen = 1;
+                }
+            }
+            if (seen) continue;
+            
+            int hours = facultyHours(sch, id);
+            cost += WEIGHT_BALANCE * hours * hours;
+            for (int d = 0; d < grid->days; d++) {
+                if (days & (1 << d)) cost += WEIGHT_OVERLOAD * facultyOverload(sch, id, d);
+            }
+        }
+    }
+    return cost;
+}
+
+// Full soft cost of a schedule
+long softCost(const Schedule *sch) {
+    const SchedulerContext *ctx = sch->ctx;
+    long cost = 0;
+    
+    for (int s = 0; s < ctx->sectionCount; s++) {
+        for (int d = 0; d < ctx->grid.days; d++) {
+            cost += WEIGHT_GAP * dayGaps(&ctx->grid, sch->sectionBusy[s], d);
+        }
+        for (int subIdx = 0; subIdx < ctx->subjectCount; subIdx++) {
+            cost += WEIGHT_SPREAD * spreadPenalty(sch, s, subIdx);
+        }
+    }
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        long hours = facultyHours(sch, f);
+        cost += WEIGHT_BALANCE * hours * hours;
+        for (int d = 0; d < ctx->grid.days; d++) {
+            cost += WEIGHT_OVERLOAD * facultyOverload(sch, f, d);
+        }
+    }
+    return cost;
+}
+
+// Soft cost an occurrence of subIdx would add to a section at each of the
+// candidate start cells, scored for all of them in one pass. The terms that
+// only depend on the day (the subject's spread, its faculty's hours beyond
+// the cap) are worked out once per day, and the load-balance term once;
+// each start then only adds the idle cells its block leaves in the
+// section's day. Equals the change of softCost() for every start the
+// occurrence may take. costs is indexed by cell; only candidates are set.
+void scoreStarts(const Schedule *sch, int subIdx, int section, uint64_t candidates, int *costs) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subject = &ctx->subjects[subIdx];
+    const Grid *grid = &ctx->grid;
+    int duration = subject->duration;
+    uint64_t busy = sch->sectionBusy[section];
+    unsigned int days = SUBJECT_DAYS(sch, section, subIdx);
+    
+    int balance = 0;
+    for (int f = 0; f < subject->facultyCount; f++) {
+        int hours = facultyHours(sch, subject->facultyIds[f]);
+        balance += WEIGHT_BALANCE * ((hours + duration) * (hours + duration) - hours * hours);
+    }
+    
+    int dayCost[MAX_DAYS];
+    for (int d = 0; d < grid->days; d++) {
+        if (!(candidates & grid->dayCells[1 << d])) continue;
+        // Neighbouring days on which the subject already meets
+        int cost = balance + WEIGHT_SPREAD * (((days >> (d + 1)) & 1) + (d > 0 && ((days >> (d - 1)) & 1)));
+        for (int f = 0; f < subject->facultyCount; f++) {
+            int id = subject->facultyIds[f];
+            uint64_t taught = sch->facultyBusy[id] & ~ctx->facultyBlocked[id];
+            int over = POPCOUNT64(taught & grid->dayCells[1 << d]) + duration - FACULTY_DAILY_CAP;
+            cost += WEIGHT_OVERLOAD * (over <= 0 ? 0 : over < duration ? over : duration);
+        }
+        dayCost[d] = cost - WEIGHT_GAP * dayGaps(grid, busy, d);
+    }
+    
+    for (; candidates; candidates &= candidates - 1) {
+        int cell = CTZ64(candidates);
+        int day = CELL_DAY(grid, cell);
+        costs[cell] = dayCost[day] + WEIGHT_GAP * dayGaps(grid, busy | subjectBlock(subject, cell), day);
+    }
+}
+
+// Pick one of the candidate starts at random, weighted by the soft cost it
+// adds (costs, from scoreStarts()). Always taking the cheapest start packs
+// the greedy too tightly to place every occurrence; the weights keep it
+// random while leaving less cost for the fill pass and annealing.
+int pickStart(Schedule *sch, uint64_t candidates, const int *costs) {
+    int least = costs[CTZ64(candidates)];
+    for (uint64_t c = candidates & (candidates - 1); c; c &= c - 1) {
+        if (costs[CTZ64(c)] < least) least = costs[CTZ64(c)];
+    }
+    int weight[MAX_TOTAL_SLOTS];
+    int total = 0;
+    for (uint64_t c = candidates; c; c &= c - 1) {
+        int steps = (costs[CTZ64(c)] - least) / GREEDY_COST_STEP;
+        weight[CTZ64(c)] = GREEDY_WEIGHT >> (steps < GREEDY_WEIGHT_BITS ? steps : GREEDY_WEIGHT_BITS);
+        total += weight[CTZ64(c)];
+    }
+    int pick = randomBelow(sch, total);
+    for (;; candidates &= candidates - 1) {
+        pick -= weight[CTZ64(candidates)];
+        if (pick < 0) return CTZ64(candidates);
+    }
+}
+
+// One (subject, section) demand unit of the greedy solver
+typedef struct {
+    int subIdx;
+    int section;
+    int placed;        // Occurrences placed so far
+    int freeStarts;    // Feasible start cells left; its complement is the DSatur saturation
+    int active;        // Position in the active list, -1 once done or failed
+} GreedyUnit;
+
+// State of one greedy run over the faculty-conflict graph
+typedef struct {
+    Schedule *sch;
+    GreedyUnit *units;
+    int *unitOf;       // Unit index per section * subjectCount + subject, -1 if none
+    int *activeUnits;  // Units with occurrences left to place
+    int activeCount;
+    int *rank;         // Position of each subject in the duration/occurrence order
+    long *contention;  // Hours still to place that compete for each subject's faculty
+    long *degree;      // contention before the first placement
+} GreedyState;
+
+// Check whether unit a should be placed before unit b
+int unitBefore(const GreedyState *gs, int a, int b) {
+    const GreedyUnit *ua = &gs->units[a];
+    const GreedyUnit *ub = &gs->units[b];
+    const Subject *subjects = gs->sch->ctx->subjects;
+    switch (gs->sch->ctx->options.ordering) {
+    case ORDER_DSATUR: {
+        // Most saturated first: fewest start cells to spare for the occurrences left
+        int slackA = ua->freeStarts - (subjects[ua->subIdx].occurrences - ua->placed);
+        int slackB = ub->freeStarts - (subjects[ub->subIdx].occurrences - ub->placed);
+        if (slackA != slackB) return slackA < slackB;
+        if (gs->contention[ua->subIdx] != gs->contention[ub->subIdx]) {
+            return gs->contention[ua->subIdx] > gs->contention[ub->subIdx];
+        }
+        break;
+    }
+    case ORDER_DEGREE:
+        if (gs->degree[ua->subIdx] != gs->degree[ub->subIdx]) {
+            return gs->degree[ua->subIdx] > gs->degree[ub->subIdx];
+        }
+        break;
+    }
+    if (gs->rank[ua->subIdx] != gs->rank[ub->subIdx]) {
+        return gs->rank[ua->subIdx] < gs->rank[ub->subIdx];
+    }
+    return a < b;
+}
+
+// Take a unit off the active list
+void retireUnit(GreedyState *gs, int u) {
+    int pos = gs->units[u].active;
+    int last = gs->activeUnits[--gs->activeCount];
+    gs->activeUnits[pos] = last;
+    gs->units[last].active = pos;
+    gs->units[u].active = -1;
+}
+
+// Recount a unit's feasible starts; a unit left without any has failed
+void refreshUnit(GreedyState *gs, int u) {
+    GreedyUnit *unit = &gs->units[u];
+    if (u < 0 || unit->active < 0) return;
+    Schedule *sch = gs->sch;
+    const Subject *subject = &sch->ctx->subjects[unit->subIdx];
+    unit->freeStarts = POPCOUNT64(feasibleStarts(sch, unit->subIdx, unit->section));
+    if (unit->freeStarts == 0) {
+        LOG(sch->verbose, LOG_QUIET, "WARNING: Failed to place subject %s for section %d. "
+            "Try --solver=backtrack or --solver=sat for a complete search.\n",
+            subject->name, unit->section + 1);
+        if (sch->decisions) logDecision(sch, DECISION_REJECT, unit->subIdx, unit->section, -1, REJECT_NO_START);
+        sch->unplaced += subject->occurrences - unit->placed;
+        retireUnit(gs, u);
+    }
+}
+
+// After an occurrence of subIdx was placed for a section, update the units
+// whose domain could have shrunk: the section's own units and the units of
+// every subject sharing a faculty member, in any section
+void updateNeighbours(GreedyState *gs, int subIdx, int section) {
+    const SchedulerContext *ctx = gs->sch->ctx;
+    int subjectCount = ctx->subjectCount;
+    int duration = ctx->subjects[subIdx].duration;
+    
+    for (int j = 0; j < subjectCount; j++) {
+        refreshUnit(gs, gs->unitOf[section * subjectCount + j]);
+    }
+    for (int k = ctx->conflictFirst[subIdx]; k < ctx->conflictFirst[subIdx + 1]; k++) {
+        int j = ctx->conflictSubjects[k];
+        gs->contention[j] -= duration;
+        for (int s = 0; s < ctx->sectionCount; s++) {
+            if (s != section) refreshUnit(gs, gs->unitOf[s * subjectCount + j]);
+        }
+    }
+}
+
+// Greedy placement, one occurrence at a time, in the order chosen by
+// options.ordering. The units form a graph-colouring problem: units sharing
+// a section or a faculty member must not take the same cell. DSatur always
+// continues with the unit that has the fewest start cells left and breaks
+// ties by the faculty demand still competing with it.
+void generateGreedy(Schedule *sch) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subjects = ctx->subjects;
+    int subjectCount = ctx->subjectCount;
+    int sectionCount = ctx->sectionCount;
+    size_t cells = (size_t)sectionCount * subjectCount;
+    
+    GreedyState gs;
+    gs.sch = sch;
+    gs.units = malloc((cells + 1) * sizeof(GreedyUnit));
+    gs.unitOf = malloc((cells + 1) * sizeof(int));
+    gs.activeUnits = malloc((cells + 1) * sizeof(int));
+    gs.rank = malloc((subjectCount + 1) * sizeof(int));
+    gs.contention = calloc(subjectCount + 1, sizeof(long));
+    gs.degree = malloc((subjectCount + 1) * sizeof(long));
+    if (!gs.units || !gs.unitOf || !gs.activeUnits || !gs.rank || !gs.contention || !gs.degree) {
+        printf("ERROR: Out of memory for the greedy solver\n");
+        for (int i = 0; i < subjectCount; i++) {
+            for (int s = 0; s < sectionCount; s++) {
+                if (!subjects[i].section_specific || subjects[i].target_section == s) {
+                    sch->unplaced += subjects[i].occurrences;
+                }
+            }
+        }
+        goto done;
+    }
+    
+    // Create a priority queue of subjects (prioritize longer subjects and higher occurrence counts)
+    int *priorityOrder = gs.activeUnits; // Borrowed until the units are set up
+    
+    // Initialize the priority order
+    for (int i = 0; i < subjectCount; i++) {
+        priorityOrder[i] = i;
+    }
+    
+    // Sort by priority (longer subjects first, then by occurrence count)
+    for (int i = 0; i < subjectCount - 1; i++) {
+        for (int j = i + 1; j < subjectCount; j++) {
+            int iIdx = priorityOrder[i];
+            int jIdx = priorityOrder[j];
+            
+            // Higher duration gets higher priority
+            if (subjects[jIdx].duration > subjects[iIdx].duration) {
+                int temp = priorityOrder[i];
+                priorityOrder[i] = priorityOrder[j];
+                priorityOrder[j] = temp;
+            }
+            // If same duration, higher occurrence count gets higher priority
+            else if (subjects[jIdx].duration == subjects[iIdx].duration && 
+                     subjects[jIdx].occurrences > subjects[iIdx].occurrences) {
+                int temp = priorityOrder[i];
+                priorityOrder[i] = priorityOrder[j];
+                priorityOrder[j] = temp;
+            }
+        }
+    }
+    
+    if (LOG_ENABLED(sch->verbose, LOG_DEBUG)) {
+        printf("Placement order of subjects:\n");
+        for (int i = 0; i < subjectCount; i++) {
+            int subIdx = priorityOrder[i];
+            printf("%d. %s (Duration: %d, Occurrences: %d)\n", 
+                   i+1, subjects[subIdx].name, subjects[subIdx].duration, subjects[subIdx].occurrences);
+        }
+    }
+    for (int i = 0; i < subjectCount; i++) {
+        gs.rank[priorityOrder[i]] = i;
+    }
+    
+    // One unit per (subject, section) with occurrences left after the pins;
+    // every unit adds its hours to the contention of each subject it shares
+    // a faculty member with
+    int unitCount = 0;
+    gs.activeCount = 0;
+    for (int i = 0; i < subjectCount; i++) {
+        for (int s = 0; s < sectionCount; s++) {
+            gs.unitOf[s * subjectCount + i] = -1;
+            if (subjects[i].section_specific && subjects[i].target_section != s) continue;
+            int pinned = countSubjectOccurrences(sch, i, s);
+            if (subjects[i].occurrences - pinned < 1) continue;
+            GreedyUnit *unit = &gs.units[unitCount];
+            unit->subIdx = i;
+            unit->section = s;
+            unit->placed = pinned;
+            unit->freeStarts = POPCOUNT64(feasibleStarts(sch, i, s));
+            unit->active = gs.activeCount;
+            gs.activeUnits[gs.activeCount++] = unitCount;
+            gs.unitOf[s * subjectCount + i] = unitCount++;
+            for (int k = ctx->conflictFirst[i]; k < ctx->conflictFirst[i + 1]; k++) {
+                gs.contention[ctx->conflictSubjects[k]] += subjects[i].duration * (subjects[i].occurrences - pinned);
+            }
+        }
+    }
+    memcpy(gs.degree, gs.contention, subjectCount * sizeof(long));
+    for (int u = 0; u < unitCount; u++) {
+        if (gs.units[u].freeStarts == 0) refreshUnit(&gs, u);
+    }
+    
+    while (gs.activeCount > 0 && !isCancelled(sch)) {
+        int best = gs.activeUnits[0];
+        for (int i = 1; i < gs.activeCount; i++) {
+            if (unitBefore(&gs, gs.activeUnits[i], best)) best = gs.activeUnits[i];
+        }
+        GreedyUnit *unit = &gs.units[best];
+        int subIdx = unit->subIdx;
+        if (unit->placed == 0) {
+            LOG(sch->verbose, LOG_DEBUG, "Trying to place subject: %s for section %d\n", subjects[subIdx].name, unit->section + 1);
+        }
+        
+        uint64_t candidates = feasibleStarts(sch, subIdx, unit->section);
+        if (!candidates) {
+            refreshUnit(&gs, best); // Its room type filled up since the last count
+            continue;
+        }
+        // Pick one of the feasible start cells at random, cheaper ones more often
+        int costs[MAX_TOTAL_SLOTS];
+        scoreStarts(sch, subIdx, unit->section, candidates, costs);
+        int cell = pickStart(sch, candidates, costs);
+        int roomType = subjects[subIdx].roomType;
+        uint64_t roomStarts[MAX_DURATION];
+        memcpy(roomStarts, sch->roomStarts[roomType], sizeof(roomStarts));
+        placeSubject(sch, subIdx, CELL_DAY(&ctx->grid, cell), CELL_SLOT(&ctx->grid, cell),
+                     unit->section, ++unit->placed);
+        if (unit->placed == subjects[subIdx].occurrences) retireUnit(&gs, best);
+        updateNeighbours(&gs, subIdx, unit->section);
+        
+        // Taking the last free room of a cell shrinks every unit of the type
+        if (memcmp(roomStarts, sch->roomStarts[roomType], sizeof(roomStarts)) != 0) {
+            for (int i = gs.activeCount - 1; i >= 0; i--) {
+                int u = gs.activeUnits[i];
+                if (subjects[gs.units[u].subIdx].roomType == roomType) refreshUnit(&gs, u);
+            }
+        }
+    }
+    
+done:
+    free(gs.units);
+    free(gs.unitOf);
+    free(gs.activeUnits);
+    free(gs.rank);
+    free(gs.contention);
+    free(gs.degree);
+}
+
+// ---------------------------------------------------------------------------
+// Backtracking solver
+//
+// Each (subject, section) pair is a demand group that needs `occurrences`
+// start cells on distinct days. The search assigns one occurrence per level:
+//  - variable ordering is MRV (fewest spare days, then fewest start cells);
+//  - occurrences of a group are placed on increasing days, which removes the
+//    symmetric permutations of identical occurrences;
+//  - after every assignment, groups sharing the section or a faculty are
+//    forward-checked and the value is rejected if one can no longer fit;
+//  - dead ends jump straight back to the deepest level in their conflict
+//    set (conflict-directed backjumping) instead of the previous level.
+// ---------------------------------------------------------------------------
+
+#define BT_SOLVED (-2)
+#define BT_ABORTED (-3)
+
+typedef struct {
+    int subIdx;
+    int section;
+    int remaining; // Occurrences still to place
+    int lastDay;   // Day of the most recently placed occurrence, -1 if none
+} DemandGroup;
+
+// Search state of one backtracking run
+typedef struct {
+    Schedule *sch;
+    
+    DemandGroup *groups;
+    int groupCount;
+    int totalLevels;
+    
+    // Per-level search state
+    int *levelGroup;
+    int *levelCell;
+    int *levelPrevDay;
+    uint64_t *conflictSet;   // levelWords words per level
+    int levelWords;
+    
+    // Teaching hours and multi-hour blocks each faculty member/section still needs
+    int *facultyDemand;
+    int *facultyLabDemand;
+    int *sectionDemand;
+    int *sectionLabDemand;
+    
+    Arena arena;             // Backs every array above
+    
+    long nodes;
+    long nodeLimit;
+    double deadline;
+} BacktrackState;
+
+// Wall-clock time in seconds (CPU time would add up across threads)
+double wallClockSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Check if the run was cancelled or its deadline has passed
+int outOfTime(const Schedule *sch) {
+    return isCancelled(sch) || (sch->deadline > 0 && wallClockSeconds() > sch->deadline);
+}
+
+// Two groups interact if they compete for a section, a faculty member or
+// the rooms of a type with declared rooms
+int groupsInteract(BacktrackState *bt, int a, int b) {
+    const SchedulerContext *ctx = bt->sch->ctx;
+    int roomType = ctx->subjects[bt->groups[a].subIdx].roomType;
+    return bt->groups[a].section == bt->groups[b].section ||
+           ctx->sharesFaculty[bt->groups[a].subIdx * ctx->subjectCount + bt->groups[b].subIdx] ||
+           (ctx->roomTypeCount[roomType] > 0 && ctx->subjects[bt->groups[b].subIdx].roomType == roomType);
+}
+
+// Start cells still open to the next occurrence of a group
+uint64_t groupDomain(BacktrackState *bt, int g) {
+    uint64_t cells = feasibleStarts(bt->sch, bt->groups[g].subIdx, bt->groups[g].section);
+    // Occurrences are placed on increasing days
+    int after = bt->groups[g].lastDay + 1;
+    return cells & ~bt->sch->ctx->grid.dayCells[(1 << after) - 1];
+}
+
+// Number of distinct days that contain at least one cell of the mask
+int countDays(const Grid *grid, uint64_t cells) {
+    int count = 0;
+    for (int d = 0; d < grid->days; d++) {
+        if (cells & grid->dayCells[1 << d]) count++;
+    }
+    return count;
+}
+
+// Add every level whose assignment touches group g to a conflict set
+void addInteractingLevels(BacktrackState *bt, uint64_t *set, int g, int depth) {
+    for (int l = 0; l < depth; l++) {
+        if (groupsInteract(bt, bt->levelGroup[l], g)) {
+            set[l / 64] |= 1ULL << (l % 64);
+        }
+    }
+}
+
+// Deepest level in a conflict set, -1 if the set is empty
+int deepestLevel(const uint64_t *set, int words) {
+    for (int w = words - 1; w >= 0; w--) {
+        if (set[w]) {
+            return w * 64 + 63 - __builtin_clzll(set[w]);
+        }
+    }
+    return -1;
+}
+
+// Maximum number of disjoint 2-hour blocks among the free cells, which
+// bounds the blocks of 2 hours or more that still fit.
+// Taking the earliest possible block first is optimal on a line.
+int countLabBlocks(const Grid *grid, uint64_t freeCells) {
+    int blocks = 0;
+    uint64_t starts = blockStarts(grid, freeCells, 2);
+    while (starts) {
+        int cell = CTZ64(starts);
+        blocks++;
+        starts &= ~(3ULL << cell);
+    }
+    return blocks;
+}
+
+// Check that a resource with the given busy mask still has room for the
+// hours and multi-hour blocks left to schedule; returns 0 when it cannot fit
+int hasCapacity(const Grid *grid, uint64_t busy, int hours, int labs) {
+    uint64_t freeCells = ~busy & grid->teachingMask;
+    if (hours > POPCOUNT64(freeCells)) return 0;
+    return labs == 0 || labs <= countLabBlocks(grid, freeCells);
+}
+
+int facultyHasCapacity(BacktrackState *bt, int facultyId) {
+    return hasCapacity(&bt->sch->ctx->grid, bt->sch->facultyBusy[facultyId],
+                       bt->facultyDemand[facultyId], bt->facultyLabDemand[facultyId]);
+}
+
+int sectionHasCapacity(BacktrackState *bt, int section) {
+    return hasCapacity(&bt->sch->ctx->grid, bt->sch->sectionBusy[section],
+                       bt->sectionDemand[section], bt->sectionLabDemand[section]);
+}
+
+// Book (sign = -1) or release (sign = +1) the remaining demand of one occurrence
+void adjustDemand(BacktrackState *bt, int subIdx, int section, int sign) {
+    const Subject *subjects = bt->sch->ctx->subjects;
+    int hours = subjects[subIdx].duration;
+    int labs = hours >= 2;
+    for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
+        bt->facultyDemand[subjects[subIdx].facultyIds[f]] += sign * hours;
+        bt->facultyLabDemand[subjects[subIdx].facultyIds[f]] += sign * labs;
+    }
+    bt->sectionDemand[section] += sign * hours;
+    bt->sectionLabDemand[section] += sign * labs;
+}
+
+// Add every level that placed a subject taught by the faculty member
+void addFacultyLevels(BacktrackState *bt, uint64_t *set, int facultyId, int depth) {
+    const Subject *subjects = bt->sch->ctx->subjects;
+    for (int l = 0; l < depth; l++) {
+        const Subject *sub = &subjects[bt->groups[bt->levelGroup[l]].subIdx];
+        for (int f = 0; f < sub->facultyCount; f++) {
+            if (sub->facultyIds[f] == facultyId) {
+                set[l / 64] |= 1ULL << (l % 64);
+                break;
+            }
+        }
+    }
+}
+
+// Add every level that placed something in the section
+void addSectionLevels(BacktrackState *bt, uint64_t *set, int section, int depth) {
+    for (int l = 0; l < depth; l++) {
+        if (bt->groups[bt->levelGroup[l]].section == section) {
+            set[l / 64] |= 1ULL << (l % 64);
+        }
+    }
+}
+
+// Pick the most constrained open group, or -1 if every group is complete
+int selectGroup(BacktrackState *bt) {
+    int best = -1;
+    int bestSlack = 0, bestCells = 0;
+    
+    for (int g = 0; g < bt->groupCount; g++) {
+        if (bt->groups[g].remaining == 0) continue;
+        
+        uint64_t domain = groupDomain(bt, g);
+        int slack = countDays(&bt->sch->ctx->grid, domain) - bt->groups[g].remaining;
+        int cells = POPCOUNT64(domain);
+        if (best == -1 || slack < bestSlack ||
+            (slack == bestSlack && cells < bestCells)) {
+            best = g;
+            bestSlack = slack;
+            bestCells = cells;
+        }
+    }
+    return best;
+}
+
+// Recursive search. Returns BT_SOLVED, BT_ABORTED, or the level to jump back to.
+int backtrackSearch(BacktrackState *bt, int depth) {
+    const Subject *subjects = bt->sch->ctx->subjects;
+    int g = selectGroup(bt);
+    if (g == -1) {
+        return BT_SOLVED;
+    }
+    
+    // Reading the clock is comparatively slow, so only do it every 1024 nodes
+    if (++bt->nodes > bt->nodeLimit ||
+        ((bt->nodes & 1023) == 0 && (wallClockSeconds() > bt->deadline || isCancelled(bt->sch)))) {
+        return BT_ABORTED;
+    }
+    
+    uint64_t *conflicts = &bt->conflictSet[(size_t)depth * bt->levelWords];
+    memset(conflicts, 0, bt->levelWords * sizeof(uint64_t));
+    // The assignments that shaped this group's domain are always culprits
+    addInteractingLevels(bt, conflicts, g, depth);
+    
+    Schedule *sch = bt->sch;
+    uint64_t domain = groupDomain(bt, g);
+    int subIdx = bt->groups[g].subIdx;
+    int section = bt->groups[g].section;
+    
+    while (domain) {
+        // Try the remaining values in random order
+        uint64_t pick = domain;
+        for (int k = randomBelow(sch, POPCOUNT64(domain)); k > 0; k--) {
+            pick &= pick - 1;
+        }
+        int cell = CTZ64(pick);
+        domain &= ~(1ULL << cell);
+        
+        int day = CELL_DAY(&sch->ctx->grid, cell);
+        occupySlots(sch, subIdx, day, CELL_SLOT(&sch->ctx->grid, cell), section);
+        STAT_ADD(sch, placements, 1);
+        bt->levelGroup[depth] = g;
+        bt->levelCell[depth] = cell;
+        bt->levelPrevDay[depth] = bt->groups[g].lastDay;
+        bt->groups[g].lastDay = day;
+        bt->groups[g].remaining--;
+        adjustDemand(bt, subIdx, section, -1);
+        
+        // Forward check every group that competes for the same resources
+        int wiped = -1;
+        for (int h = 0; h < bt->groupCount && wiped == -1; h++) {
+            if (bt->groups[h].remaining == 0 || !groupsInteract(bt, g, h)) continue;
+            if (countDays(&sch->ctx->grid, groupDomain(bt, h)) < bt->groups[h].remaining) {
+                wiped = h;
+            }
+        }
+        
+        // ...and the hours left for the section and faculty of the placed subject
+        int overloaded = -1;
+        int sectionFull = wiped == -1 && !sectionHasCapacity(bt, section);
+        for (int f = 0; f < subjects[subIdx].facultyCount && wiped == -1 && !sectionFull && overloaded == -1; f++) {
+            if (!facultyHasCapacity(bt, subjects[subIdx].facultyIds[f])) {
+                overloaded = subjects[subIdx].facultyIds[f];
+            }
+        }
+        
+        int result = depth;
+        if (wiped != -1) {
+            // Blame everything that shrank the wiped-out group's domain
+            addInteractingLevels(bt, conflicts, wiped, depth);
+        } else if (sectionFull) {
+            addSectionLevels(bt, conflicts, section, depth);
+        } else if (overloaded != -1) {
+            addFacultyLevels(bt, conflicts, overloaded, depth);
+        } else {
+            result = backtrackSearch(bt, depth + 1);
+        }
+        
+        if (result == BT_SOLVED) {
+            return BT_SOLVED;
+        }
+        
+        bt->groups[g].remaining++;
+        bt->groups[g].lastDay = bt->levelPrevDay[depth];
+        adjustDemand(bt, subIdx, section, +1);
+        unplaceSubject(sch, subIdx, day, CELL_SLOT(&sch->ctx->grid, cell), section);
+        
+        if (result != depth) {
+            // Aborted, or jumping back past this level
+            return result;
+        }
+    }
+    
+    // Every value failed: jump to the deepest culprit and hand it our conflicts
+    int target = deepestLevel(conflicts, bt->levelWords);
+    if (target >= 0) {
+        uint64_t *targetSet = &bt->conflictSet[(size_t)target * bt->levelWords];
+        conflicts[target / 64] &= ~(1ULL << (target % 64));
+        for (int w = 0; w < bt->levelWords; w++) {
+            targetSet[w] |= conflicts[w];
+        }
+    }
+    return target;
+}
+
+// Complete search for a placement of every required occurrence.
+// Proves infeasibility when the search space is exhausted within the budget.
+int solveBacktracking(Schedule *sch) {
+    const Subject *subjects = sch->ctx->subjects;
+    int subjectCount = sch->ctx->subjectCount;
+    const char *const *allFaculties = sch->ctx->allFaculties;
+    int totalFaculties = sch->ctx->totalFaculties;
+    LOG(sch->verbose, LOG_INFO, "Running backtracking solver (node limit %ld, time limit %.1fs)...\n",
+        sch->ctx->options.maxNodes, sch->ctx->options.timeLimit);
+    
+    int sectionCount = sch->ctx->sectionCount;
+    int maxGroups = subjectCount * sectionCount;
+    int maxLevels = 0;
+    for (int i = 0; i < subjectCount; i++) {
+        maxLevels += subjects[i].occurrences * sectionCount;
+    }
+    
+    BacktrackState *bt = calloc(1, sizeof(BacktrackState));
+    if (bt) {
+        bt->sch = sch;
+        bt->levelWords = (maxLevels + 63) / 64;
+        bt->groups = arenaAlloc(&bt->arena, (maxGroups + 1) * sizeof(DemandGroup));
+        bt->levelGroup = arenaAlloc(&bt->arena, (maxLevels + 1) * sizeof(int));
+        bt->levelCell = arenaAlloc(&bt->arena, (maxLevels + 1) * sizeof(int));
+        bt->levelPrevDay = arenaAlloc(&bt->arena, (maxLevels + 1) * sizeof(int));
+        bt->conflictSet = arenaAlloc(&bt->arena, ((size_t)maxLevels + 1) * (bt->levelWords + 1) * sizeof(uint64_t));
+        bt->facultyDemand = arenaAlloc(&bt->arena, (totalFaculties + 1) * sizeof(int));
+        bt->facultyLabDemand = arenaAlloc(&bt->arena, (totalFaculties + 1) * sizeof(int));
+        bt->sectionDemand = arenaAlloc(&bt->arena, (sectionCount + 1) * sizeof(int));
+        bt->sectionLabDemand = arenaAlloc(&bt->arena, (sectionCount + 1) * sizeof(int));
+    }
+    if (!bt || !bt->groups || !bt->levelGroup || !bt->levelCell || !bt->levelPrevDay ||
+        !bt->conflictSet || !bt->facultyDemand || !bt->facultyLabDemand ||
+        !bt->sectionDemand || !bt->sectionLabDemand) {
+        printf("ERROR: Out of memory for the backtracking solver\n");
+        if (bt) arenaFree(&bt->arena);
+        free(bt);
+        sch->unplaced = maxLevels;
+        return SOLVE_BUDGET_EXHAUSTED;
+    }
+    
+    // One demand group per (subject, section) for the occurrences not pinned
+    for (int i = 0; i < subjectCount; i++) {
+        for (int s = 0; s < sectionCount; s++) {
+            if (subjects[i].section_specific && subjects[i].target_section != s) continue;
+            int remaining = subjects[i].occurrences - countSubjectOccurrences(sch, i, s);
+            if (remaining < 1) continue;
+            bt->groups[bt->groupCount].subIdx = i;
+            bt->groups[bt->groupCount].section = s;
+            bt->groups[bt->groupCount].remaining = remaining;
+            bt->groups[bt->groupCount].lastDay = -1;
+            bt->totalLevels += remaining;
+            bt->groupCount++;
+            for (int k = 0; k < remaining; k++) {
+                adjustDemand(bt, i, s, +1);
+            }
+        }
+    }
+    sch->unplaced = bt->totalLevels;
+    
+    int status = SOLVE_INFEASIBLE;
+    int result = -1;
+    
+    // A group or resource that cannot fit even in the empty week makes the instance infeasible
+    for (int g = 0; g < bt->groupCount; g++) {
+        if (countDays(&sch->ctx->grid, groupDomain(bt, g)) < bt->groups[g].remaining) {
+            LOG(sch->verbose, LOG_QUIET, "Infeasible: %s cannot be placed %d times for section %d\n",
+                subjects[bt->groups[g].subIdx].name, bt->groups[g].remaining, bt->groups[g].section + 1);
+            goto done;
+        }
+    }
+    for (int f = 0; f < totalFaculties; f++) {
+        if (!facultyHasCapacity(bt, f)) {
+            LOG(sch->verbose, LOG_QUIET, "Infeasible: %s needs %d hours (%d blocks of 2 hours or more) which do not fit into one week\n",
+                allFaculties[f], bt->facultyDemand[f], bt->facultyLabDemand[f]);
+            goto done;
+        }
+    }
+    for (int s = 0; s < sectionCount; s++) {
+        if (!sectionHasCapacity(bt, s)) {
+            LOG(sch->verbose, LOG_QUIET, "Infeasible: section %d needs %d hours which do not fit into one week\n",
+                s + 1, bt->sectionDemand[s]);
+            goto done;
+        }
+    }
+    for (int type = 0; type < ROOM_TYPES; type++) {
+        if (sch->ctx->roomTypeCount[type] == 0) continue;
+        int hours = 0, labs = 0;
+        for (int g = 0; g < bt->groupCount; g++) {
+            const Subject *subject = &subjects[bt->groups[g].subIdx];
+            if (subject->roomType != type) continue;
+            hours += subject->duration * bt->groups[g].remaining;
+            if (subject->duration >= 2) labs += bt->groups[g].remaining;
+        }
+        int freeHours = 0, freeLabs = 0;
+        for (int bit = 0; bit < sch->ctx->roomTypeCount[type]; bit++) {
+            uint64_t cells = 0;
+            for (int c = 0; c < MAX_TOTAL_SLOTS; c++) {
+                if ((sch->roomFree[type][c] >> bit) & 1) cells |= 1ULL << c;
+            }
+            freeHours += POPCOUNT64(cells);
+            freeLabs += countLabBlocks(&sch->ctx->grid, cells);
+        }
+        if (hours > freeHours || labs > freeLabs) {
+            LOG(sch->verbose, LOG_QUIET, "Infeasible: %d hours (%d blocks of 2 hours or more) need a %s, which do not fit into the %d declared\n",
+                hours, labs, roomTypeNames[type], sch->ctx->roomTypeCount[type]);
+            goto done;
+        }
+    }
+    
+    bt->nodeLimit = sch->nodeLimit > 0 ? sch->nodeLimit : sch->ctx->options.maxNodes;
+    bt->deadline = wallClockSeconds() + sch->ctx->options.timeLimit;
+    if (sch->deadline > 0 && sch->deadline < bt->deadline) bt->deadline = sch->deadline;
+    result = backtrackSearch(bt, 0);
+    
+    LOG(sch->verbose, LOG_INFO, "Backtracking solver explored %ld nodes\n", bt->nodes);
+    sch->stats.nodes += bt->nodes;
+    if (result == BT_SOLVED) {
+        for (int g = 0; g < bt->groupCount; g++) {
+            ASSIGNED(sch, bt->groups[g].section, bt->groups[g].subIdx) = 1;
+        }
+        sch->unplaced = 0;
+        status = SOLVE_FEASIBLE;
+        LOG(sch->verbose, LOG_INFO, "All %d occurrences placed.\n", bt->totalLevels);
+    } else if (result == BT_ABORTED) {
+        status = SOLVE_BUDGET_EXHAUSTED;
+        LOG(sch->verbose, LOG_QUIET, "WARNING: Search budget exhausted before a complete timetable was found.\n");
+    } else {
+        LOG(sch->verbose, LOG_QUIET, "Infeasible: no timetable places every required occurrence.\n");
+    }
+    
+done:
+    arenaFree(&bt->arena);
+    free(bt);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// Exact SAT mode
+//
+// The demand left after the pins is encoded as CNF. One variable stands for
+// each feasible start cell of each (subject, section) unit, and one for
+// each room a start could take. Cardinality constraints keep a section, a
+// faculty member and each room to one class per cell, and a unit to at most
+// one start a day and at least its required occurrences. A small CDCL
+// solver built into this file solves the formula. It uses two watched
+// literals, VSIDS, first-UIP learning, Luby restarts and LBD-based clause
+// deletion.
+//
+// Every constraint group is guarded by a selector variable that the
+// solver assumes true: one per unit, section, faculty member and room
+// type. When the formula is unsatisfiable, the assumptions in the final
+// conflict form an unsat core. Deletion shrinks it towards a minimal one
+// with the conflicts the solve left of the node budget, and stops where the
+// budget runs out. The core is reported by name, and the faculty members in
+// it are kept on the schedule.
+// ---------------------------------------------------------------------------
+
+#define SAT_RESTART_UNIT 100     // Conflicts in one Luby unit
+#define SAT_FIRST_REDUCE 2000    // Learnt clauses kept before the first deletion
+#define SAT_CORE_CONFLICTS 20000 // Most conflicts for one core-shrinking check
+#define SAT_LEARNT 1             // Clause flags, next to the LBD
+#define SAT_DELETED 2
+
+typedef struct {
+    int *data;
+    int size;
+    int capacity;
+} IntVector;
+
+int pushInt(IntVector *v, int x) {
+    if (v->size == v->capacity) {
+        int capacity = v->capacity ? 2 * v->capacity : 8;
+        int *data = realloc(v->data, capacity * sizeof(int));
+        if (!data) return -1;
+        v->data = data;
+        v->capacity = capacity;
+    }
+    v->data[v->size++] = x;
+    return 0;
+}
+
+// Literals are 2 * var for the variable and 2 * var + 1 for its negation
+#define SAT_LIT(var, negated) (2 * (var) + (negated))
+#define SAT_VAR(lit) ((lit) >> 1)
+
+typedef struct {
+    int vars;
+    IntVector pool;          // Clauses: size, LBD << 2 | flags, then the literals
+    IntVector learnts;       // Refs of the learnt clauses
+    IntVector *watches;      // Per literal: clauses watching it become false
+    signed char *value;      // Per variable: 1 true, -1 false, 0 unassigned
+    signed char *phase;      // Value a variable last had, tried first when deciding
+    int *level;
+    int *reason;             // Clause that implied the variable, -1 for decisions
+    int *trail;
+    int trailSize;
+    IntVector trailLimits;   // Trail size at the start of every decision level
+    int qhead;               // Next trail entry to propagate
+    double *activity;
+    double increment;
+    int *heap;               // Unassigned variables by activity
+    int heapSize;
+    int *heapIndex;          // Position in the heap, -1 when absent
+    unsigned char *seen;
+    int *levelStamp;         // For counting the levels of a learnt clause
+    int stamp;
+    IntVector learnt;        // Clause being learnt
+    IntVector core;          // Assumptions in the final conflict of an unsat answer
+    long conflicts;
+    int ok;                  // 0 once the clauses alone are unsatisfiable
+} SatSolver;
+
+int litValue(const SatSolver *s, int lit) {
+    int v = s->value[SAT_VAR(lit)];
+    return lit & 1 ? -v : v;
+}
+
+int heapBefore(const SatSolver *s, int a, int b) {
+    return s->activity[a] > s->activity[b];
+}
+
+void heapUp(SatSolver *s, int pos) {
+    int var = s->heap[pos];
+    while (pos > 0 && heapBefore(s, var, s->heap[(pos - 1) / 2])) {
+        s->heap[pos] = s->heap[(pos - 1) / 2];
+        s->heapIndex[s->heap[pos]] = pos;
+        pos = (pos - 1) / 2;
+    }
+    s->heap[pos] = var;
+    s->heapIndex[var] = pos;
+}
+
+void heapDown(SatSolver *s, int pos) {
+    int var = s->heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= s->heapSize) break;
+        if (child + 1 < s->heapSize && heapBefore(s, s->heap[child + 1], s->heap[child])) child++;
+        if (!heapBefore(s, s->heap[child], var)) break;
+        s->heap[pos] = s->heap[child];
+        s->heapIndex[s->heap[pos]] = pos;
+        pos = child;
+    }
+    s->heap[pos] = var;
+    s->heapIndex[var] = pos;
+}
+
+void heapInsert(SatSolver *s, int var) {
+    if (s->heapIndex[var] >= 0) return;
+    s->heap[s->heapSize] = var;
+    heapUp(s, s->heapSize++);
+}
+
+int heapPop(SatSolver *s) {
+    int var = s->heap[0];
+    s->heapIndex[var] = -1;
+    if (--s->heapSize > 0) {
+        s->heap[0] = s->heap[s->heapSize];
+        heapDown(s, 0);
+    }
+    return var;
+}
+
+void bumpVariable(SatSolver *s, int var) {
+    if ((s->activity[var] += s->increment) > 1e100) {
+        for (int v = 0; v < s->vars; v++) s->activity[v] *= 1e-100;
+        s->increment *= 1e-100;
+    }
+    if (s->heapIndex[var] >= 0) heapUp(s, s->heapIndex[var]);
+}
+
+void satRelease(SatSolver *s) {
+    for (int l = 0; s->watches && l < 2 * s->vars; l++) free(s->watches[l].data);
+    free(s->watches);
+    free(s->pool.data);
+    free(s->learnts.data);
+    free(s->trailLimits.data);
+    free(s->learnt.data);
+    free(s->core.data);
+    free(s->value);
+    free(s->phase);
+    free(s->level);
+    free(s->reason);
+    free(s->trail);
+    free(s->activity);
+    free(s->heap);
+    free(s->heapIndex);
+    free(s->seen);
+    free(s->levelStamp);
+}
+
+// Set up a solver for vars variables; initial activities come from the
+// schedule's generator, so portfolio attempts branch differently
+int satInit(SatSolver *s, int vars, Schedule *sch) {
+    memset(s, 0, sizeof(SatSolver));
+    s->vars = vars;
+    s->ok = 1;
+    s->increment = 1;
+    s->watches = calloc(2 * vars + 1, sizeof(IntVector));
+    s->value = calloc(vars + 1, 1);
+    s->phase = calloc(vars + 1, 1);
+    s->level = calloc(vars + 1, sizeof(int));
+    s->reason = malloc((vars + 1) * sizeof(int));
+    s->trail = malloc((vars + 1) * sizeof(int));
+    s->activity = malloc((vars + 1) * sizeof(double));
+    s->heap = malloc((vars + 1) * sizeof(int));
+    s->heapIndex = malloc((vars + 1) * sizeof(int));
+    s->seen = calloc(vars + 1, 1);
+    s->levelStamp = calloc(vars + 2, sizeof(int));
+    if (!s->watches || !s->value || !s->phase || !s->level || !s->reason || !s->trail ||
+        !s->activity || !s->heap || !s->heapIndex || !s->seen || !s->levelStamp) {
+        satRelease(s);
+        return -1;
+    }
+    for (int v = 0; v < vars; v++) {
+        s->reason[v] = -1;
+        s->phase[v] = -1;
+        s->activity[v] = nextRandom(sch) * 1e-12;
+        s->heapIndex[v] = -1;
+        heapInsert(s, v);
+    }
+    return 0;
+}
+
+int *clauseLits(const SatSolver *s, int ref) {
+    return s->pool.data + ref + 2;
+}
+
+void satAssign(SatSolver *s, int lit, int reason) {
+    int var = SAT_VAR(lit);
+    s->value[var] = lit & 1 ? -1 : 1;
+    s->level[var] = s->trailLimits.size;
+    s->reason[var] = reason;
+    s->trail[s->trailSize++] = lit;
+}
+
+// Store a clause of two or more literals and watch its first two
+int attachClause(SatSolver *s, const int *lits, int size, int flags) {
+    int ref = s->pool.size;
+    if (pushInt(&s->pool, size) != 0 || pushInt(&s->pool, flags) != 0) return -1;
+    for (int i = 0; i < size; i++) {
+        if (pushInt(&s->pool, lits[i]) != 0) return -1;
+    }
+    if (pushInt(&s->watches[lits[0]], ref) != 0 || pushInt(&s->watches[lits[1]], ref) != 0) return -1;
+    return ref;
+}
+
+// Add a clause before solving. Returns 0, or -1 when out of memory.
+int satAddClause(SatSolver *s, int *lits, int size) {
+    int kept = 0;
+    for (int i = 0; i < size; i++) {
+        int value = litValue(s, lits[i]);
+        if (value > 0) return 0; // Satisfied by a unit clause
+        if (value == 0) lits[kept++] = lits[i];
+    }
+    if (kept == 0) {
+        s->ok = 0;
+    } else if (kept == 1) {
+        satAssign(s, lits[0], -1);
+    } else if (attachClause(s, lits, kept, 0) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+// Unit propagation; returns the conflicting clause, or -1
+int satPropagate(SatSolver *s) {
+    while (s->qhead < s->trailSize) {
+        int falseLit = s->trail[s->qhead++] ^ 1;
+        IntVector *ws = &s->watches[falseLit];
+        int kept = 0;
+        for (int i = 0; i < ws->size; i++) {
+            int ref = ws->data[i];
+            if (s->pool.data[ref + 1] & SAT_DELETED) continue;
+            int *c = clauseLits(s, ref);
+            int size = s->pool.data[ref];
+            if (c[0] == falseLit) {
+                c[0] = c[1];
+                c[1] = falseLit;
+            }
+            if (litValue(s, c[0]) > 0) {
+                ws->data[kept++] = ref;
+                continue;
+            }
+            
+            // Watch another literal that is not false, if there is one
+            int moved = 0;
+            for (int k = 2; k < size; k++) {
+                if (litValue(s, c[k]) >= 0) {
+                    c[1] = c[k];
+                    c[k] = falseLit;
+                    if (pushInt(&s->watches[c[1]], ref) != 0) ws->data[kept++] = ref;
+                    moved = 1;
+                    break;
+                }
+            }
+            if (moved) continue;
+            
+            ws->data[kept++] = ref;
+            if (litValue(s, c[0]) < 0) {
+                while (++i < ws->size) ws->data[kept++] = ws->data[i];
+                ws->size = kept;
+                s->qhead = s->trailSize;
+                return ref;
+            }
+            satAssign(s, c[0], ref);
+        }
+        ws->size = kept;
+    }
+    return -1;
+}
+
+void satBacktrack(SatSolver *s, int level) {
+    if (s->trailLimits.size <= level) return;
+    int bottom = s->trailLimits.data[level];
+    for (int i = s->trailSize - 1; i >= bottom; i--) {
+        int var = SAT_VAR(s->trail[i]);
+        s->phase[var] = s->value[var];
+        s->value[var] = 0;
+        s->reason[var] = -1;
+        heapInsert(s, var);
+    }
+    s->trailSize = bottom;
+    s->qhead = bottom;
+    s->trailLimits.size = level;
+}
+
+// First-UIP conflict analysis into s->learnt (asserting literal first).
+// Returns the level to jump back to, or -1 when out of memory.
+int satAnalyze(SatSolver *s, int conflict, int *lbd) {
+    int level = s->trailLimits.size;
+    int pending = 0;
+    int lit = -1;
+    int index = s->trailSize - 1;
+    s->learnt.size = 0;
+    if (pushInt(&s->learnt, 0) != 0) return -1;
+    
+    do {
+        int *c = clauseLits(s, conflict);
+        int size = s->pool.data[conflict];
+        for (int i = lit == -1 ? 0 : 1; i < size; i++) {
+            int var = SAT_VAR(c[i]);
+            if (s->seen[var] || s->level[var] == 0) continue;
+            bumpVariable(s, var);
+            s->seen[var] = 1;
+            if (s->level[var] >= level) {
+                pending++;
+            } else if (pushInt(&s->learnt, c[i]) != 0) {
+                return -1;
+            }
+        }
+        while (!s->seen[SAT_VAR(s->trail[index])]) index--;
+        lit = s->trail[index--];
+        conflict = s->reason[SAT_VAR(lit)];
+        s->seen[SAT_VAR(lit)] = 0;
+        pending--;
+    } while (pending > 0);
+    s->learnt.data[0] = lit ^ 1;
+    
+    // Drop literals implied by the rest of the clause alone; they are
+    // flagged negative first, since their marks still count for the others
+    int *lits = s->learnt.data;
+    for (int i = 1; i < s->learnt.size; i++) {
+        int reason = s->reason[SAT_VAR(lits[i])];
+        int redundant = reason >= 0;
+        for (int k = 1; redundant && k < s->pool.data[reason]; k++) {
+            int var = SAT_VAR(clauseLits(s, reason)[k]);
+            if (!s->seen[var] && s->level[var] > 0) redundant = 0;
+        }
+        if (redundant) lits[i] = -1 - lits[i];
+    }
+    int kept = 1;
+    for (int i = 1; i < s->learnt.size; i++) {
+        int lit = lits[i] < 0 ? -1 - lits[i] : lits[i];
+        s->seen[SAT_VAR(lit)] = 0;
+        if (lits[i] >= 0) lits[kept++] = lit;
+    }
+    s->learnt.size = kept;
+    
+    // Jump to the second highest level, whose literal is watched second
+    int back = 0;
+    s->stamp++;
+    *lbd = 0;
+    for (int i = 1; i < s->learnt.size; i++) {
+        int varLevel = s->level[SAT_VAR(s->learnt.data[i])];
+        if (s->levelStamp[varLevel] != s->stamp) {
+            s->levelStamp[varLevel] = s->stamp;
+            (*lbd)++;
+        }
+        if (varLevel > back) {
+            back = varLevel;
+            int swap = s->learnt.data[1];
+            s->learnt.data[1] = s->learnt.data[i];
+            s->learnt.data[i] = swap;
+        }
+    }
+    return back;
+}
+
+// Collect the negations of the assumptions that make lit true into s->core
+int satAnalyzeFinal(SatSolver *s, int lit) {
+    s->core.size = 0;
+    if (pushInt(&s->core, lit) != 0) return -1;
+    if (s->trailLimits.size == 0) return 0;
+    s->seen[SAT_VAR(lit)] = 1;
+    for (int i = s->trailSize - 1; i >= s->trailLimits.data[0]; i--) {
+        int var = SAT_VAR(s->trail[i]);
+        if (!s->seen[var]) continue;
+        int reason = s->reason[var];
+        if (reason < 0) {
+            if (s->level[var] > 0 && pushInt(&s->core, s->trail[i] ^ 1) != 0) return -1;
+        } else {
+            for (int k = 1; k < s->pool.data[reason]; k++) {
+                int other = SAT_VAR(clauseLits(s, reason)[k]);
+                if (s->level[other] > 0) s->seen[other] = 1;
+            }
+        }
+        s->seen[var] = 0;
+    }
+    s->seen[SAT_VAR(lit)] = 0;
+    return 0;
+}
+
+int compareLongDescending(const void *a, const void *b) {
+    long x = *(const long *)a, y = *(const long *)b;
+    return (x < y) - (x > y);
+}
+
+// Delete the half of the learnt clauses with the most decision levels,
+// keeping glue clauses (LBD 2) and clauses that are reasons on the trail
+int satReduce(SatSolver *s) {
+    long *keys = malloc(s->learnts.size * sizeof(long));
+    if (!keys) return -1;
+    for (int i = 0; i < s->learnts.size; i++) {
+        int ref = s->learnts.data[i];
+        keys[i] = (long)(s->pool.data[ref + 1] >> 2) << 32 | ref;
+    }
+    qsort(keys, s->learnts.size, sizeof(long), compareLongDescending);
+    int count = s->learnts.size;
+    int half = count / 2;
+    s->learnts.size = 0;
+    for (int i = 0; i < count; i++) {
+        int ref = (int)(keys[i] & 0xFFFFFFFF);
+        int first = clauseLits(s, ref)[0];
+        int locked = litValue(s, first) > 0 && s->reason[SAT_VAR(first)] == ref;
+        if (i < half && (keys[i] >> 32) > 2 && !locked) {
+            s->pool.data[ref + 1] |= SAT_DELETED;
+        } else {
+            s->learnts.data[s->learnts.size++] = ref;
+        }
+    }
+    free(keys);
+    return 0;
+}
+
+// Term i (from 0) of the Luby sequence 1 1 2 1 1 2 4 ...
+long luby(long i) {
+    long size = 1;
+    int power = 0;
+    while (size < i + 1) {
+        size = 2 * size + 1;
+        power++;
+    }
+    while (size - 1 != i) {
+        size = (size - 1) / 2;
+        power--;
+        i %= size;
+    }
+    return 1L << power;
+}
+
+// Search for a model in which every assumption holds. Returns 1 when one
+// is found (in s->value), 0 when there is none (with the failed
+// assumptions, negated, in s->core), and -1 when the conflict limit, the
+// schedule's deadline or cancellation stops the search first.
+int satSolve(SatSolver *s, const int *assumptions, int count, long conflictLimit, const Schedule *sch) {
+    s->core.size = 0;
+    if (!s->ok) return 0;
+    satBacktrack(s, 0);
+    long limit = s->conflicts + conflictLimit;
+    long restarts = 0;
+    long nextRestart = s->conflicts + SAT_RESTART_UNIT;
+    int maxLearnts = SAT_FIRST_REDUCE + s->learnts.size;
+    
+    for (;;) {
+        int conflict = satPropagate(s);
+        if (conflict >= 0) {
+            s->conflicts++;
+            if (s->trailLimits.size == 0) {
+                s->ok = 0;
+                return 0;
+            }
+            int lbd;
+            int back = satAnalyze(s, conflict, &lbd);
+            if (back < 0) return -1;
+            satBacktrack(s, back);
+            if (s->learnt.size == 1) {
+                satAssign(s, s->learnt.data[0], -1);
+            } else {
+                int ref = attachClause(s, s->learnt.data, s->learnt.size, lbd << 2 | SAT_LEARNT);
+                if (ref < 0 || pushInt(&s->learnts, ref) != 0) return -1;
+                satAssign(s, s->learnt.data[0], ref);
+            }
+            s->increment *= 1 / 0.95;
+            
+            if (s->conflicts >= limit || ((s->conflicts & 255) == 0 && outOfTime(sch))) {
+                satBacktrack(s, 0);
+                return -1;
+            }
+            if (s->conflicts >= nextRestart) {
+                nextRestart = s->conflicts + luby(++restarts) * SAT_RESTART_UNIT;
+                satBacktrack(s, 0);
+            }
+            continue;
+        }
+        
+        if (s->learnts.size >= maxLearnts) {
+            if (satReduce(s) != 0) return -1;
+            maxLearnts += maxLearnts / 10;
+        }
+        
+        // Assumptions take the first decision levels
+        int next = -1;
+        while (s->trailLimits.size < count) {
+            int lit = assumptions[s->trailLimits.size];
+            if (litValue(s, lit) > 0) {
+                if (pushInt(&s->trailLimits, s->trailSize) != 0) return -1;
+            } else if (litValue(s, lit) < 0) {
+                if (satAnalyzeFinal(s, lit ^ 1) != 0) return -1;
+                satBacktrack(s, 0);
+                return 0;
+            } else {
+                next = lit;
+                break;
+            }
+        }
+        while (next == -1 && s->heapSize > 0) {
+            int var = heapPop(s);
+            if (s->value[var] == 0) next = SAT_LIT(var, s->phase[var] <= 0);
+        }
+        if (next == -1) return 1;
+        if (pushInt(&s->trailLimits, s->trailSize) != 0) return -1;
+        satAssign(s, next, -1);
+    }
+}
+
+// CNF under construction; clauses are stored 0-terminated as literal + 1
+typedef struct {
+    int vars;
+    IntVector clauses;
+    int failed;              // Out of memory while encoding
+} Cnf;
+
+int newVariable(Cnf *cnf) {
+    return cnf->vars++;
+}
+
+// Add the clause lits (with guard appended when it is not -1)
+void addClause(Cnf *cnf, const int *lits, int size, int guard) {
+    for (int i = 0; i < size; i++) {
+        if (pushInt(&cnf->clauses, lits[i] + 1) != 0) cnf->failed = 1;
+    }
+    if (guard >= 0 && pushInt(&cnf->clauses, guard + 1) != 0) cnf->failed = 1;
+    if (pushInt(&cnf->clauses, 0) != 0) cnf->failed = 1;
+}
+
+// At most limit of the variables are true, unless the selector is false.
+// Sequential counter: register j of variable i means "more than j of the
+// first i + 1 are true", and only the clauses that forbid exceeding the
+// limit carry the guard.
+void encodeAtMost(Cnf *cnf, const int *vars, int count, int limit, int selector) {
+    int guard = SAT_LIT(selector, 1);
+    if (count <= limit) return;
+    if (limit == 0) {
+        for (int i = 0; i < count; i++) {
+            int lit = SAT_LIT(vars[i], 1);
+            addClause(cnf, &lit, 1, guard);
+        }
+        return;
+    }
+    if (limit == 1 && count <= 5) {
+        for (int i = 0; i < count; i++) {
+            for (int k = i + 1; k < count; k++) {
+                int lits[2] = {SAT_LIT(vars[i], 1), SAT_LIT(vars[k], 1)};
+                addClause(cnf, lits, 2, guard);
+            }
+        }
+        return;
+    }
+    
+    int first = cnf->vars;
+    cnf->vars += (count - 1) * limit;
+    #define COUNTER(i, j) (first + (i) * limit + (j))
+    for (int i = 0; i < count - 1; i++) {
+        int lits[3] = {SAT_LIT(vars[i], 1), SAT_LIT(COUNTER(i, 0), 0)};
+        addClause(cnf, lits, 2, -1);
+        for (int j = 0; j < limit; j++) {
+            if (i > 0) {
+                int carry[2] = {SAT_LIT(COUNTER(i - 1, j), 1), SAT_LIT(COUNTER(i, j), 0)};
+                addClause(cnf, carry, 2, -1);
+            }
+            if (i > 0 && j > 0) {
+                int step[3] = {SAT_LIT(vars[i], 1), SAT_LIT(COUNTER(i - 1, j - 1), 1), SAT_LIT(COUNTER(i, j), 0)};
+                addClause(cnf, step, 3, -1);
+            }
+        }
+        if (i > 0) {
+            int over[2] = {SAT_LIT(vars[i], 1), SAT_LIT(COUNTER(i - 1, limit - 1), 1)};
+            addClause(cnf, over, 2, guard);
+        }
+    }
+    int last[2] = {SAT_LIT(vars[count - 1], 1), SAT_LIT(COUNTER(count - 2, limit - 1), 1)};
+    addClause(cnf, last, 2, guard);
+    #undef COUNTER
+}
+
+// At least need of the variables are true, unless the selector is false.
+// Register j of variable i may only be true when at least j + 1 of the
+// first i + 1 are, and the selector requires the last register.
+void encodeAtLeast(Cnf *cnf, const int *vars, int count, int need, int selector) {
+    int guard = SAT_LIT(selector, 1);
+    if (need <= 0) return;
+    if (count < need) {
+        addClause(cnf, NULL, 0, guard);
+        return;
+    }
+    
+    int first = cnf->vars;
+    cnf->vars += count * need;
+    #define COUNTER(i, j) (first + (i) * need + (j))
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < need; j++) {
+            int reg = SAT_LIT(COUNTER(i, j), 1);
+            if (i == 0) {
+                // One variable counts to one at most
+                int lits[2] = {reg, SAT_LIT(vars[0], 0)};
+                addClause(cnf, lits, j == 0 ? 2 : 1, -1);
+                continue;
+            }
+            int without[3] = {reg, SAT_LIT(COUNTER(i - 1, j), 0), SAT_LIT(vars[i], 0)};
+            addClause(cnf, without, 3, -1);
+            if (j > 0) {
+                int with[3] = {reg, SAT_LIT(COUNTER(i - 1, j), 0), SAT_LIT(COUNTER(i - 1, j - 1), 0)};
+                addClause(cnf, with, 3, -1);
+            }
+        }
+    }
+    int goal = SAT_LIT(COUNTER(count - 1, need - 1), 0);
+    addClause(cnf, &goal, 1, guard);
+    #undef COUNTER
+}
+
+// Constraint groups that a selector switches on, for naming an unsat core
+enum {
+    CORE_UNIT,     // Occurrences and one start a day of a (subject, section) unit
+    CORE_SECTION,  // One class at a time in a section
+    CORE_FACULTY,  // One class at a time for a faculty member, and their busy cells
+    CORE_ROOMS     // Rooms of one type
+};
+
+typedef struct {
+    int subIdx;
+    int section;
+    int remaining;           // Occurrences left after the pins
+    int firstVar;            // Start variables firstVar .. firstVar + starts - 1
+    int starts;
+} SatUnit;
+
+typedef struct {
+    Schedule *sch;
+    Cnf cnf;
+    SatUnit *units;
+    int unitCount;
+    int *varCell;            // Start cell of each start variable
+    int *varUnit;
+    int startVars;           // Start variables come first, then the selectors
+    int *selectorVar;        // Selector variables, assumed true
+    int *selectorKind;       // CORE_* of each, and the unit, section, faculty or room type
+    int *selectorIndex;
+    int selectorCount;
+    int *scratch;            // Variables of one cardinality constraint
+    int *roomFirst;          // First room variable of each start variable
+    uint64_t *roomChoices;   // Rooms (by Room.bit) free for each start, one variable each
+} SatModel;
+
+int addSelector(SatModel *m, int kind, int index) {
+    m->selectorVar[m->selectorCount] = newVariable(&m->cnf);
+    m->selectorKind[m->selectorCount] = kind;
+    m->selectorIndex[m->selectorCount] = index;
+    return m->selectorVar[m->selectorCount++];
+}
+
+// At most one of the starts of the listed units may cover any one cell
+void encodeOneAtATime(SatModel *m, const int *unitList, int listCount, int selector) {
+    const Grid *grid = &m->sch->ctx->grid;
+    const Subject *subjects = m->sch->ctx->subjects;
+    for (int cell = 0; cell < grid->cells; cell++) {
+        if (!((grid->teachingMask >> cell) & 1)) continue;
+        int count = 0;
+        for (int k = 0; k < listCount; k++) {
+            const SatUnit *unit = &m->units[unitList[k]];
+            int duration = subjects[unit->subIdx].duration;
+            for (int v = unit->firstVar; v < unit->firstVar + unit->starts; v++) {
+                if (m->varCell[v] <= cell && cell < m->varCell[v] + duration) m->scratch[count++] = v;
+            }
+        }
+        encodeAtMost(&m->cnf, m->scratch, count, 1, selector);
+    }
+}
+
+// Print the constraint groups of a core; returns how many faculty it names
+int reportCore(SatModel *m, const IntVector *core) {
+    Schedule *sch = m->sch;
+    const SchedulerContext *ctx = sch->ctx;
+    sch->coreFacultyCount = 0;
+    if (core->size == 0) {
+        LOG(sch->verbose, LOG_QUIET, "Infeasible: no timetable places every required occurrence.\n");
+        return 0;
+    }
+    LOG(sch->verbose, LOG_QUIET, "Infeasible: these constraints cannot all hold (unsat core):\n");
+    for (int i = 0; i < core->size; i++) {
+        int sel = 0;
+        while (m->selectorVar[sel] != SAT_VAR(core->data[i])) sel++;
+        int index = m->selectorIndex[sel];
+        switch (m->selectorKind[sel]) {
+        case CORE_UNIT:
+            LOG(sch->verbose, LOG_QUIET, "  %s for section %s: %d more occurrence(s), at most one a day\n",
+                ctx->subjects[m->units[index].subIdx].name, ctx->sectionNames[m->units[index].section],
+                m->units[index].remaining);
+            break;
+        case CORE_SECTION:
+            LOG(sch->verbose, LOG_QUIET, "  section %s: one class at a time\n", ctx->sectionNames[index]);
+            break;
+        case CORE_FACULTY:
+            LOG(sch->verbose, LOG_QUIET, "  faculty %s: one class at a time, blackouts and pinned classes\n",
+                ctx->allFaculties[index]);
+            if (sch->coreFacultyCount < MAX_CORE_FACULTY) sch->coreFaculty[sch->coreFacultyCount++] = index;
+            break;
+        default:
+            LOG(sch->verbose, LOG_QUIET, "  %s rooms: %d declared\n", roomTypeNames[index], ctx->roomTypeCount[index]);
+            break;
+        }
+    }
+    return sch->coreFacultyCount;
+}
+
+// Solve the demand left after the pins exactly; returns one of SOLVE_*
+int solveSat(Schedule *sch) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subjects = ctx->subjects;
+    const Grid *grid = &ctx->grid;
+    int sectionCount = ctx->sectionCount;
+    long conflictLimit = sch->nodeLimit > 0 ? sch->nodeLimit : ctx->options.maxNodes;
+    double deadline = sch->deadline;
+    sch->deadline = wallClockSeconds() + ctx->options.timeLimit;
+    if (deadline > 0 && deadline < sch->deadline) sch->deadline = deadline;
+    LOG(sch->verbose, LOG_INFO, "Running SAT solver (conflict limit %ld, time limit %.1fs)...\n",
+        conflictLimit, ctx->options.timeLimit);
+    
+    SatModel m;
+    memset(&m, 0, sizeof(m));
+    m.sch = sch;
+    int maxUnits = ctx->subjectCount * sectionCount;
+    int maxSelectors = maxUnits + sectionCount + ctx->totalFaculties + ROOM_TYPES;
+    m.units = malloc((maxUnits + 1) * sizeof(SatUnit));
+    m.varCell = malloc(((size_t)maxUnits * MAX_TOTAL_SLOTS + 1) * sizeof(int));
+    m.varUnit = malloc(((size_t)maxUnits * MAX_TOTAL_SLOTS + 1) * sizeof(int));
+    m.scratch = malloc(((size_t)maxUnits * MAX_TOTAL_SLOTS + 1) * sizeof(int));
+    m.roomFirst = malloc(((size_t)maxUnits * MAX_TOTAL_SLOTS + 1) * sizeof(int));
+    m.roomChoices = calloc((size_t)maxUnits * MAX_TOTAL_SLOTS + 1, sizeof(uint64_t));
+    m.selectorVar = malloc((maxSelectors + 1) * sizeof(int));
+    m.selectorKind = malloc((maxSelectors + 1) * sizeof(int));
+    m.selectorIndex = malloc((maxSelectors + 1) * sizeof(int));
+    int *list = malloc((maxUnits + 1) * sizeof(int));
+    int *assumptions = malloc((maxSelectors + 1) * sizeof(int));
+    int lits[MAX_ROOMS_PER_TYPE + 1];
+    SatSolver solver;
+    int solverReady = 0;
+    int status = SOLVE_BUDGET_EXHAUSTED;
+    int required = 0;
+    if (!m.units || !m.varCell || !m.varUnit || !m.scratch || !m.roomFirst || !m.roomChoices || !m.selectorVar ||
+        !m.selectorKind || !m.selectorIndex || !list || !assumptions) {
+        goto oom;
+    }
+    
+    // Start variables: every cell where a unit's block fits around the pins
+    for (int i = 0; i < ctx->subjectCount; i++) {
+        for (int s = 0; s < sectionCount; s++) {
+            if (subjects[i].section_specific && subjects[i].target_section != s) continue;
+            int remaining = subjects[i].occurrences - countSubjectOccurrences(sch, i, s);
+            if (remaining < 1) continue;
+            SatUnit *unit = &m.units[m.unitCount++];
+            unit->subIdx = i;
+            unit->section = s;
+            unit->remaining = remaining;
+            unit->firstVar = m.cnf.vars;
+            uint64_t free = ~sch->sectionBusy[s] & grid->teachingMask;
+            uint64_t starts = blockStarts(grid, free, subjects[i].duration) &
+                              ~grid->dayCells[SUBJECT_DAYS(sch, s, i)];
+            for (; starts; starts &= starts - 1) {
+                m.varCell[m.cnf.vars] = CTZ64(starts);
+                m.varUnit[m.cnf.vars] = m.unitCount - 1;
+                newVariable(&m.cnf);
+            }
+            unit->starts = m.cnf.vars - unit->firstVar;
+            required += remaining;
+        }
+    }
+    m.startVars = m.cnf.vars;
+    sch->unplaced = required;
+    
+    // Units: enough starts, on different days
+    for (int u = 0; u < m.unitCount; u++) {
+        const SatUnit *unit = &m.units[u];
+        int selector = addSelector(&m, CORE_UNIT, u);
+        for (int v = 0; v < unit->starts; v++) m.scratch[v] = unit->firstVar + v;
+        encodeAtLeast(&m.cnf, m.scratch, unit->starts, unit->remaining, selector);
+        for (int d = 0; d < grid->days; d++) {
+            int count = 0;
+            for (int v = unit->firstVar; v < unit->firstVar + unit->starts; v++) {
+                if (CELL_DAY(grid, m.varCell[v]) == d) m.scratch[count++] = v;
+            }
+            encodeAtMost(&m.cnf, m.scratch, count, 1, selector);
+        }
+    }
+    
+    // Sections: one class at a time
+    for (int s = 0; s < sectionCount; s++) {
+        int count = 0;
+        for (int u = 0; u < m.unitCount; u++) {
+            if (m.units[u].section == s) list[count++] = u;
+        }
+        if (count > 0) encodeOneAtATime(&m, list, count, addSelector(&m, CORE_SECTION, s));
+    }
+    
+    // Faculty: one class at a time, never in a busy cell (blackouts and pins)
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        int count = 0;
+        for (int u = 0; u < m.unitCount; u++) {
+            const Subject *subject = &subjects[m.units[u].subIdx];
+            for (int k = 0; k < subject->facultyCount; k++) {
+                if (subject->facultyIds[k] == f) {
+                    list[count++] = u;
+                    break;
+                }
+            }
+        }
+        if (count == 0) continue;
+        int selector = addSelector(&m, CORE_FACULTY, f);
+        encodeOneAtATime(&m, list, count, selector);
+        for (int k = 0; k < count; k++) {
+            const SatUnit *unit = &m.units[list[k]];
+            for (int v = unit->firstVar; v < unit->firstVar + unit->starts; v++) {
+                if (sch->facultyBusy[f] & subjectBlock(&subjects[unit->subIdx], m.varCell[v])) {
+                    int lits[1] = {SAT_LIT(v, 1)};
+                    addClause(&m.cnf, lits, 1, SAT_LIT(selector, 1));
+                }
+            }
+        }
+    }
+    
+    // Declared rooms: a start takes one of the rooms of its type that the
+    // pins leave free for the whole block, and a room holds one class at a
+    // time. Counting free rooms per cell is not enough, since a class keeps
+    // its room for every hour of the block.
+    for (int type = 0; type < ROOM_TYPES; type++) {
+        if (ctx->roomTypeCount[type] == 0) continue;
+        int count = 0;
+        for (int u = 0; u < m.unitCount; u++) {
+            if (subjects[m.units[u].subIdx].roomType == type) list[count++] = u;
+        }
+        if (count == 0) continue;
+        int selector = addSelector(&m, CORE_ROOMS, type);
+        for (int k = 0; k < count; k++) {
+            const SatUnit *unit = &m.units[list[k]];
+            int duration = subjects[unit->subIdx].duration;
+            for (int v = unit->firstVar; v < unit->firstVar + unit->starts; v++) {
+                uint64_t rooms = ~0ULL;
+                for (int c = m.varCell[v]; c < m.varCell[v] + duration; c++) {
+                    rooms &= sch->roomFree[type][c];
+                }
+                m.roomFirst[v] = m.cnf.vars;
+                m.roomChoices[v] = rooms;
+                int size = 0;
+                lits[size++] = SAT_LIT(v, 1);
+                for (; rooms; rooms &= rooms - 1) {
+                    int room = newVariable(&m.cnf);
+                    int link[2] = {SAT_LIT(room, 1), SAT_LIT(v, 0)};
+                    addClause(&m.cnf, link, 2, -1);
+                    lits[size++] = SAT_LIT(room, 0);
+                }
+                addClause(&m.cnf, lits, size, selector);
+            }
+        }
+        for (int bit = 0; bit < ctx->roomTypeCount[type]; bit++) {
+            uint64_t below = (1ULL << bit) - 1;
+            for (int cell = 0; cell < grid->cells; cell++) {
+                if (!((grid->teachingMask >> cell) & 1)) continue;
+                int covering = 0;
+                for (int k = 0; k < count; k++) {
+                    const SatUnit *unit = &m.units[list[k]];
+                    int duration = subjects[unit->subIdx].duration;
+                    for (int v = unit->firstVar; v < unit->firstVar + unit->starts; v++) {
+                        if (m.varCell[v] <= cell && cell < m.varCell[v] + duration &&
+                            ((m.roomChoices[v] >> bit) & 1)) {
+                            m.scratch[covering++] = m.roomFirst[v] + POPCOUNT64(m.roomChoices[v] & below);
+                        }
+                    }
+                }
+                encodeAtMost(&m.cnf, m.scratch, covering, 1, selector);
+            }
+        }
+    }
+    if (m.cnf.failed) goto oom;
+    
+    if (satInit(&solver, m.cnf.vars, sch) != 0) goto oom;
+    solverReady = 1;
+    int *clause = m.cnf.clauses.data;
+    int clauses = 0;
+    for (int i = 0, start = 0; i < m.cnf.clauses.size; i++) {
+        if (clause[i] != 0) {
+            clause[i]--;
+            continue;
+        }
+        if (satAddClause(&solver, clause + start, i - start) != 0) goto oom;
+        start = i + 1;
+        clauses++;
+    }
+    for (int k = 0; k < m.selectorCount; k++) {
+        assumptions[k] = SAT_LIT(m.selectorVar[k], 0);
+    }
+    LOG(sch->verbose, LOG_INFO, "SAT encoding: %d variables (%d starts), %d clauses, %d selectors\n",
+        m.cnf.vars, m.startVars, clauses, m.selectorCount);
+    
+    int result = satSolve(&solver, assumptions, m.selectorCount, conflictLimit, sch);
+    if (result == 1) {
+        // Place the first required starts of every unit
+        for (int u = 0; u < m.unitCount; u++) {
+            const SatUnit *unit = &m.units[u];
+            int placed = 0;
+            for (int v = unit->firstVar; v < unit->firstVar + unit->starts && placed < unit->remaining; v++) {
+                if (solver.value[v] <= 0) continue;
+                int day = CELL_DAY(grid, m.varCell[v]);
+                int slot = CELL_SLOT(grid, m.varCell[v]);
+                if (!canPlaceSubject(sch, unit->subIdx, day, slot, unit->section)) {
+                    printf("ERROR: SAT model placed %s for section %d where it does not fit\n",
+                           subjects[unit->subIdx].name, unit->section + 1);
+                    continue;
+                }
+                if (placeSubject(sch, unit->subIdx, day, slot, unit->section,
+                                 countSubjectOccurrences(sch, unit->subIdx, unit->section) + 1) != 0) {
+                    printf("ERROR: SAT model left %s for section %d without a room\n",
+                           subjects[unit->subIdx].name, unit->section + 1);
+                    continue;
+                }
+                placed++;
+                sch->unplaced--;
+                
+                // Take the room the model chose; the rooms of the starts
+                // placed so far are the model's too, so it is free
+                uint64_t rooms = m.roomChoices[v];
+                for (int k = 0; rooms; k++, rooms &= rooms - 1) {
+                    if (solver.value[m.roomFirst[v] + k] <= 0) continue;
+                    if (moveRoom(sch, unit->section, m.varCell[v], CTZ64(rooms)) != 0) {
+                        printf("ERROR: SAT model gave %s for section %d a room that is taken\n",
+                               subjects[unit->subIdx].name, unit->section + 1);
+                    }
+                    break;
+                }
+            }
+        }
+        status = sch->unplaced > 0 ? SOLVE_INCOMPLETE : SOLVE_FEASIBLE;
+        if (sch->unplaced == 0) LOG(sch->verbose, LOG_INFO, "All %d occurrences placed.\n", required);
+    } else if (result == 0) {
+        // Shrink the core: drop each selector whose removal keeps it unsat
+        // (the solver's core holds the negated assumptions)
+        int coreSize = solver.core.size;
+        int *core = assumptions;
+        for (int i = 0; i < coreSize; i++) core[i] = solver.core.data[i] ^ 1;
+        int *trial = malloc((coreSize + 1) * sizeof(int));
+        for (int i = 0; trial && i < coreSize && solver.ok && !outOfTime(sch); i++) {
+            // Each check takes what is left of the conflict budget, up to
+            // SAT_CORE_CONFLICTS
+            long budget = conflictLimit - solver.conflicts;
+            if (budget <= 0) break;
+            if (budget > SAT_CORE_CONFLICTS) budget = SAT_CORE_CONFLICTS;
+            int count = 0;
+            for (int k = 0; k < coreSize; k++) {
+                if (k != i) trial[count++] = core[k];
+            }
+            if (satSolve(&solver, trial, count, budget, sch) != 0) continue;
+            coreSize = solver.core.size;
+            for (int k = 0; k < coreSize; k++) core[k] = solver.core.data[k] ^ 1;
+            i = -1; // The new core is a subset; check it from the start
+        }
+        free(trial);
+        IntVector final = {core, coreSize, coreSize};
+        status = SOLVE_INFEASIBLE;
+        reportCore(&m, &final);
+    } else {
+        LOG(sch->verbose, LOG_QUIET, "WARNING: Search budget exhausted before a complete timetable was found.\n");
+    }
+    LOG(sch->verbose, LOG_INFO, "SAT solver used %ld conflicts\n", solver.conflicts);
+    sch->stats.nodes += solver.conflicts;
+    goto done;
+    
+oom:
+    printf("ERROR: Out of memory for the SAT solver\n");
+done:
+    if (solverReady) satRelease(&solver);
+    sch->deadline = deadline;
+    free(m.cnf.clauses.data);
+    free(m.units);
+    free(m.varCell);
+    free(m.varUnit);
+    free(m.scratch);
+    free(m.roomFirst);
+    free(m.roomChoices);
+    free(m.selectorVar);
+    free(m.selectorKind);
+    free(m.selectorIndex);
+    free(list);
+    free(assumptions);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// Local search
+//
+// Once the solver is done, the fill pass and simulated annealing lower the
+// soft cost without breaking a hard rule.
+// ---------------------------------------------------------------------------
+
+// Put an occurrence back, keeping the assigned flag right. Moves that are
+// tried and undone reach the decision log like any other placement.
+void restorePlacement(Schedule *sch, int subIdx, int cell, int section) {
+    occupySlots(sch, subIdx, CELL_DAY(&sch->ctx->grid, cell), CELL_SLOT(&sch->ctx->grid, cell), section);
+    ASSIGNED(sch, section, subIdx) =
+        countSubjectOccurrences(sch, subIdx, section) >= sch->ctx->subjects[subIdx].occurrences;
+}
+
+void liftPlacement(Schedule *sch, int subIdx, int cell, int section) {
+    unplaceSubject(sch, subIdx, CELL_DAY(&sch->ctx->grid, cell), CELL_SLOT(&sch->ctx->grid, cell), section);
+}
+
+// Fill remaining free slots with extra occurrences of one-hour subjects,
+// choosing for each slot the subject that adds the least soft cost. Every
+// subject's starts in a section are scored once, into a table by cell.
+// Filling a cell only takes that cell, which the scan has passed, so it
+// changes the idle cells of its day for every subject, and the faculty
+// hours of the subjects that share faculty with the filled one; only those
+// scores are worked out again.
+void fillFreeSlots(Schedule *sch) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subjects = ctx->subjects;
+    int subjectCount = ctx->subjectCount;
+    int sectionCount = ctx->sectionCount;
+    const Grid *grid = &ctx->grid;
+    uint64_t *starts = malloc(subjectCount * sizeof(uint64_t));
+    int *costs = malloc((size_t)subjectCount * MAX_TOTAL_SLOTS * sizeof(int));
+    if (!starts || !costs) {
+        free(starts);
+        free(costs);
+        return;
+    }
+    
+    // Check for empty slots and try to fill them with additional subjects
+    for (int s = 0; s < sectionCount; s++) {
+        for (int subIdx = 0; subIdx < subjectCount; subIdx++) {
+            // Skip longer subjects for simplicity
+            starts[subIdx] = subjects[subIdx].duration == 1 ? feasibleStarts(sch, subIdx, s) : 0;
+            scoreStarts(sch, subIdx, s, starts[subIdx], &costs[subIdx * MAX_TOTAL_SLOTS]);
+        }
+        uint64_t open = grid->teachingMask & ~sch->sectionBusy[s];
+        for (; open; open &= open - 1) {
+            int cell = CTZ64(open);
+            int best = -1;
+            for (int subIdx = 0; subIdx < subjectCount; subIdx++) {
+                if (!((starts[subIdx] >> cell) & 1)) continue;
+                if (best == -1 || costs[subIdx * MAX_TOTAL_SLOTS + cell] < costs[best * MAX_TOTAL_SLOTS + cell]) {
+                    best = subIdx;
+                }
+            }
+            if (best == -1) continue;
+            
+            // Place an extra occurrence of this subject
+            int day = CELL_DAY(grid, cell);
+            int currOccur = countSubjectOccurrences(sch, best, s) + 1;
+            placeSubject(sch, best, day, CELL_SLOT(grid, cell), s, currOccur);
+            STAT_ADD(sch, fillInsertions, 1);
+            starts[best] = feasibleStarts(sch, best, s);
+            for (int subIdx = 0; subIdx < subjectCount; subIdx++) {
+                uint64_t changed = subIdx == best || ctx->sharesFaculty[best * subjectCount + subIdx]
+                                 ? starts[subIdx] : starts[subIdx] & grid->dayCells[1 << day];
+                scoreStarts(sch, subIdx, s, changed, &costs[subIdx * MAX_TOTAL_SLOTS]);
+            }
+        }
+    }
+    free(starts);
+    free(costs);
+}
+
+// Metropolis acceptance of a move that makes the cost worse by delta
+int acceptWorse(Schedule *sch, int delta, double temperature) {
+    double x = delta / temperature;
+    return x < 30.0 && nextRandom(sch) < exp(-x) * 4294967296.0;
+}
+
+// Simulated annealing over three neighbourhoods within one section:
+//  - move an occurrence to another start cell where it fits;
+//  - swap two one-hour occurrences;
+//  - turn an extra one-hour occurrence into a different subject.
+// Required occurrence counts, pins and every hard rule are preserved. The best
+// schedule seen is kept. Returns the number of accepted moves.
+long optimizeSchedule(Schedule *sch, long moves) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subjects = ctx->subjects;
+    const Grid *grid = &ctx->grid;
+    if (moves <= 0 || ctx->subjectCount == 0) return 0;
+    
+    Schedule best = {0};
+    if (scheduleCopy(&best, sch) != 0) return 0;
+    
+    long cost = softCost(sch);
+    long bestCost = cost;
+    long accepted = 0;
+    const double startTemperature = WEIGHT_OVERLOAD;
+    const double endTemperature = 0.05;
+    double cooling = exp(log(endTemperature / startTemperature) / moves);
+    double temperature = startTemperature;
+    
+    for (long m = 0; m < moves; m++, temperature *= cooling) {
+        if ((m & 1023) == 0 && outOfTime(sch)) break;
+        
+        int s = randomBelow(sch, ctx->sectionCount);
+        int cell = randomBelow(sch, grid->cells);
+        int x = sch->timetable[s * MAX_TOTAL_SLOTS + cell];
+        if (x < 0 || (sch->pinnedCells[s] >> cell) & 1) continue;
+        cell = placementStart(sch, s, cell);
+        int day = CELL_DAY(grid, cell);
+        
+        int kind = randomBelow(sch, 100);
+        int delta;
+        if (kind < 50) {
+            // Move x to another feasible start cell
+            liftPlacement(sch, x, cell, s);
+            uint64_t starts = feasibleStarts(sch, x, s) & ~(1ULL << cell);
+            if (!starts) {
+                restorePlacement(sch, x, cell, s);
+                continue;
+            }
+            for (int k = randomBelow(sch, POPCOUNT64(starts)); k > 0; k--) starts &= starts - 1;
+            int target = CTZ64(starts);
+            unsigned int days = (1 << day) | (1 << CELL_DAY(grid, target));
+            
+            restorePlacement(sch, x, cell, s);
+            int before = moveCost(sch, s, &x, 1, days);
+            liftPlacement(sch, x, cell, s);
+            restorePlacement(sch, x, target, s);
+            delta = moveCost(sch, s, &x, 1, days) - before;
+            if (delta > 0 && !acceptWorse(sch, delta, temperature)) {
+                liftPlacement(sch, x, target, s);
+                restorePlacement(sch, x, cell, s);
+                continue;
+            }
+        } else if (kind < 85) {
+            // Swap two one-hour occurrences of different subjects
+            int other = randomBelow(sch, grid->cells);
+            int y = sch->timetable[s * MAX_TOTAL_SLOTS + other];
+            if (y < 0 || y == x || subjects[x].duration != 1 || subjects[y].duration != 1 ||
+                (sch->pinnedCells[s] >> other) & 1) {
+                continue;
+            }
+            int pair[2] = {x, y};
+            unsigned int days = (1 << day) | (1 << CELL_DAY(grid, other));
+            
+            int before = moveCost(sch, s, pair, 2, days);
+            liftPlacement(sch, x, cell, s);
+            liftPlacement(sch, y, other, s);
+            if (!canPlaceSubject(sch, x, CELL_DAY(grid, other), CELL_SLOT(grid, other), s) ||
+                !canPlaceSubject(sch, y, day, CELL_SLOT(grid, cell), s)) {
+                restorePlacement(sch, x, cell, s);
+                restorePlacement(sch, y, other, s);
+                continue;
+            }
+            restorePlacement(sch, x, other, s);
+            restorePlacement(sch, y, cell, s);
+            delta = moveCost(sch, s, pair, 2, days) - before;
+            if (delta > 0 && !acceptWorse(sch, delta, temperature)) {
+                liftPlacement(sch, x, other, s);
+                liftPlacement(sch, y, cell, s);
+                restorePlacement(sch, x, cell, s);
+                restorePlacement(sch, y, other, s);
+                continue;
+            }
+        } else {
+            // Replace an extra occurrence of x with another one-hour subject
+            int y = randomBelow(sch, ctx->subjectCount);
+            if (y == x || subjects[x].duration != 1 || subjects[y].duration != 1 ||
+                countSubjectOccurrences(sch, x, s) <= subjects[x].occurrences) {
+                continue;
+            }
+            int pair[2] = {x, y};
+            int before = moveCost(sch, s, pair, 2, 1 << day);
+            liftPlacement(sch, x, cell, s);
+            if (!canPlaceSubject(sch, y, day, CELL_SLOT(grid, cell), s)) {
+                restorePlacement(sch, x, cell, s);
+                continue;
+            }
+            restorePlacement(sch, y, cell, s);
+            delta = moveCost(sch, s, pair, 2, 1 << day) - before;
+            if (delta > 0 && !acceptWorse(sch, delta, temperature)) {
+                liftPlacement(sch, y, cell, s);
+                restorePlacement(sch, x, cell, s);
+                continue;
+            }
+        }
+        
+        cost += delta;
+        accepted++;
+        if (cost < bestCost) {
+            bestCost = cost;
+            scheduleCopy(&best, sch);
+        }
+    }
+    
+    if (cost > bestCost) {
+        scheduleCopy(sch, &best);
+    }
+    scheduleRelease(&best);
+    return accepted;
+}
+
+// Run a solver on an empty schedule
+void runSolver(Schedule *sch, int solver) {
+    resetTimetable(sch);
+    sch->coreFacultyCount = 0;
+    if (solver == SOLVER_BACKTRACK) {
+        sch->status = solveBacktracking(sch);
+    } else if (solver == SOLVER_SAT) {
+        sch->status = solveSat(sch);
+    } else {
+        generateGreedy(sch);
+        sch->status = sch->unplaced > 0 ? SOLVE_INCOMPLETE : SOLVE_FEASIBLE;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Portfolio search: independent seeded attempts on a pool of threads. The
+// first complete schedule wins and cancels the rest; otherwise the attempt
+// with the fewest unplaced occurrences is kept.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    SchedulerContext *ctx;
+    Schedule *best;
+    int bestAttempt;
+    int attempts;
+    int completed;
+    SolveStats stats;          // Counters of every attempt
+    uint64_t seed;
+    atomic_int nextWorker;
+    atomic_int nextAttempt;
+    atomic_int cancel;
+    pthread_mutex_t lock;
+} Portfolio;
+
+void *portfolioWorker(void *arg) {
+    Portfolio *pf = arg;
+    // Every thread owns one of the context's scratch schedules
+    Schedule *work = &pf->ctx->workers[atomic_fetch_add(&pf->nextWorker, 1)];
+    
+    for (;;) {
+        int attempt = atomic_fetch_add(&pf->nextAttempt, 1);
+        if (attempt >= pf->attempts || atomic_load(&pf->cancel)) break;
+        
+        seedSchedule(work, pf->seed + attempt);
+        memset(&work->stats, 0, sizeof(SolveStats));
+        work->verbose = LOG_SILENT;
+        work->cancel = &pf->cancel;
+        runSolver(work, pf->ctx->options.solver);
+        
+        pthread_mutex_lock(&pf->lock);
+        addStats(&pf->stats, &work->stats);
+        // Attempts interrupted by a winner are incomplete and discarded
+        if (!atomic_load(&pf->cancel)) {
+            pf->completed++;
+        }
+        if (!atomic_load(&pf->cancel) &&
+            (pf->bestAttempt == -1 || work->unplaced < pf->best->unplaced)) {
+            scheduleCopy(pf->best, work);
+            pf->bestAttempt = attempt;
+            if (work->unplaced == 0) {
+                atomic_store(&pf->cancel, 1);
+            }
+        }
+        pthread_mutex_unlock(&pf->lock);
+    }
+    
+    return NULL;
+}
+
+// Size the context's scratch schedules for a number of threads. They are
+// reused by later solves on this context. Returns how many are ready.
+int prepareWorkers(SchedulerContext *ctx, int threads) {
+    if (ctx->workerCount < threads) {
+        Schedule *workers = realloc(ctx->workers, threads * sizeof(Schedule));
+        if (!workers) {
+            threads = ctx->workerCount;
+        } else {
+            memset(workers + ctx->workerCount, 0, (threads - ctx->workerCount) * sizeof(Schedule));
+            ctx->workers = workers;
+            ctx->workerCount = threads;
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        if (scheduleInit(&ctx->workers[t], ctx) != 0) return t;
+    }
+    return threads;
+}
+
+// Run the portfolio and leave the winning schedule in ctx->schedule
+void runPortfolio(SchedulerContext *ctx, uint64_t seed) {
+    Schedule *sch = ctx->schedule;
+    LOG(ctx->options.verbose, LOG_INFO, "Running %d seeded attempts on %d threads...\n",
+        ctx->options.attempts, ctx->options.threads);
+    int threads = prepareWorkers(ctx, ctx->options.threads);
+    
+    Portfolio pf;
+    pf.ctx = ctx;
+    pf.best = sch;
+    pf.bestAttempt = -1;
+    pf.attempts = ctx->options.attempts;
+    pf.completed = 0;
+    memset(&pf.stats, 0, sizeof(SolveStats));
+    pf.seed = seed;
+    atomic_init(&pf.nextWorker, 0);
+    atomic_init(&pf.nextAttempt, 0);
+    atomic_init(&pf.cancel, 0);
+    pthread_mutex_init(&pf.lock, NULL);
+    
+    pthread_t tids[threads > 0 ? threads : 1];
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&tids[t], NULL, portfolioWorker, &pf) == 0) {
+            started++;
+        } else {
+            printf("WARNING: Could only start %d portfolio threads\n", started);
+            break;
+        }
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    pthread_mutex_destroy(&pf.lock);
+    
+    if (pf.bestAttempt == -1) {
+        // No thread could run: fall back to one attempt on this thread
+        seedSchedule(sch, seed);
+        runSolver(sch, ctx->options.solver);
+        pf.stats = sch->stats;
+    }
+    sch->stats = pf.stats;
+    sch->ctx = ctx;
+    sch->verbose = ctx->options.verbose;
+    sch->cancel = NULL;
+    LOG(ctx->options.verbose, LOG_INFO, "Attempt %d won with %d unplaced occurrence(s) after %d completed attempt(s).\n",
+        pf.bestAttempt + 1, sch->unplaced, pf.completed);
+}
+
+// ---------------------------------------------------------------------------
+// Large-neighbourhood search: when a solver leaves required occurrences
+// unplaced, free a region of the timetable and rebuild it together with the
+// missing occurrences. A region is one day across all sections, or every
+// placement of a congested faculty member (one with few free cells who
+// teaches a missing occurrence). It is rebuilt by a small exact search over
+// the start masks, which must put every freed placement back and places as
+// many missing occurrences as it can; a rebuild that keeps everything is
+// always taken, so the search moves on when no region helps.
+//
+// Day regions on different days share no cell, faculty member or room, and
+// a subject meets at most once a day, so every round rebuilds up to
+// options.threads days in parallel on copies of the timetable and merges
+// them all. Each missing occurrence is offered to one of them only. A
+// faculty region spans the week, so its round tries it with different
+// seeds instead and keeps the best rebuild.
+// ---------------------------------------------------------------------------
+
+#define LNS_NODES 2000          // Search nodes for rebuilding one region
+#define LNS_REGION_DAYS 2       // Days freed together, so that classes can change day
+#define LNS_FACULTY_EVERY 4     // Every fourth round frees a faculty member instead of days
+
+// One required occurrence that is missing from the timetable
+typedef struct {
+    int section;
+    int subIdx;
+} RepairItem;
+
+// A region being rebuilt on a worker's copy of the timetable
+typedef struct {
+    Schedule *sch;
+    uint64_t region;        // Cells the rebuilt placements may start in
+    RepairItem *items;      // Freed placements first, then missing occurrences
+    int *freed;             // Start cell of every freed placement
+    int freedCount;
+    int count;
+    unsigned char *state;   // Per item: 0 = open, 1 = placed, 2 = left out
+    int *path;              // Item * MAX_TOTAL_SLOTS + start cell, in placement order
+    int pathLength;
+    int *bestPath;
+    int bestLength;
+    int bestPlaced;         // Missing occurrences on bestPath, -1 if nothing fit
+    long nodes;
+} LnsRegion;
+
+// Take a placement out of the worker's timetable and queue it
+void lnsFree(LnsRegion *r, int section, int cell) {
+    Schedule *sch = r->sch;
+    int subIdx = sch->timetable[section * MAX_TOTAL_SLOTS + cell];
+    r->items[r->count] = (RepairItem){section, subIdx};
+    r->freed[r->count++] = cell;
+    unplaceSubject(sch, subIdx, CELL_DAY(&sch->ctx->grid, cell), CELL_SLOT(&sch->ctx->grid, cell), section);
+}
+
+// Free every placement on a set of days, in all sections
+void lnsFreeDays(LnsRegion *r, unsigned int days) {
+    const Schedule *sch = r->sch;
+    uint64_t cells = sch->ctx->grid.dayCells[days];
+    for (int s = 0; s < sch->ctx->sectionCount; s++) {
+        for (uint64_t busy = sch->sectionBusy[s] & cells & ~sch->pinnedCells[s]; busy; busy &= busy - 1) {
+            int cell = CTZ64(busy);
+            if (sch->timetable[s * MAX_TOTAL_SLOTS + cell] >= 0 && placementStart(sch, s, cell) == cell) {
+                lnsFree(r, s, cell);
+            }
+        }
+    }
+    r->freedCount = r->count;
+    r->region = cells;
+}
+
+// Free every placement of one faculty member, found through the faculty index
+void lnsFreeFaculty(LnsRegion *r, int facultyId) {
+    const Schedule *sch = r->sch;
+    uint64_t taught = sch->facultyBusy[facultyId] & ~sch->ctx->facultyBlocked[facultyId];
+    for (; taught; taught &= taught - 1) {
+        int cell = CTZ64(taught);
+        int s = FACULTY_SECTION(sch, facultyId, cell);
+        if (s >= 0 && !((sch->pinnedCells[s] >> cell) & 1) && placementStart(sch, s, cell) == cell) {
+            lnsFree(r, s, cell);
+        }
+    }
+    r->freedCount = r->count;
+    r->region = sch->ctx->grid.teachingMask;
+}
+
+// Depth-first search over the region's items: the one with the fewest
+// starts first, its starts from a random one on, and a missing occurrence
+// may also be left out. Keeps the path that puts every freed placement back
+// and places the most missing occurrences.
+void lnsSearch(LnsRegion *r, int placed, int open) {
+    Schedule *sch = r->sch;
+    const Grid *grid = &sch->ctx->grid;
+    if (placed + open <= r->bestPlaced || r->nodes >= LNS_NODES) return;
+    r->nodes++;
+    
+    int pick = -1;
+    int pickOptions = MAX_TOTAL_SLOTS + 1;
+    uint64_t pickStarts = 0;
+    for (int i = 0; i < r->count && pickOptions > 0; i++) {
+        if (r->state[i]) continue;
+        uint64_t starts = feasibleStarts(sch, r->items[i].subIdx, r->items[i].section) & r->region;
+        if (POPCOUNT64(starts) < pickOptions) {
+            pick = i;
+            pickOptions = POPCOUNT64(starts);
+            pickStarts = starts;
+        }
+    }
+    if (pick == -1) {
+        // Every item is placed or left out
+        r->bestPlaced = placed;
+        r->bestLength = r->pathLength;
+        memcpy(r->bestPath, r->path, r->pathLength * sizeof(int));
+        return;
+    }
+    int missing = pick >= r->freedCount;
+    if (!missing && pickOptions == 0) return;
+    
+    const RepairItem *item = &r->items[pick];
+    r->state[pick] = 1;
+    uint64_t first = pickStarts;
+    for (int k = pickOptions > 0 ? randomBelow(sch, pickOptions) : 0; k > 0; k--) {
+        first &= first - 1;
+    }
+    uint64_t order[2] = {first, pickStarts & ~first};
+    for (int part = 0; part < 2; part++) {
+        for (uint64_t starts = order[part]; starts; starts &= starts - 1) {
+            int cell = CTZ64(starts);
+            occupySlots(sch, item->subIdx, CELL_DAY(grid, cell), CELL_SLOT(grid, cell), item->section);
+            r->path[r->pathLength++] = pick * MAX_TOTAL_SLOTS + cell;
+            lnsSearch(r, placed + missing, open - missing);
+            r->pathLength--;
+            unplaceSubject(sch, item->subIdx, CELL_DAY(grid, cell), CELL_SLOT(grid, cell), item->section);
+            if (r->nodes >= LNS_NODES || r->bestPlaced == placed + open) break;
+        }
+    }
+    if (missing) {
+        r->state[pick] = 2;
+        lnsSearch(r, placed, open - 1);
+    }
+    r->state[pick] = 0;
+}
+
+void *lnsWorker(void *arg) {
+    LnsRegion *r = arg;
+    r->pathLength = 0;
+    r->bestLength = 0;
+    r->bestPlaced = -1;
+    r->nodes = 0;
+    memset(r->state, 0, r->count);
+    lnsSearch(r, 0, r->count - r->freedCount);
+    return NULL;
+}
+
+// Carry a rebuilt region over to the timetable it was copied from
+void lnsApply(Schedule *sch, const LnsRegion *r) {
+    const Grid *grid = &sch->ctx->grid;
+    for (int i = 0; i < r->freedCount; i++) {
+        int cell = r->freed[i];
+        unplaceSubject(sch, r->items[i].subIdx, CELL_DAY(grid, cell), CELL_SLOT(grid, cell), r->items[i].section);
+    }
+    for (int k = 0; k < r->bestLength; k++) {
+        const RepairItem *item = &r->items[r->bestPath[k] / MAX_TOTAL_SLOTS];
+        int cell = r->bestPath[k] % MAX_TOTAL_SLOTS;
+        placeSubject(sch, item->subIdx, CELL_DAY(grid, cell), CELL_SLOT(grid, cell), item->section,
+                     countSubjectOccurrences(sch, item->subIdx, item->section) + 1);
+    }
+    sch->unplaced -= r->bestPlaced;
+}
+
+// Faculty member of a missing occurrence with the fewest free cells, or -1
+// if the subject has no faculty
+int congestedFaculty(const Schedule *sch, const RepairItem *item) {
+    const Subject *subject = &sch->ctx->subjects[item->subIdx];
+    int best = -1;
+    int bestFree = MAX_TOTAL_SLOTS + 1;
+    for (int f = 0; f < subject->facultyCount; f++) {
+        int id = subject->facultyIds[f];
+        int free = POPCOUNT64(sch->ctx->grid.teachingMask & ~sch->facultyBusy[id]);
+        if (free < bestFree) {
+            best = id;
+            bestFree = free;
+        }
+    }
+    return best;
+}
+
+// Rebuild regions of sch until every required occurrence is placed, the
+// rounds run out or the deadline passes. Uses the context's scratch
+// schedules, one per thread. Returns the occurrences placed.
+int runLns(SchedulerContext *ctx, Schedule *sch, long rounds) {
+    const Subject *subjects = ctx->subjects;
+    const Grid *grid = &ctx->grid;
+    int before = sch->unplaced;
+    int threads = ctx->options.threads < grid->days ? ctx->options.threads : grid->days;
+    threads = prepareWorkers(ctx, threads);
+    if (threads < 1) return 0;
+    
+    size_t maxMissing = 1;
+    for (int subIdx = 0; subIdx < ctx->subjectCount; subIdx++) {
+        maxMissing += (size_t)ctx->sectionCount * subjects[subIdx].occurrences;
+    }
+    size_t maxItems = (size_t)ctx->sectionCount * MAX_TOTAL_SLOTS + maxMissing;
+    RepairItem *missing = malloc(maxMissing * sizeof(RepairItem));
+    LnsRegion *regions = calloc(threads, sizeof(LnsRegion));
+    int failed = !missing || !regions;
+    for (int t = 0; t < threads && !failed; t++) {
+        LnsRegion *r = &regions[t];
+        r->sch = &ctx->workers[t];
+        r->items = malloc(maxItems * sizeof(RepairItem));
+        r->freed = malloc(maxItems * sizeof(int));
+        r->state = malloc(maxItems);
+        r->path = malloc(maxItems * sizeof(int));
+        r->bestPath = malloc(maxItems * sizeof(int));
+        failed = !r->items || !r->freed || !r->state || !r->path || !r->bestPath;
+    }
+    
+    int perRegion = LNS_REGION_DAYS < grid->days ? LNS_REGION_DAYS : grid->days;
+    long round = 0;
+    for (; !failed && round < rounds && sch->unplaced > 0 && !outOfTime(sch); round++) {
+        int missingCount = 0;
+        for (int s = 0; s < ctx->sectionCount; s++) {
+            for (int subIdx = 0; subIdx < ctx->subjectCount; subIdx++) {
+                if (subjects[subIdx].section_specific && subjects[subIdx].target_section != s) continue;
+                for (int k = countSubjectOccurrences(sch, subIdx, s); k < subjects[subIdx].occurrences; k++) {
+                    missing[missingCount++] = (RepairItem){s, subIdx};
+                }
+            }
+        }
+        
+        if (missingCount == 0) break;
+        
+        int faculty = -1;
+        if (round % LNS_FACULTY_EVERY == LNS_FACULTY_EVERY - 1) {
+            faculty = congestedFaculty(sch, &missing[randomBelow(sch, missingCount)]);
+        }
+        int days[MAX_DAYS];
+        for (int d = 0; d < grid->days; d++) {
+            days[d] = d;
+        }
+        int active = faculty >= 0 || threads < grid->days / perRegion ? threads : grid->days / perRegion;
+        for (int t = 0; t < active; t++) {
+            LnsRegion *r = &regions[t];
+            scheduleCopy(r->sch, sch);
+            seedSchedule(r->sch, nextRandom(sch));
+            memset(&r->sch->stats, 0, sizeof(SolveStats));
+            r->sch->verbose = LOG_SILENT;
+            r->count = 0;
+            if (faculty >= 0) {
+                lnsFreeFaculty(r, faculty);
+                memcpy(r->items + r->count, missing, missingCount * sizeof(RepairItem));
+                r->count += missingCount;
+            } else {
+                // Different random days for every thread
+                unsigned int region = 0;
+                for (int k = t * perRegion; k < (t + 1) * perRegion; k++) {
+                    int pick = k + randomBelow(sch, grid->days - k);
+                    int day = days[pick];
+                    days[pick] = days[k];
+                    days[k] = day;
+                    region |= 1 << day;
+                }
+                lnsFreeDays(r, region);
+            }
+        }
+        if (faculty < 0) {
+            // Offer each missing occurrence to one region with a day on
+            // which its subject does not meet the section yet
+            for (int i = 0; i < missingCount; i++) {
+                uint64_t met = grid->dayCells[SUBJECT_DAYS(sch, missing[i].section, missing[i].subIdx)];
+                int target = -1;
+                int eligible = 0;
+                for (int t = 0; t < active; t++) {
+                    uint64_t cells = regions[t].region;
+                    if (countDays(grid, cells) > countDays(grid, cells & met) && randomBelow(sch, ++eligible) == 0) {
+                        target = t;
+                    }
+                }
+                if (target >= 0) regions[target].items[regions[target].count++] = missing[i];
+            }
+        }
+        
+        pthread_t tids[active];
+        int started = 1;
+        while (started < active && pthread_create(&tids[started], NULL, lnsWorker, &regions[started]) == 0) {
+            started++;
+        }
+        for (int t = started; t < active; t++) {
+            lnsWorker(&regions[t]); // No thread for it, run it here
+        }
+        lnsWorker(&regions[0]);
+        for (int t = 1; t < started; t++) {
+            pthread_join(tids[t], NULL);
+        }
+        
+        // Disjoint days are all merged; of the rebuilds of one faculty
+        // member's week only the best
+        int best = -1;
+        for (int t = 0; t < active; t++) {
+            addStats(&sch->stats, &regions[t].sch->stats);
+            if (regions[t].bestPlaced < 0) continue;
+            if (faculty < 0) {
+                lnsApply(sch, &regions[t]);
+            } else if (best == -1 || regions[t].bestPlaced > regions[best].bestPlaced) {
+                best = t;
+            }
+        }
+        if (best >= 0) lnsApply(sch, &regions[best]);
+        LOG(sch->verbose, LOG_DEBUG, "LNS round %ld (%s): %d unplaced\n", round + 1,
+            faculty >= 0 ? ctx->allFaculties[faculty] : "days", sch->unplaced);
+    }
+    
+    for (int t = 0; regions && t < threads; t++) {
+        free(regions[t].items);
+        free(regions[t].freed);
+        free(regions[t].state);
+        free(regions[t].path);
+        free(regions[t].bestPath);
+    }
+    free(regions);
+    free(missing);
+    if (failed) {
+        printf("ERROR: Out of memory for the neighbourhood search\n");
+        return 0;
+    }
+    LOG(sch->verbose, LOG_INFO, "Neighbourhood search placed %d of %d missing occurrence(s) in %ld round(s).\n",
+        before - sch->unplaced, before, round);
+    return before - sch->unplaced;
+}
+
+// ---------------------------------------------------------------------------
+// Anytime solving: within a wall-clock budget, ctx->schedule always holds the
+// best timetable found so far (fewest unplaced occurrences, then lowest soft
+// cost). Seeded construction attempts run until one places every occurrence,
+// and the rest of the budget goes to annealing rounds on the best timetable.
+// The first attempt is always a greedy pass, so an answer exists after a few
+// milliseconds even when the backtracking solver is selected.
+// ---------------------------------------------------------------------------
+
+// Check if a timetable beats the best one so far
+int betterSchedule(const Schedule *sch, long cost, const Schedule *best, long bestCost) {
+    return sch->unplaced < best->unplaced || (sch->unplaced == best->unplaced && cost < bestCost);
+}
+
+// Call the progress callback when the interval has passed, and always on
+// the last call. Returns nonzero when the callback asked to stop.
+int reportProgress(SchedulerContext *ctx, SchedulerProgress *progress, double started,
+                   double *lastReport, int done) {
+    double now = wallClockSeconds();
+    if (!ctx->progress || (!done && now - *lastReport < ctx->progressInterval)) return 0;
+    *lastReport = now;
+    progress->elapsed = now - started;
+    progress->done = done;
+    int stop = ctx->progress(progress, ctx->progressData);
+    progress->improved = 0;
+    return stop;
+}
+
+void runAnytime(SchedulerContext *ctx, uint64_t seed) {
+    Schedule *best = ctx->schedule;
+    const SolverOptions *options = &ctx->options;
+    double started = wallClockSeconds();
+    double deadline = started + options->anytime;
+    double lastReport = started;
+    
+    Schedule work = {0};
+    if (scheduleInit(&work, ctx) != 0) {
+        printf("ERROR: Out of memory for the anytime solver\n");
+        seedSchedule(best, seed);
+        runSolver(best, SOLVER_GREEDY);
+        fillFreeSlots(best);
+        return;
+    }
+    work.ctx = ctx;
+    work.verbose = LOG_SILENT;
+    work.deadline = deadline;
+    best->deadline = deadline;
+    
+    SolveStats total;
+    memset(&total, 0, sizeof(total));
+    SchedulerProgress progress;
+    memset(&progress, 0, sizeof(progress));
+    long bestCost = 0;
+    int constructing = 1;
+    int stopped = 0;
+    double solveSeconds = 0, fillSeconds = 0, optimizeSeconds = 0;
+    
+    for (int attempt = 0; !stopped && (attempt == 0 || wallClockSeconds() < deadline); ) {
+        double phaseStart = wallClockSeconds();
+        if (constructing) {
+            // Another seeded attempt; the node limit is shared by all of them
+            int solver = attempt == 0 ? SOLVER_GREEDY : options->solver;
+            seedSchedule(&work, seed + attempt);
+            memset(&work.stats, 0, sizeof(SolveStats));
+            work.nodeLimit = options->maxNodes - total.nodes;
+            runSolver(&work, solver);
+            if (work.unplaced > 0 && work.status != SOLVE_INFEASIBLE && options->lnsRounds > 0) {
+                runLns(ctx, &work, options->lnsRounds);
+                if (work.unplaced == 0) work.status = SOLVE_FEASIBLE;
+            }
+            double filled = wallClockSeconds();
+            solveSeconds += filled - phaseStart;
+            fillFreeSlots(&work);
+            fillSeconds += wallClockSeconds() - filled;
+            addStats(&total, &work.stats);
+            attempt++;
+            progress.attempts = attempt;
+            progress.nodes = total.nodes;
+            
+            long cost = softCost(&work);
+            if (attempt == 1 || betterSchedule(&work, cost, best, bestCost)) {
+                scheduleCopy(best, &work);
+                bestCost = cost;
+                progress.unplaced = best->unplaced;
+                progress.softCost = cost;
+                progress.improved = 1;
+                LOG(options->verbose, LOG_INFO, "Attempt %d: %d unplaced, soft cost %ld\n",
+                    attempt, best->unplaced, cost);
+            }
+            // Stop constructing once nothing is missing or the backtracking
+            // solver has proven that something must be
+            if (best->unplaced == 0 || (solver != SOLVER_GREEDY &&
+                (work.status == SOLVE_INFEASIBLE || total.nodes >= options->maxNodes))) {
+                constructing = 0;
+            }
+        } else if (options->optimizeMoves > 0) {
+            // One annealing round on the best timetable; it only ever keeps improvements
+            memset(&best->stats, 0, sizeof(SolveStats));
+            optimizeSchedule(best, options->optimizeMoves);
+            addStats(&total, &best->stats);
+            optimizeSeconds += wallClockSeconds() - phaseStart;
+            long cost = softCost(best);
+            if (cost < bestCost) {
+                bestCost = cost;
+                progress.softCost = cost;
+                progress.improved = 1;
+            }
+        } else {
+            break;
+        }
+        stopped = reportProgress(ctx, &progress, started, &lastReport, 0);
+    }
+    
+    best->stats = total;
+    best->deadline = 0;
+    best->nodeLimit = 0;
+    best->verbose = options->verbose;
+    ctx->phaseSeconds[PHASE_SOLVE] = solveSeconds;
+    ctx->phaseSeconds[PHASE_FILL] = fillSeconds;
+    ctx->phaseSeconds[PHASE_OPTIMIZE] = optimizeSeconds;
+    scheduleRelease(&work);
+    
+    LOG(options->verbose, LOG_INFO, "Anytime search: %d attempt(s), %d unplaced, soft cost %ld after %.3fs\n",
+        progress.attempts, best->unplaced, bestCost, wallClockSeconds() - started);
+    reportProgress(ctx, &progress, started, &lastReport, 1);
+}
+
+// Generate timetable with the selected solver, then fill the free slots
+void generateTimetable(SchedulerContext *ctx) {
+    Schedule *sch = ctx->schedule;
+    int verbose = ctx->options.verbose;
+    LOG(verbose, LOG_INFO, "Starting timetable generation...\n");
+    
+    // Seed the random number generator for shuffling; the seed is printed
+    // so that a run seeded from the clock can be repeated with --seed
+    uint64_t seed = ctx->options.seed ? ctx->options.seed : (uint64_t)time(NULL);
+    ctx->seed = seed;
+    LOG(verbose, LOG_INFO, "Random seed: %llu\n", (unsigned long long)seed);
+    
+    sch->ctx = ctx;
+    memset(&sch->stats, 0, sizeof(SolveStats));
+    sch->verbose = verbose;
+    sch->cancel = NULL;
+    ctx->phaseSeconds[PHASE_REPAIR] = 0;
+    if (ctx->decisionLogFile) openDecisionLog(sch, ctx->decisionLogFile, seed, ctx->options.solver);
+    if (ctx->options.anytime > 0) {
+        runAnytime(ctx, seed);
+        closeDecisionLog(sch, ctx->decisionLogFile);
+        LOG(verbose, LOG_INFO, "Timetable generation completed.\n");
+        return;
+    }
+    double started = wallClockSeconds();
+    if (ctx->options.threads > 1) {
+        runPortfolio(ctx, seed);
+    } else {
+        seedSchedule(sch, seed);
+        runSolver(sch, ctx->options.solver);
+    }
+    ctx->phaseSeconds[PHASE_SOLVE] = wallClockSeconds() - started;
+    
+    if (sch->unplaced > 0 && sch->status != SOLVE_INFEASIBLE && ctx->options.lnsRounds > 0) {
+        started = wallClockSeconds();
+        runLns(ctx, sch, ctx->options.lnsRounds);
+        ctx->phaseSeconds[PHASE_REPAIR] = wallClockSeconds() - started;
+        if (sch->unplaced == 0) sch->status = SOLVE_FEASIBLE;
+    }
+    if (sch->unplaced > 0) {
+        LOG(verbose, LOG_QUIET, "WARNING: %d required occurrence(s) could not be placed.\n", sch->unplaced);
+    }
+    
+    started = wallClockSeconds();
+    fillFreeSlots(sch);
+    ctx->phaseSeconds[PHASE_FILL] = wallClockSeconds() - started;
+    
+    ctx->phaseSeconds[PHASE_OPTIMIZE] = 0;
+    if (ctx->options.optimizeMoves > 0) {
+        long before = softCost(sch);
+        started = wallClockSeconds();
+        long accepted = optimizeSchedule(sch, ctx->options.optimizeMoves);
+        double elapsed = wallClockSeconds() - started;
+        ctx->phaseSeconds[PHASE_OPTIMIZE] = elapsed;
+        LOG(verbose, LOG_INFO, "Local search: soft cost %ld -> %ld (%ld of %ld moves accepted, %.0f moves/s)\n",
+            before, softCost(sch), accepted, ctx->options.optimizeMoves,
+            elapsed > 0 ? ctx->options.optimizeMoves / elapsed : 0.0);
+    }
+    closeDecisionLog(sch, ctx->decisionLogFile);
+    
+    LOG(verbose, LOG_INFO, "Timetable generation completed.\n");
+}
+
+// ---------------------------------------------------------------------------
+// Incremental repair: load a previous solution for edited input, keep every
+// placement that is still valid and re-place only what the edit broke. A
+// missing occurrence goes into a free cell when there is one; otherwise a
+// min-conflicts step moves the fewest placements out of its way and queues
+// them for re-placement.
+// ---------------------------------------------------------------------------
+
+#define REPAIR_MAX_BLOCKERS 4   // Never move more placements than this for one occurrence
+#define REPAIR_TABU 8           // Steps during which a new placement stays put
+#define REPAIR_STEPS_PER_GAP 200
+
+// Add a placement (section * MAX_TOTAL_SLOTS + start cell) once
+int addBlocker(int *blockers, int count, int placement) {
+    for (int i = 0; i < count; i++) {
+        if (blockers[i] == placement) return count;
+    }
+    if (count <= REPAIR_MAX_BLOCKERS) blockers[count] = placement;
+    return count + 1;
+}
+
+// Collect the placements that keep subIdx from starting at cell in a section.
+// Returns how many there are, -1 if the cell cannot be used at all (blackout,
+// a pin, no room left, or the subject already meets that day), or -2 if a
+// blocker was placed in the last REPAIR_TABU steps and must stay for now.
+int findBlockers(const Schedule *sch, int subIdx, int section, int cell,
+                 const int *stamp, int step, int *blockers) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subject = &ctx->subjects[subIdx];
+    uint64_t block = subjectBlock(subject, cell);
+    
+    if (SUBJECT_DAYS(sch, section, subIdx) & (1 << CELL_DAY(&ctx->grid, cell))) return -1;
+    
+    uint64_t facultyBusy = 0;
+    for (int f = 0; f < subject->facultyCount; f++) {
+        int id = subject->facultyIds[f];
+        if (ctx->facultyBlocked[id] & block) return -1;
+        facultyBusy |= sch->facultyBusy[id];
+    }
+    
+    int count = 0;
+    for (uint64_t cells = block; cells; cells &= cells - 1) {
+        int c = CTZ64(cells);
+        if ((sch->pinnedCells[section] >> c) & 1) return -1;
+        if (sch->timetable[section * MAX_TOTAL_SLOTS + c] >= 0) {
+            count = addBlocker(blockers, count, section * MAX_TOTAL_SLOTS + placementStart(sch, section, c));
+        }
+        if (!((facultyBusy >> c) & 1)) continue;
+        
+        // Some other section is taught by one of the faculty in this cell
+        for (int s = 0; s < ctx->sectionCount; s++) {
+            int other = sch->timetable[s * MAX_TOTAL_SLOTS + c];
+            if (s != section && other >= 0 && ctx->sharesFaculty[subIdx * ctx->subjectCount + other]) {
+                if ((sch->pinnedCells[s] >> c) & 1) return -1;
+                count = addBlocker(blockers, count, s * MAX_TOTAL_SLOTS + placementStart(sch, s, c));
+            }
+        }
+    }
+    
+    // Moving the blockers must also leave one room of the type free throughout
+    int type = subject->roomType;
+    if (ctx->roomTypeCount[type] > 0 && count <= REPAIR_MAX_BLOCKERS) {
+        uint64_t rooms = ~0ULL;
+        for (uint64_t cells = block; cells; cells &= cells - 1) {
+            int c = CTZ64(cells);
+            uint64_t freeRooms = sch->roomFree[type][c];
+            for (int i = 0; i < count; i++) {
+                int start = blockers[i] % MAX_TOTAL_SLOTS;
+                int room = sch->roomOf[blockers[i]];
+                int length = ctx->subjects[sch->timetable[blockers[i]]].duration;
+                if (room >= 0 && ctx->rooms[room].type == type && c >= start && c < start + length) {
+                    freeRooms |= 1ULL << ctx->rooms[room].bit;
+                }
+            }
+            rooms &= freeRooms;
+        }
+        if (!rooms) return -1;
+    }
+    
+    for (int i = 0; i < count && i <= REPAIR_MAX_BLOCKERS; i++) {
+        if (stamp[blockers[i]] + REPAIR_TABU > step) return -2;
+    }
+    return count;
+}
+
+// Re-place every missing required occurrence, disturbing as little as
+// possible. Returns the number of placements that had to move.
+int repairSchedule(Schedule *sch) {
+    const SchedulerContext *ctx = sch->ctx;
+    const Subject *subjects = ctx->subjects;
+    int subjectCount = ctx->subjectCount;
+    int sectionCount = ctx->sectionCount;
+    
+    // Every required occurrence could end up in the queue at once
+    size_t maxItems = 1;
+    for (int subIdx = 0; subIdx < subjectCount; subIdx++) {
+        maxItems += (size_t)sectionCount * subjects[subIdx].occurrences;
+    }
+    RepairItem *pending = malloc(maxItems * sizeof(RepairItem));
+    int *stamp = malloc((size_t)sectionCount * MAX_TOTAL_SLOTS * sizeof(int));
+    Schedule best = {0};
+    if (!pending || !stamp) {
+        free(pending);
+        free(stamp);
+        return 0;
+    }
+    for (int i = 0; i < sectionCount * MAX_TOTAL_SLOTS; i++) {
+        stamp[i] = -REPAIR_TABU;
+    }
+    
+    int pendingCount = 0;
+    for (int s = 0; s < sectionCount; s++) {
+        for (int subIdx = 0; subIdx < subjectCount; subIdx++) {
+            if (subjects[subIdx].section_specific && subjects[subIdx].target_section != s) continue;
+            for (int k = countSubjectOccurrences(sch, subIdx, s); k < subjects[subIdx].occurrences; k++) {
+                pending[pendingCount++] = (RepairItem){s, subIdx};
+            }
+        }
+    }
+    
+    int failed = 0;
+    int moved = 0;
+    int bestGap = pendingCount;
+    int maxSteps = REPAIR_STEPS_PER_GAP * pendingCount;
+    if (pendingCount > 0 && scheduleCopy(&best, sch) != 0) {
+        maxSteps = 0; // No memory to keep a fallback, leave the schedule alone
+    }
+    
+    for (int step = 0; pendingCount > 0 && step < maxSteps && !isCancelled(sch); step++) {
+        // Most constrained occurrence first
+        int pick = 0;
+        int pickOptions = MAX_TOTAL_SLOTS + 1;
+        for (int i = 0; i < pendingCount && pickOptions > 0; i++) {
+            int options = POPCOUNT64(feasibleStarts(sch, pending[i].subIdx, pending[i].section));
+            if (options < pickOptions) {
+                pick = i;
+                pickOptions = options;
+            }
+        }
+        RepairItem item = pending[pick];
+        pending[pick] = pending[--pendingCount];
+        const Subject *subject = &subjects[item.subIdx];
+        
+        int cell = -1;
+        int blockers[REPAIR_MAX_BLOCKERS + 1];
+        int blockerCount = 0;
+        int waiting = 0;
+        uint64_t candidates = feasibleStarts(sch, item.subIdx, item.section);
+        if (candidates) {
+            int k = randomBelow(sch, POPCOUNT64(candidates));
+            for (; k > 0; k--) candidates &= candidates - 1;
+            cell = CTZ64(candidates);
+        } else if (!subject->section_specific || subject->target_section == item.section) {
+            // Pick the start that displaces the fewest placements (random tie-break)
+            uint64_t starts = sch->ctx->grid.startMask[subject->duration];
+            int ties = 0;
+            for (; starts; starts &= starts - 1) {
+                int c = CTZ64(starts);
+                int found[REPAIR_MAX_BLOCKERS + 1];
+                int count = findBlockers(sch, item.subIdx, item.section, c, stamp, step, found);
+                if (count == -2) waiting = 1;
+                if (count < 0 || count > REPAIR_MAX_BLOCKERS) continue;
+                if (cell == -1 || count < blockerCount) {
+                    ties = 1;
+                } else if (count > blockerCount || randomBelow(sch, ++ties) != 0) {
+                    continue;
+                }
+                cell = c;
+                blockerCount = count;
+                memcpy(blockers, found, count * sizeof(int));
+            }
+        }
+        
+        if (cell == -1 && waiting) {
+            pending[pendingCount++] = item; // Retry once the tabu expires
+            continue;
+        }
+        if (cell == -1) {
+            failed++;
+            LOG(sch->verbose, LOG_QUIET, "WARNING: Could not repair subject: %s for section %d\n",
+                subject->name, item.section + 1);
+            continue;
+        }
+        
+        // Move the blockers out and queue them for re-placement
+        for (int i = 0; i < blockerCount; i++) {
+            int s = blockers[i] / MAX_TOTAL_SLOTS;
+            int c = blockers[i] % MAX_TOTAL_SLOTS;
+            int subIdx = sch->timetable[blockers[i]];
+            unplaceSubject(sch, subIdx, CELL_DAY(&sch->ctx->grid, c), CELL_SLOT(&sch->ctx->grid, c), s);
+            if (countSubjectOccurrences(sch, subIdx, s) < subjects[subIdx].occurrences) {
+                pending[pendingCount++] = (RepairItem){s, subIdx};
+            }
+            moved++;
+        }
+        
+        placeSubject(sch, item.subIdx, CELL_DAY(&sch->ctx->grid, cell), CELL_SLOT(&sch->ctx->grid, cell),
+                     item.section, countSubjectOccurrences(sch, item.subIdx, item.section) + 1);
+        stamp[item.section * MAX_TOTAL_SLOTS + cell] = step;
+        
+        if (pendingCount + failed < bestGap) {
+            bestGap = pendingCount + failed;
+            scheduleCopy(&best, sch);
+        }
+    }
+    
+    // A walk that ran out of steps may have ended worse than it started
+    if (pendingCount + failed > bestGap) {
+        scheduleCopy(sch, &best);
+    }
+    sch->unplaced = bestGap;
+    
+    scheduleRelease(&best);
+    free(pending);
+    free(stamp);
+    return moved;
+}
+
+// Write one line per placed occurrence: section,day,slot,subject
+void writeSolution(const Schedule *sch, FILE *fp) {
+    const SchedulerContext *ctx = sch->ctx;
+    fprintf(fp, "section,day,slot,subject\n");
+    for (int s = 0; s < ctx->sectionCount; s++) {
+        for (int cell = 0; cell < MAX_TOTAL_SLOTS; cell++) {
+            int subIdx = sch->timetable[s * MAX_TOTAL_SLOTS + cell];
+            if (subIdx >= 0 && placementStart(sch, s, cell) == cell) {
+                fprintf(fp, "%s,%s,%d,%s\n", ctx->sectionNames[s], ctx->grid.dayNames[CELL_DAY(&ctx->grid, cell)],
+                        CELL_SLOT(&ctx->grid, cell) + 1, ctx->subjects[subIdx].name);
+            }
+        }
+    }
+}
+
+int saveSolution(const Schedule *sch, const char *filename) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        printf("Error writing to file %s\n", filename);
+        return -1;
+    }
+    writeSolution(sch, fp);
+    fclose(fp);
+    return 0;
+}
+
+// Subject names hashed the same way as faculty names, for reading solutions
+typedef struct {
+    int *slots;     // Subject index per bucket, -1 if empty
+    int size;       // Power of two, at least twice the subject count
+} SubjectHash;
+
+int buildSubjectHash(const SchedulerContext *ctx, SubjectHash *hash) {
+    hash->size = 16;
+    while (hash->size < 2 * ctx->subjectCount) hash->size *= 2;
+    hash->slots = malloc(hash->size * sizeof(int));
+    if (!hash->slots) return -1;
+    for (int i = 0; i < hash->size; i++) hash->slots[i] = -1;
+    for (int subIdx = 0; subIdx < ctx->subjectCount; subIdx++) {
+        unsigned int h = hashFacultyName(ctx->subjects[subIdx].name) & (hash->size - 1);
+        while (hash->slots[h] != -1) h = (h + 1) & (hash->size - 1);
+        hash->slots[h] = subIdx;
+    }
+    return 0;
+}
+
+// Index of the subject called name, or -1
+int lookupSubject(const SchedulerContext *ctx, const SubjectHash *hash, const char *name) {
+    for (unsigned int h = hashFacultyName(name) & (hash->size - 1);
+         hash->slots[h] != -1; h = (h + 1) & (hash->size - 1)) {
+        if (strcmp(ctx->subjects[hash->slots[h]].name, name) == 0) return hash->slots[h];
+    }
+    return -1;
+}
+
+// Read a solution written by writeSolution() into a reset schedule. Lines that
+// no longer fit the current input (unknown names, blackouts, clashes, more
+// occurrences than required) are dropped and left for repairSchedule().
+// source only labels the messages. Returns the number of placements kept.
+int readSolution(Schedule *sch, FILE *fp, const char *source) {
+    const SchedulerContext *ctx = sch->ctx;
+    SubjectHash subjectHash;
+    if (buildSubjectHash(ctx, &subjectHash) != 0) return -1;
+    
+    int kept = 0;
+    int dropped = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        char *sectionName = strtok(line, ",");
+        char *dayName = strtok(NULL, ",");
+        char *slotText = strtok(NULL, ",");
+        char *subjectName = strtok(NULL, "\n");
+        if (!sectionName || !dayName || !slotText || !subjectName ||
+            strcmp(sectionName, "section") == 0) {
+            continue;
+        }
+        subjectName = trimName(subjectName);
+        
+        int section = -1;
+        for (int s = 0; s < ctx->sectionCount && section == -1; s++) {
+            if (strcmp(ctx->sectionNames[s], sectionName) == 0) section = s;
+        }
+        int day = -1;
+        for (int d = 0; d < ctx->grid.days && day == -1; d++) {
+            if (strcmp(ctx->grid.dayNames[d], dayName) == 0) day = d;
+        }
+        int slot = atoi(slotText) - 1;
+        int subIdx = lookupSubject(ctx, &subjectHash, subjectName);
+        
+        // The reset schedule already holds the pins
+        if (section != -1 && day != -1 && slot >= 0 && slot < ctx->grid.slotsPerDay &&
+            (sch->pinnedCells[section] >> CELL_INDEX(&ctx->grid, day, slot)) & 1 &&
+            TIMETABLE_AT(sch, section, day, slot) == subIdx) {
+            kept++;
+            continue;
+        }
+        
+        if (section == -1 || day == -1 || slot < 0 || slot >= ctx->grid.slotsPerDay || subIdx == -1 ||
+            countSubjectOccurrences(sch, subIdx, section) >= ctx->subjects[subIdx].occurrences ||
+            !canPlaceSubject(sch, subIdx, day, slot, section)) {
+            LOG(sch->verbose, LOG_DEBUG, "Dropping placement: %s, %s, slot %s, %s\n", sectionName, dayName, slotText, subjectName);
+            dropped++;
+            continue;
+        }
+        
+        occupySlots(sch, subIdx, day, slot, section);
+        if (countSubjectOccurrences(sch, subIdx, section) >= ctx->subjects[subIdx].occurrences) {
+            ASSIGNED(sch, section, subIdx) = 1;
+        }
+        kept++;
+    }
+    
+    free(subjectHash.slots);
+    LOG(sch->verbose, LOG_INFO, "Loaded %d placement(s) from %s, dropped %d\n", kept, source, dropped);
+    return kept;
+}
+
+// Reset the context's schedule to its pins and read a solution into it
+int restoreSolution(SchedulerContext *ctx, FILE *fp, const char *source) {
+    Schedule *sch = ctx->schedule;
+    if (scheduleInit(sch, ctx) != 0) {
+        printf("ERROR: Out of memory for the timetable\n");
+        return -1;
+    }
+    sch->verbose = ctx->options.verbose;
+    sch->cancel = NULL;
+    clearTimetable(sch);
+    placePins(sch, "WARNING");
+    return readSolution(sch, fp, source);
+}
+
+// ---------------------------------------------------------------------------
+// Verification and diff of saved solutions
+//
+// The verifier trusts nothing the solver built. It reads a solution file and
+// replays it against the input in one pass. Each placement is checked with
+// constant work: the subject is found by a name hash, and the section,
+// faculty and room occupancy are kept as week masks indexed directly by the
+// interned IDs. The diff matches the placements of two files with a hash
+// of whole lines, then pairs what is left by section and subject as moves.
+// Neither needs the input to have been solved.
+// ---------------------------------------------------------------------------
+
+// One placement line of a solution file; fields point into the file's buffer
+typedef struct {
+    char *section;
+    char *day;
+    int slot;         // 1-based as written
+    char *subject;
+    char *room;       // NULL when the file has no room column
+    int line;         // Line number in the file
+} SolutionLine;
+
+// Cut the next CSV field out of *cursor, undoing writerCsvField() quoting.
+// Returns NULL when the line has no more fields.
+char *nextCsvField(char **cursor) {
+    char *field = *cursor;
+    if (!field) return NULL;
+    if (*field != '"') {
+        char *comma = strchr(field, ',');
+        if (comma) *comma = '\0';
+        *cursor = comma ? comma + 1 : NULL;
+        return field;
+    }
+    
+    char *out = ++field;
+    char *in = field;
+    while (*in && !(in[0] == '"' && in[1] != '"')) {
+        if (*in == '"') in++; // A doubled quote stands for one
+        *out++ = *in++;
+    }
+    if (*in == '"') in++;
+    *out = '\0';
+    *cursor = *in == ',' ? in + 1 : NULL;
+    return field;
+}
+
+// Read the placement lines of a solution file: the --save format, or any
+// CSV whose header names section, day, slot and subject columns (such as
+// timetable.csv, whose room column is read as well). Lines that lack a
+// field keep a NULL section. Returns the number of lines, with *lines in
+// the arena, or -1 if the file cannot be read.
+int readSolutionLines(Arena *arena, const char *filename, SolutionLine **lines) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        printf("Cannot open solution file: %s\n", filename);
+        return -1;
+    }
+    size_t length = 0;
+    char *text = readFileToArena(arena, fp, &length);
+    fclose(fp);
+    int maxLines = 1;
+    for (size_t i = 0; text && i < length; i++) {
+        if (text[i] == '\n') maxLines++;
+    }
+    *lines = text ? arenaAlloc(arena, maxLines * sizeof(SolutionLine)) : NULL;
+    if (!*lines) {
+        printf("ERROR: Could not read solution file %s\n", filename);
+        return -1;
+    }
+    
+    // Column of section, day, slot, subject and room; the --save order by default
+    int columns[5] = {0, 1, 2, 3, -1};
+    int count = 0;
+    int lineNumber = 0;
+    char *next = text;
+    while (*next) {
+        char *line = next;
+        char *newline = strchr(line, '\n');
+        if (newline) {
+            *newline = '\0';
+            next = newline + 1;
+        } else {
+            next = line + strlen(line);
+        }
+        lineNumber++;
+        line[strcspn(line, "\r")] = '\0';
+        if (line[0] == '\0') continue;
+        
+        char *fields[16];
+        int fieldCount = 0;
+        char *cursor = line;
+        while (fieldCount < 16 && (fields[fieldCount] = nextCsvField(&cursor))) {
+            fields[fieldCount] = trimName(fields[fieldCount]);
+            fieldCount++;
+        }
+        if (strcmp(fields[0], "section") == 0) {
+            static const char *names[5] = {"section", "day", "slot", "subject", "room"};
+            for (int c = 0; c < 5; c++) {
+                columns[c] = -1;
+                for (int f = 0; f < fieldCount; f++) {
+                    if (strcmp(fields[f], names[c]) == 0) columns[c] = f;
+                }
+            }
+            continue;
+        }
+        
+        SolutionLine *entry = &(*lines)[count++];
+        entry->line = lineNumber;
+        entry->section = NULL;
+        entry->room = columns[4] >= 0 && columns[4] < fieldCount ? fields[columns[4]] : NULL;
+        int complete = 1;
+        for (int c = 0; c < 4; c++) {
+            if (columns[c] < 0 || columns[c] >= fieldCount) complete = 0;
+        }
+        if (complete) {
+            entry->section = fields[columns[0]];
+            entry->day = fields[columns[1]];
+            entry->slot = atoi(fields[columns[2]]);
+            entry->subject = fields[columns[3]];
+        }
+    }
+    return count;
+}
+
+// Report one broken hard constraint
+void reportViolation(const char *filename, const SolutionLine *line, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    printf("VIOLATION %s:%d: ", filename, line->line);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+}
+
+// Check every hard constraint of a solution file against the loaded input:
+// known names, blocks inside one day's teaching slots, no section, faculty
+// or room clashes, blackouts, section-specific subjects, one meeting a day
+// per subject, room capacity and pins. Placements beyond the required
+// occurrences are allowed (the fill pass adds them); missing ones are
+// counted but are not violations. Returns the number of violations, or -1.
+int verifySolution(const SchedulerContext *ctx, const char *filename) {
+    const Grid *grid = &ctx->grid;
+    Arena arena = {0};
+    SolutionLine *lines;
+    int count = readSolutionLines(&arena, filename, &lines);
+    if (count < 0) {
+        arenaFree(&arena);
+        return -1;
+    }
+    
+    int sections = ctx->sectionCount;
+    int pairs = sections * ctx->subjectCount;
+    SubjectHash subjectHash = {0};
+    int *sectionAt = arenaAlloc(&arena, sections * MAX_TOTAL_SLOTS * sizeof(int));
+    uint64_t *starts = arenaAlloc(&arena, sections * sizeof(uint64_t));
+    uint64_t *facultyBusy = arenaAlloc(&arena, (ctx->totalFaculties + 1) * sizeof(uint64_t));
+    uint64_t *roomBusy = arenaAlloc(&arena, (ctx->roomCount + 1) * sizeof(uint64_t));
+    int *occurrences = arenaAlloc(&arena, (pairs + 1) * sizeof(int));
+    unsigned char *meetDays = arenaAlloc(&arena, pairs + 1);
+    if (!sectionAt || !starts || !facultyBusy || !roomBusy || !occurrences || !meetDays ||
+        buildSubjectHash(ctx, &subjectHash) != 0) {
+        printf("ERROR: Out of memory while verifying %s\n", filename);
+        arenaFree(&arena);
+        return -1;
+    }
+    for (int i = 0; i < sections * MAX_TOTAL_SLOTS; i++) sectionAt[i] = -1;
+    memset(starts, 0, sections * sizeof(uint64_t));
+    memset(facultyBusy, 0, (ctx->totalFaculties + 1) * sizeof(uint64_t));
+    memset(roomBusy, 0, (ctx->roomCount + 1) * sizeof(uint64_t));
+    memset(occurrences, 0, (pairs + 1) * sizeof(int));
+    memset(meetDays, 0, pairs + 1);
+    int roomUse[ROOM_TYPES][MAX_TOTAL_SLOTS] = {{0}};
+    
+    int violations = 0;
+    int placed = 0;
+    for (int i = 0; i < count; i++) {
+        const SolutionLine *line = &lines[i];
+        if (!line->section) {
+            reportViolation(filename, line, "missing fields");
+            violations++;
+            continue;
+        }
+        int section = sectionIndex(line->section);
+        if (section < 0 || section >= sections || strcmp(ctx->sectionNames[section], line->section) != 0) {
+            section = -1;
+        }
+        int day = -1;
+        for (int d = 0; d < grid->days && day == -1; d++) {
+            if (strcmp(grid->dayNames[d], line->day) == 0) day = d;
+        }
+        int subIdx = lookupSubject(ctx, &subjectHash, line->subject);
+        if (section == -1 || day == -1 || subIdx == -1 || line->slot < 1 || line->slot > grid->slotsPerDay) {
+            reportViolation(filename, line, "unknown %s",
+                            section == -1 ? "section" : day == -1 ? "day" : subIdx == -1 ? "subject" : "slot");
+            violations++;
+            continue;
+        }
+        
+        const Subject *subject = &ctx->subjects[subIdx];
+        int cell = CELL_INDEX(grid, day, line->slot - 1);
+        uint64_t block = subjectBlock(subject, cell);
+        int pair = section * ctx->subjectCount + subIdx;
+        if (subject->section_specific && subject->target_section != section) {
+            reportViolation(filename, line, "%s is not taught to %s", subject->name, line->section);
+            violations++;
+        }
+        if (!((grid->startMask[subject->duration] >> cell) & 1)) {
+            reportViolation(filename, line, "%s (%d slots) runs into a break or the end of the day",
+                            subject->name, subject->duration);
+            violations++;
+            block &= grid->dayCells[1 << day];
+        }
+        for (uint64_t cells = block; cells; cells &= cells - 1) {
+            int other = sectionAt[section * MAX_TOTAL_SLOTS + CTZ64(cells)];
+            if (other >= 0) {
+                reportViolation(filename, line, "%s clashes with %s in section %s", subject->name,
+                                ctx->subjects[other].name, line->section);
+                violations++;
+                break;
+            }
+        }
+        for (int f = 0; f < subject->facultyCount; f++) {
+            int id = subject->facultyIds[f];
+            if (facultyBusy[id] & block) {
+                reportViolation(filename, line, "%s is teaching elsewhere at the same time", ctx->allFaculties[id]);
+                violations++;
+            } else if (ctx->facultyBlocked[id] & block) {
+                reportViolation(filename, line, "%s is unavailable then", ctx->allFaculties[id]);
+                violations++;
+            }
+            facultyBusy[id] |= block;
+        }
+        if ((meetDays[pair] >> day) & 1) {
+            reportViolation(filename, line, "%s meets %s twice on %s", subject->name, line->section, line->day);
+            violations++;
+        }
+        
+        // Rooms of a type are interchangeable, so the room count per cell is
+        // enough; a room column is checked name by name as well
+        if (ctx->roomTypeCount[subject->roomType] > 0) {
+            for (uint64_t cells = block; cells; cells &= cells - 1) {
+                if (++roomUse[subject->roomType][CTZ64(cells)] == ctx->roomTypeCount[subject->roomType] + 1) {
+                    reportViolation(filename, line, "more %s classes than %s rooms on %s slot %d",
+                                    roomTypeNames[subject->roomType], roomTypeNames[subject->roomType],
+                                    line->day, CELL_SLOT(grid, CTZ64(cells)) + 1);
+                    violations++;
+                }
+            }
+        }
+        if (line->room && line->room[0]) {
+            int room = -1;
+            for (int r = 0; r < ctx->roomCount && room == -1; r++) { // A few dozen rooms at most
+                if (strcmp(ctx->rooms[r].name, line->room) == 0) room = r;
+            }
+            if (room == -1 || ctx->rooms[room].type != subject->roomType) {
+                reportViolation(filename, line, "%s is not a %s room", line->room, roomTypeNames[subject->roomType]);
+                violations++;
+            } else if (roomBusy[room] & block) {
+                reportViolation(filename, line, "room %s is booked twice", line->room);
+                violations++;
+            }
+            if (room != -1) roomBusy[room] |= block;
+        }
+        
+        for (uint64_t cells = block; cells; cells &= cells - 1) {
+            sectionAt[section * MAX_TOTAL_SLOTS + CTZ64(cells)] = subIdx;
+        }
+        starts[section] |= 1ULL << cell;
+        meetDays[pair] |= 1 << day;
+        occurrences[pair]++;
+        placed++;
+    }
+    
+    for (int i = 0; i < ctx->pinCount; i++) {
+        const Pin *pin = &ctx->pins[i];
+        if (pin->section < sections && (sectionAt[pin->section * MAX_TOTAL_SLOTS + pin->cell] != pin->subIdx ||
+                                         !((starts[pin->section] >> pin->cell) & 1))) {
+            printf("VIOLATION %s: pinned %s for %s on %s slot %d is missing\n", filename,
+                   ctx->subjects[pin->subIdx].name, ctx->sectionNames[pin->section],
+                   grid->dayNames[CELL_DAY(grid, pin->cell)], CELL_SLOT(grid, pin->cell) + 1);
+            violations++;
+        }
+    }
+    int missing = 0;
+    for (int s = 0; s < sections; s++) {
+        for (int subIdx = 0; subIdx < ctx->subjectCount; subIdx++) {
+            const Subject *subject = &ctx->subjects[subIdx];
+            int placed = occurrences[s * ctx->subjectCount + subIdx];
+            if ((!subject->section_specific || subject->target_section == s) && placed < subject->occurrences) {
+                missing += subject->occurrences - placed;
+            }
+        }
+    }
+    
+    printf("%s: %d placement(s), %d violation(s), %d required occurrence(s) missing\n",
+           filename, placed, violations, missing);
+    free(subjectHash.slots);
+    arenaFree(&arena);
+    return violations;
+}
+
+// Hash of the fields that identify a placement; withCell adds day and slot
+unsigned int hashPlacement(const SolutionLine *line, int withCell) {
+    unsigned int h = hashFacultyName(line->section) * 31u + hashFacultyName(line->subject);
+    if (withCell) h = (h * 31u + hashFacultyName(line->day)) * 31u + (unsigned int)line->slot;
+    return h;
+}
+
+int samePlacement(const SolutionLine *a, const SolutionLine *b, int withCell) {
+    return strcmp(a->section, b->section) == 0 && strcmp(a->subject, b->subject) == 0 &&
+           (!withCell || (a->slot == b->slot && strcmp(a->day, b->day) == 0));
+}
+
+// Print the placements that differ between two solution files: the ones
+// that moved (same section and subject, another cell), then the ones only
+// the old or only the new file has. Returns the number of differences, or
+// -1 if a file cannot be read.
+int diffSolutions(const char *oldFile, const char *newFile) {
+    Arena arena = {0};
+    SolutionLine *before;
+    SolutionLine *after;
+    int beforeCount = readSolutionLines(&arena, oldFile, &before);
+    int afterCount = beforeCount < 0 ? -1 : readSolutionLines(&arena, newFile, &after);
+    if (afterCount < 0) {
+        arenaFree(&arena);
+        return -1;
+    }
+    
+    int hashSize = 16;
+    while (hashSize < 2 * beforeCount) hashSize *= 2;
+    int *hash = arenaAlloc(&arena, hashSize * sizeof(int));
+    unsigned char *matched = arenaAlloc(&arena, beforeCount + afterCount + 1);
+    if (!hash || !matched) {
+        printf("ERROR: Out of memory while comparing %s and %s\n", oldFile, newFile);
+        arenaFree(&arena);
+        return -1;
+    }
+    memset(matched, 0, beforeCount + afterCount + 1);
+    unsigned char *afterMatched = matched + beforeCount;
+    for (int i = 0; i < beforeCount + afterCount; i++) {
+        const SolutionLine *line = i < beforeCount ? &before[i] : &after[i - beforeCount];
+        if (!line->section) {
+            printf("Warning: Ignoring %s:%d (missing fields)\n", i < beforeCount ? oldFile : newFile, line->line);
+            matched[i] = 1;
+        }
+    }
+    
+    // Pass 1 pairs identical placements, pass 2 pairs the rest by section
+    // and subject; the old file's unmatched lines are hashed for each pass
+    int unchanged = 0;
+    int moved = 0;
+    for (int withCell = 1; withCell >= 0; withCell--) {
+        for (int i = 0; i < hashSize; i++) hash[i] = -1;
+        for (int i = 0; i < beforeCount; i++) {
+            if (matched[i]) continue;
+            unsigned int h = hashPlacement(&before[i], withCell) & (hashSize - 1);
+            while (hash[h] != -1) h = (h + 1) & (hashSize - 1);
+            hash[h] = i;
+        }
+        for (int i = 0; i < afterCount; i++) {
+            if (afterMatched[i]) continue;
+            for (unsigned int h = hashPlacement(&after[i], withCell) & (hashSize - 1);
+                 hash[h] != -1; h = (h + 1) & (hashSize - 1)) {
+                const SolutionLine *old = &before[hash[h]];
+                if (matched[hash[h]] || !samePlacement(old, &after[i], withCell)) continue;
+                matched[hash[h]] = 1;
+                afterMatched[i] = 1;
+                if (withCell) {
+                    unchanged++;
+                } else {
+                    printf("moved   %s,%s: %s %d -> %s %d\n", after[i].section, after[i].subject,
+                           old->day, old->slot, after[i].day, after[i].slot);
+                    moved++;
+                }
+                break;
+            }
+        }
+    }
+    
+    int removed = 0;
+    int added = 0;
+    for (int i = 0; i < beforeCount; i++) {
+        if (matched[i]) continue;
+        printf("removed %s,%s: %s %d\n", before[i].section, before[i].subject, before[i].day, before[i].slot);
+        removed++;
+    }
+    for (int i = 0; i < afterCount; i++) {
+        if (afterMatched[i]) continue;
+        printf("added   %s,%s: %s %d\n", after[i].section, after[i].subject, after[i].day, after[i].slot);
+        added++;
+    }
+    printf("%d unchanged, %d moved, %d removed, %d added\n", unchanged, moved, removed, added);
+    arenaFree(&arena);
+    return moved + removed + added;
+}
+
+// ---------------------------------------------------------------------------
+// Decision log replay: rebuild a schedule from the records logDecision()
+// wrote for the same input. Every record is checked against the rebuilt
+// state: a placement must fit, a removal must find its occurrence and a
+// rejection must be rejected again for the same reason. A log replayed on
+// other input, or on a build whose constraints changed, therefore stops at
+// the first record that diverges instead of producing a wrong timetable.
+// ---------------------------------------------------------------------------
+
+// Read one LEB128 varint; returns 0, or -1 at the end of the file or for a
+// value that does not fit 64 bits
+int readVarint(FILE *fp, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(fp);
+        if (c == EOF) return -1;
+        *value |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+// Read count varints, each of which must be below its limit
+int readFields(FILE *fp, uint64_t *fields, const uint64_t *limits, int count) {
+    for (int i = 0; i < count; i++) {
+        if (readVarint(fp, &fields[i]) != 0 || fields[i] >= limits[i]) return -1;
+    }
+    return 0;
+}
+
+// Occupy a logged placement after checking that it fits. Like a restored
+// solution, a subject counts as assigned once all its occurrences are placed.
+int replayPlacement(Schedule *sch, int subIdx, int section, int cell) {
+    const SchedulerContext *ctx = sch->ctx;
+    if (!((feasibleStarts(sch, subIdx, section) >> cell) & 1)) return -1;
+    occupySlots(sch, subIdx, CELL_DAY(&ctx->grid, cell), CELL_SLOT(&ctx->grid, cell), section);
+    if (countSubjectOccurrences(sch, subIdx, section) >= ctx->subjects[subIdx].occurrences) {
+        ASSIGNED(sch, section, subIdx) = 1;
+    }
+    return 0;
+}
+
+// Replay the first steps records (all of them if steps < 0) of a decision
+// log into the context's schedule. Returns the number of records replayed,
+// or -1 (with a message) if the log cannot be read or does not match.
+long replayDecisions(SchedulerContext *ctx, const char *filename, long steps) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        printf("Cannot open decision log: %s\n", filename);
+        return -1;
+    }
+    
+    char magic[8];
+    uint64_t header[6]; // Version, seed, solver, sections, subjects, cells
+    int valid = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, DECISION_MAGIC, 8) == 0;
+    for (int i = 0; i < 6 && valid; i++) {
+        valid = readVarint(fp, &header[i]) == 0;
+    }
+    if (!valid || header[0] < 1 || header[0] > DECISION_VERSION) {
+        printf("ERROR: %s is not a decision log of this version\n", filename);
+        fclose(fp);
+        return -1;
+    }
+    if (header[3] != (uint64_t)ctx->sectionCount || header[4] != (uint64_t)ctx->subjectCount ||
+        header[5] != (uint64_t)ctx->grid.cells) {
+        printf("ERROR: %s was written for %llu section(s), %llu subject(s) and %llu cells; "
+               "the input has %d, %d and %d\n", filename, (unsigned long long)header[3],
+               (unsigned long long)header[4], (unsigned long long)header[5],
+               ctx->sectionCount, ctx->subjectCount, ctx->grid.cells);
+        fclose(fp);
+        return -1;
+    }
+    
+    Schedule *sch = ctx->schedule;
+    if (scheduleInit(sch, ctx) != 0) {
+        printf("ERROR: Out of memory for the timetable\n");
+        fclose(fp);
+        return -1;
+    }
+    sch->verbose = ctx->options.verbose;
+    sch->decisions = NULL;
+    memset(&sch->stats, 0, sizeof(SolveStats));
+    clearTimetable(sch);
+    ctx->seed = header[1];
+    
+    const Grid *grid = &ctx->grid;
+    uint64_t limits[4] = {(uint64_t)ctx->sectionCount, (uint64_t)ctx->subjectCount,
+                          (uint64_t)grid->cells + 1, REJECT_REASONS};
+    uint64_t placed[4] = {(uint64_t)ctx->sectionCount, (uint64_t)ctx->subjectCount,
+                          (uint64_t)grid->cells, (uint64_t)ctx->roomCount + 1};
+    uint64_t moved[3] = {(uint64_t)ctx->sectionCount, (uint64_t)ctx->roomCount, (uint64_t)grid->cells};
+    const char *error = NULL;
+    long replayed = 0;
+    int kind;
+    while (!error && (steps < 0 || replayed < steps) && (kind = getc(fp)) != EOF) {
+        uint64_t f[4];
+        if (kind == DECISION_RESET) {
+            resetTimetable(sch);
+            LOG(sch->verbose, LOG_DEBUG, "%ld: reset to the pins\n", replayed + 1);
+        } else if (kind == DECISION_PLACE || kind == DECISION_REMOVE) {
+            if (readFields(fp, f, limits, 3) != 0 || f[2] >= (uint64_t)grid->cells) {
+                error = "malformed record";
+                break;
+            }
+            int section = (int)f[0], subIdx = (int)f[1], cell = (int)f[2];
+            LOG(sch->verbose, LOG_DEBUG, "%ld: %s %s for %s on %s slot %d\n", replayed + 1,
+                kind == DECISION_PLACE ? "place" : "remove", ctx->subjects[subIdx].name,
+                ctx->sectionNames[section], grid->dayNames[CELL_DAY(grid, cell)], CELL_SLOT(grid, cell) + 1);
+            if (kind == DECISION_PLACE) {
+                if (replayPlacement(sch, subIdx, section, cell) != 0) error = "the placement does not fit";
+            } else if (sch->timetable[section * MAX_TOTAL_SLOTS + cell] != subIdx ||
+                       placementStart(sch, section, cell) != cell) {
+                error = "the removed occurrence is not there";
+            } else {
+                unplaceSubject(sch, subIdx, CELL_DAY(grid, cell), CELL_SLOT(grid, cell), section);
+            }
+        } else if (kind == DECISION_REJECT) {
+            if (readFields(fp, f, limits, 4) != 0) {
+                error = "malformed record";
+                break;
+            }
+            int section = (int)f[0], subIdx = (int)f[1], cell = (int)f[2] - 1;
+            int reason = cell >= 0 ? rejectReason(sch, subIdx, section, cell)
+                       : feasibleStarts(sch, subIdx, section) ? REJECT_REASONS : REJECT_NO_START;
+            LOG(sch->verbose, LOG_DEBUG, "%ld: reject %s for %s (%s)\n", replayed + 1,
+                ctx->subjects[subIdx].name, ctx->sectionNames[section], rejectNames[f[3]]);
+            if (reason != (int)f[3]) error = "the rejection does not repeat";
+        } else if (kind == DECISION_CHECKPOINT) {
+            uint64_t count;
+            if (readVarint(fp, &count) != 0) {
+                error = "malformed record";
+                break;
+            }
+            LOG(sch->verbose, LOG_DEBUG, "%ld: checkpoint of %llu placement(s)\n", replayed + 1,
+                (unsigned long long)count);
+            resetTimetable(sch);
+            f[3] = 0;
+            for (uint64_t i = 0; i < count && !error; i++) {
+                // Each placement takes its logged room straight away, which
+                // keeps that room free for it in the later ones
+                if (readFields(fp, f, placed, header[0] >= 2 ? 4 : 3) != 0) {
+                    error = "malformed record";
+                } else if (replayPlacement(sch, (int)f[1], (int)f[0], (int)f[2]) != 0 ||
+                           (f[3] > 0 && moveRoom(sch, (int)f[0], (int)f[2], ctx->rooms[f[3] - 1].bit) != 0)) {
+                    error = "a checkpoint placement does not fit";
+                }
+            }
+        } else if (kind == DECISION_ROOM) {
+            if (readFields(fp, f, moved, 3) != 0) {
+                error = "malformed record";
+                break;
+            }
+            int section = (int)f[0], room = (int)f[1], cell = (int)f[2];
+            int subIdx = sch->timetable[section * MAX_TOTAL_SLOTS + cell];
+            LOG(sch->verbose, LOG_DEBUG, "%ld: move %s for %s on %s slot %d to room %s\n", replayed + 1,
+                subIdx >= 0 ? ctx->subjects[subIdx].name : "-", ctx->sectionNames[section],
+                grid->dayNames[CELL_DAY(grid, cell)], CELL_SLOT(grid, cell) + 1, ctx->rooms[room].name);
+            if (subIdx < 0 || placementStart(sch, section, cell) != cell ||
+                ctx->rooms[room].type != ctx->subjects[subIdx].roomType ||
+                moveRoom(sch, section, cell, ctx->rooms[room].bit) != 0) {
+                error = "the room change does not fit";
+            }
+        } else {
+            error = "unknown record";
+        }
+        if (!error) replayed++;
+    }
+    fclose(fp);
+    if (error) {
+        printf("ERROR: %s, record %ld: %s\n", filename, replayed + 1, error);
+        return -1;
+    }
+    
+    // Count what the rebuilt timetable still lacks
+    sch->unplaced = 0;
+    for (int s = 0; s < ctx->sectionCount; s++) {
+        for (int i = 0; i < ctx->subjectCount; i++) {
+            if (ctx->subjects[i].section_specific && ctx->subjects[i].target_section != s) continue;
+            int missing = ctx->subjects[i].occurrences - countSubjectOccurrences(sch, i, s);
+            if (missing > 0) sch->unplaced += missing;
+        }
+    }
+    sch->status = sch->unplaced > 0 ? SOLVE_INCOMPLETE : SOLVE_FEASIBLE;
+    LOG(sch->verbose, LOG_INFO, "Replayed %ld record(s) of %s (seed %llu); %d required occurrence(s) unplaced\n",
+        replayed, filename, (unsigned long long)ctx->seed, sch->unplaced);
+    return replayed;
+}
+
+// ---------------------------------------------------------------------------
+// Output
+//
+// Every file goes through a Writer that collects text in a large buffer and
+// hands it to stdio in big chunks. Per-faculty schedules are built once from
+// the solution and shared by the text, CSV and JSON writers.
+// ---------------------------------------------------------------------------
+
+#define WRITER_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    FILE *fp;
+    size_t used;
+    int failed;               // A write went wrong; reported by writerClose()
+    char buffer[WRITER_BUFFER_SIZE];
+} Writer;
+
+// Open a buffered writer; "-" writes to stdout
+Writer *writerOpen(const char *filename) {
+    Writer *w = malloc(sizeof(Writer));
+    if (!w) return NULL;
+    w->fp = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "w");
+    if (!w->fp) {
+        printf("Error writing to file %s\n", filename);
+        printf("Check if you have write permissions in this directory.\n");
+        free(w);
+        return NULL;
+    }
+    w->used = 0;
+    w->failed = 0;
+    return w;
+}
+
+void writerFlush(Writer *w) {
+    if (w->used > 0 && fwrite(w->buffer, 1, w->used, w->fp) != w->used) {
+        w->failed = 1;
+    }
+    w->used = 0;
+}
+
+void writerWrite(Writer *w, const char *data, size_t length) {
+    if (length > WRITER_BUFFER_SIZE - w->used) {
+        writerFlush(w);
+        if (length > WRITER_BUFFER_SIZE) {
+            if (fwrite(data, 1, length, w->fp) != length) w->failed = 1;
+            return;
+        }
+    }
+    memcpy(w->buffer + w->used, data, length);
+    w->used += length;
+}
+
+void writerPuts(Writer *w, const char *text) {
+    writerWrite(w, text, strlen(text));
+}
+
+// Same as fprintf(fp, "%-*s", width, text)
+void writerPad(Writer *w, const char *text, int width) {
+    static const char spaces[] = "                                ";
+    size_t length = strlen(text);
+    writerWrite(w, text, length);
+    for (int pad = width - (int)length; pad > 0; pad -= (int)sizeof(spaces) - 1) {
+        writerWrite(w, spaces, pad < (int)sizeof(spaces) - 1 ? (size_t)pad : sizeof(spaces) - 1);
+    }
+}
+
+void writerPrintf(Writer *w, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(w->buffer + w->used, WRITER_BUFFER_SIZE - w->used, format, args);
+    va_end(args);
+    if (length < 0) {
+        w->failed = 1;
+    } else if ((size_t)length < WRITER_BUFFER_SIZE - w->used) {
+        w->used += length;
+    } else {
+        // Did not fit: flush and format straight into the file
+        writerFlush(w);
+        va_start(args, format);
+        if (vfprintf(w->fp, format, args) < 0) w->failed = 1;
+        va_end(args);
+    }
+}
+
+// Write a CSV field, quoted when it contains a separator, quote or newline
+void writerCsvField(Writer *w, const char *text) {
+    if (!strpbrk(text, ",\"\r\n")) {
+        writerPuts(w, text);
+        return;
+    }
+    writerWrite(w, "\"", 1);
+    for (const char *p = text; *p; p++) {
+        if (*p == '"') writerWrite(w, "\"", 1);
+        writerWrite(w, p, 1);
+    }
+    writerWrite(w, "\"", 1);
+}
+
+// Write a JSON string literal
+void writerJsonString(Writer *w, const char *text) {
+    writerWrite(w, "\"", 1);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            char escaped[2] = {'\\', (char)*p};
+            writerWrite(w, escaped, 2);
+        } else if (*p < 0x20) {
+            writerPrintf(w, "\\u%04x", *p);
+        } else {
+            writerWrite(w, (const char *)p, 1);
+        }
+    }
+    writerWrite(w, "\"", 1);
+}
+
+// Open one of the context's output files in its output directory
+Writer *openOutput(const SchedulerContext *ctx, const char *name) {
+    if (!ctx->outputDirectory) return writerOpen(name);
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", ctx->outputDirectory, name);
+    return writerOpen(path);
+}
+
+// Flush and close; returns 0 if everything reached the file
+int writerClose(Writer *w) {
+    writerFlush(w);
+    int failed = w->failed;
+    if ((w->fp == stdout ? fflush(w->fp) : fclose(w->fp)) != 0) failed = 1;
+    free(w);
+    return failed ? -1 : 0;
+}
+
+// One class in a faculty member's week
+typedef struct {
+    int cell;                 // Start cell
+    int section;
+    int subIdx;
+} FacultyClass;
+
+// Classes grouped by faculty, each group in week order (day, slot, section)
+typedef struct {
+    FacultyClass *classes;
+    int *first;               // Classes of faculty f are classes[first[f] .. first[f + 1])
+} FacultySchedule;
+
+// Start cells of a faculty member's classes, read from the reverse index:
+// busy cells that hold a class (not a blackout) which does not continue
+// from the cell before
+uint64_t facultyClassStarts(const Schedule *sch, int facultyId) {
+    uint64_t starts = 0;
+    for (uint64_t busy = sch->facultyBusy[facultyId]; busy; busy &= busy - 1) {
+        int cell = CTZ64(busy);
+        int section = FACULTY_SECTION(sch, facultyId, cell);
+        if (section >= 0 && placementStart(sch, section, cell) == cell) starts |= 1ULL << cell;
+    }
+    return starts;
+}
+
+// Group the solution's classes by faculty. Each faculty member's classes
+// come straight from the reverse index in week order, so the cost is one
+// step per class instead of a scan of every section.
+// Returns 0, or -1 when out of memory.
+int buildFacultySchedule(const Schedule *sch, FacultySchedule *fs) {
+    const SchedulerContext *ctx = sch->ctx;
+    uint64_t *starts = malloc((ctx->totalFaculties + 1) * sizeof(uint64_t));
+    fs->first = malloc((ctx->totalFaculties + 1) * sizeof(int));
+    fs->classes = NULL;
+    if (!starts || !fs->first) goto fail;
+    
+    fs->first[0] = 0;
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        starts[f] = facultyClassStarts(sch, f);
+        fs->first[f + 1] = fs->first[f] + POPCOUNT64(starts[f]);
+    }
+    fs->classes = malloc((fs->first[ctx->totalFaculties] + 1) * sizeof(FacultyClass));
+    if (!fs->classes) goto fail;
+    
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        FacultyClass *c = &fs->classes[fs->first[f]];
+        for (uint64_t cells = starts[f]; cells; cells &= cells - 1) {
+            int cell = CTZ64(cells);
+            int section = FACULTY_SECTION(sch, f, cell);
+            *c++ = (FacultyClass){cell, section, sch->timetable[section * MAX_TOTAL_SLOTS + cell]};
+        }
+    }
+    free(starts);
+    return 0;
+    
+fail:
+    free(starts);
+    free(fs->first);
+    fs->first = NULL;
+    return -1;
+}
+
+void releaseFacultySchedule(FacultySchedule *fs) {
+    free(fs->classes);
+    free(fs->first);
+}
+
+// Classroom a section is booked into most often, or -1 if none
+int homeRoom(const SchedulerContext *ctx, int section) {
+    const Schedule *sch = ctx->schedule;
+    int best = -1;
+    int bestHours = 0;
+    for (int bit = 0; bit < ctx->roomTypeCount[ROOM_CLASSROOM]; bit++) {
+        int room = ctx->typeRooms[ROOM_CLASSROOM][bit];
+        int hours = 0;
+        for (int cell = 0; cell < MAX_TOTAL_SLOTS; cell++) {
+            hours += sch->roomOf[section * MAX_TOTAL_SLOTS + cell] == room;
+        }
+        if (hours > bestHours) {
+            best = room;
+            bestHours = hours;
+        }
+    }
+    return best;
+}
+
+// Section timetable in the printed layout
+int writeSectionText(const SchedulerContext *ctx, int sec) {
+    const Schedule *sch = ctx->schedule;
+    const Subject *subjects = ctx->subjects;
+    int subjectCount = ctx->subjectCount;
+    
+    char filename[64];
+    snprintf(filename, sizeof(filename), "section%s_timetable.txt", ctx->sectionNames[sec]);
+    LOG(ctx->options.verbose, LOG_INFO, "Creating file: %s\n", filename);
+    
+    Writer *w = openOutput(ctx, filename);
+    if (!w) return -1;
+
+    writerPuts(w, "=========== VASAVI COLLEGE OF ENGINEERING (AUTONOMOUS) ===========\n");
+    writerPuts(w, "=========== DEPARTMENT OF INFORMATION TECHNOLOGY ===========\n");
+    writerPuts(w, "=========== TIMETABLE - 2024-25 EVEN SEMESTER ===========\n");
+    if (ctx->roomTypeCount[ROOM_CLASSROOM] > 0) {
+        int home = homeRoom(ctx, sec);
+        writerPrintf(w, "COURSE: B.E\t\tSEMESTER: IV\t\tBranch/Section: %s\t\tROOM NO.: %s\n\n",
+                     ctx->sectionNames[sec], home >= 0 ? ctx->rooms[home].name : "-");
+    } else {
+        writerPrintf(w, "COURSE: B.E\t\tSEMESTER: IV\t\tBranch/Section: %s\t\tROOM NO.: VS-%d01\n\n", 
+                     ctx->sectionNames[sec], sec+2);
+    }
+
+    // Print header
+    const Grid *grid = &ctx->grid;
+    writerPad(w, "DAY/TIME", 12);
+    for (int s = 0; s < grid->slotsPerDay; s++) {
+        writerPad(w, grid->slotTimes[s], 15);
+    }
+    writerPuts(w, "\n");
+    
+    // Print separator line
+    char separator[12 + 15 * MAX_SLOTS_PER_DAY + 2];
+    int width = 12 + 15 * grid->slotsPerDay;
+    memset(separator, '-', width);
+    separator[width] = '\n';
+    separator[width + 1] = '\0';
+    writerPuts(w, separator);
+    
+    // Print rows
+    for (int d = 0; d < grid->days; d++) {
+        writerPad(w, grid->dayNames[d], 12);
+        
+        for (int s = 0; s < grid->slotsPerDay; s++) {
+            if (s >= grid->daySlots[d]) { // After the end of a short day
+                writerPad(w, "-", 15);
+            } else if (grid->breakSlots & (1u << s)) {
+                writerPad(w, grid->breakNames[s], 15);
+            } else {
+                int subIdx = TIMETABLE_AT(sch, sec, d, s);
+                
+                if (subIdx >= 0 && subIdx < subjectCount) {
+                    // Check for the later hours of longer subjects
+                    int cell = CELL_INDEX(grid, d, s);
+                    if (placementStart(sch, sec, cell) != cell) {
+                        writerPad(w, "(continued)", 15);
+                    } else {
+                        writerPad(w, subjects[subIdx].name, 15);
+                    }
+                } else {
+                    writerPad(w, "FREE", 15);
+                }
+            }
+        }
+        writerPuts(w, "\n");
+    }
+
+    // Print the room of every class when rooms are declared
+    if (ctx->roomCount > 0) {
+        writerPuts(w, "\n\n=========== ROOMS ===========\n\n");
+        for (int cell = 0; cell < MAX_TOTAL_SLOTS; cell++) {
+            int subIdx = sch->timetable[sec * MAX_TOTAL_SLOTS + cell];
+            int room = sch->roomOf[sec * MAX_TOTAL_SLOTS + cell];
+            if (subIdx < 0 || room < 0 || placementStart(sch, sec, cell) != cell) continue;
+            writerPad(w, grid->dayNames[CELL_DAY(grid, cell)], 12);
+            writerPad(w, grid->slotTimes[CELL_SLOT(grid, cell)], 15);
+            writerPad(w, subjects[subIdx].name, 15);
+            writerPrintf(w, "%s\n", ctx->rooms[room].name);
+        }
+    }
+
+    // Print subject details
+    writerPuts(w, "\n\n=========== SUBJECT DETAILS ===========\n\n");
+    for (int i = 0; i < subjectCount; i++) {
+        writerPrintf(w, "Subject: %s\nDuration: %d hour(s)\nWeekly Occurrences: %d\nFaculty: ",
+                     subjects[i].name, subjects[i].duration, subjects[i].occurrences);
+        if (subjects[i].facultyCount == 0) {
+            writerPuts(w, "None assigned");
+        } else {
+            for (int f = 0; f < subjects[i].facultyCount; f++) {
+                writerPuts(w, ctx->allFaculties[subjects[i].facultyIds[f]]);
+                if (f < subjects[i].facultyCount - 1) writerPuts(w, ", ");
+            }
+        }
+        writerPuts(w, "\n\n");
+    }
+
+    if (writerClose(w) != 0) {
+        printf("Error writing to file %s\n", filename);
+        return -1;
+    }
+    LOG(ctx->options.verbose, LOG_INFO, "Successfully generated timetable for Section %s\n", ctx->sectionNames[sec]);
+    return 0;
+}
+
+// Faculty workload report; every class counts once, a 2-hour lab included
+int writeWorkloadText(const SchedulerContext *ctx, const FacultySchedule *fs) {
+    const Grid *grid = &ctx->grid;
+    Writer *w = openOutput(ctx, "faculty_workload.txt");
+    if (!w) return -1;
+    
+    writerPuts(w, "=========== FACULTY WORKLOAD REPORT ===========\n\n");
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        writerPrintf(w, "Faculty: %s\nSchedule:\n", ctx->allFaculties[f]);
+        for (int i = fs->first[f]; i < fs->first[f + 1]; i++) {
+            const FacultyClass *c = &fs->classes[i];
+            writerPrintf(w, "  %s, %s, Section %s, %s\n", grid->dayNames[CELL_DAY(grid, c->cell)],
+                         grid->slotTimes[CELL_SLOT(grid, c->cell)], ctx->sectionNames[c->section],
+                         ctx->subjects[c->subIdx].name);
+        }
+        writerPrintf(w, "Total Hours: %d\n\n", fs->first[f + 1] - fs->first[f]);
+    }
+    
+    if (writerClose(w) != 0) {
+        printf("Error writing to file faculty_workload.txt\n");
+        return -1;
+    }
+    LOG(ctx->options.verbose, LOG_INFO, "Faculty workload report generated.\n");
+    return 0;
+}
+
+// timetable.csv (one row per class) and faculty_workload.csv
+int writeCsv(const SchedulerContext *ctx, const FacultySchedule *fs) {
+    const Schedule *sch = ctx->schedule;
+    const Subject *subjects = ctx->subjects;
+    const Grid *grid = &ctx->grid;
+    int result = 0;
+    
+    Writer *w = openOutput(ctx, "timetable.csv");
+    if (!w) return -1;
+    writerPuts(w, ctx->roomCount > 0 ? "section,day,slot,time,subject,duration,faculty,room\n" :
+                                       "section,day,slot,time,subject,duration,faculty\n");
+    for (int s = 0; s < ctx->sectionCount; s++) {
+        for (int cell = 0; cell < MAX_TOTAL_SLOTS; cell++) {
+            int subIdx = sch->timetable[s * MAX_TOTAL_SLOTS + cell];
+            if (subIdx < 0 || placementStart(sch, s, cell) != cell) continue;
+            writerPrintf(w, "%s,%s,%d,%s,", ctx->sectionNames[s], grid->dayNames[CELL_DAY(grid, cell)],
+                         CELL_SLOT(grid, cell) + 1, grid->slotTimes[CELL_SLOT(grid, cell)]);
+            writerCsvField(w, subjects[subIdx].name);
+            writerPrintf(w, ",%d,", subjects[subIdx].duration);
+            
+            // Several faculty members share one field, separated like the input
+            char faculty[1024];
+            size_t used = 0;
+            faculty[0] = '\0';
+            for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
+                used += snprintf(faculty + used, used < sizeof(faculty) ? sizeof(faculty) - used : 0,
+                                 "%s%s", f > 0 ? ";" : "", ctx->allFaculties[subjects[subIdx].facultyIds[f]]);
+            }
+            writerCsvField(w, faculty);
+            if (ctx->roomCount > 0) {
+                int room = sch->roomOf[s * MAX_TOTAL_SLOTS + cell];
+                writerPuts(w, ",");
+                writerCsvField(w, room >= 0 ? ctx->rooms[room].name : "");
+            }
+            writerPuts(w, "\n");
+        }
+    }
+    if (writerClose(w) != 0) result = -1;
+    
+    w = openOutput(ctx, "faculty_workload.csv");
+    if (!w) return -1;
+    writerPuts(w, "faculty,day,slot,time,section,subject\n");
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        for (int i = fs->first[f]; i < fs->first[f + 1]; i++) {
+            const FacultyClass *c = &fs->classes[i];
+            writerCsvField(w, ctx->allFaculties[f]);
+            writerPrintf(w, ",%s,%d,%s,%s,", grid->dayNames[CELL_DAY(grid, c->cell)],
+                         CELL_SLOT(grid, c->cell) + 1, grid->slotTimes[CELL_SLOT(grid, c->cell)],
+                         ctx->sectionNames[c->section]);
+            writerCsvField(w, subjects[c->subIdx].name);
+            writerPuts(w, "\n");
+        }
+    }
+    if (writerClose(w) != 0) result = -1;
+    
+    if (result == 0) {
+        LOG(ctx->options.verbose, LOG_INFO, "CSV export written to timetable.csv and faculty_workload.csv\n");
+    }
+    return result;
+}
+
+// timetable.json: every section's classes and every faculty member's week
+int writeJson(const SchedulerContext *ctx, const FacultySchedule *fs) {
+    const Schedule *sch = ctx->schedule;
+    const Subject *subjects = ctx->subjects;
+    const Grid *grid = &ctx->grid;
+    
+    Writer *w = openOutput(ctx, "timetable.json");
+    if (!w) return -1;
+    
+    writerPuts(w, "{\n  \"sections\": [");
+    for (int s = 0; s < ctx->sectionCount; s++) {
+        writerPuts(w, s > 0 ? ",\n    {\"name\": " : "\n    {\"name\": ");
+        writerJsonString(w, ctx->sectionNames[s]);
+        writerPuts(w, ", \"classes\": [");
+        int count = 0;
+        for (int cell = 0; cell < MAX_TOTAL_SLOTS; cell++) {
+            int subIdx = sch->timetable[s * MAX_TOTAL_SLOTS + cell];
+            if (subIdx < 0 || placementStart(sch, s, cell) != cell) continue;
+            writerPrintf(w, "%s\n      {\"day\": \"%s\", \"slot\": %d, \"time\": \"%s\", \"subject\": ",
+                         count++ > 0 ? "," : "", grid->dayNames[CELL_DAY(grid, cell)],
+                         CELL_SLOT(grid, cell) + 1, grid->slotTimes[CELL_SLOT(grid, cell)]);
+            writerJsonString(w, subjects[subIdx].name);
+            writerPrintf(w, ", \"duration\": %d, \"faculty\": [", subjects[subIdx].duration);
+            for (int f = 0; f < subjects[subIdx].facultyCount; f++) {
+                if (f > 0) writerPuts(w, ", ");
+                writerJsonString(w, ctx->allFaculties[subjects[subIdx].facultyIds[f]]);
+            }
+            writerPuts(w, "]");
+            int room = sch->roomOf[s * MAX_TOTAL_SLOTS + cell];
+            if (room >= 0) {
+                writerPuts(w, ", \"room\": ");
+                writerJsonString(w, ctx->rooms[room].name);
+            }
+            writerPuts(w, "}");
+        }
+        writerPuts(w, count > 0 ? "\n    ]}" : "]}");
+    }
+    
+    writerPuts(w, "\n  ],\n  \"faculty\": [");
+    for (int f = 0; f < ctx->totalFaculties; f++) {
+        writerPuts(w, f > 0 ? ",\n    {\"name\": " : "\n    {\"name\": ");
+        writerJsonString(w, ctx->allFaculties[f]);
+        writerPrintf(w, ", \"totalHours\": %d, \"classes\": [", fs->first[f + 1] - fs->first[f]);
+        for (int i = fs->first[f]; i < fs->first[f + 1]; i++) {
+            const FacultyClass *c = &fs->classes[i];
+            writerPrintf(w, "%s\n      {\"day\": \"%s\", \"slot\": %d, \"time\": \"%s\", \"section\": ",
+                         i > fs->first[f] ? "," : "", grid->dayNames[CELL_DAY(grid, c->cell)],
+                         CELL_SLOT(grid, c->cell) + 1, grid->slotTimes[CELL_SLOT(grid, c->cell)]);
+            writerJsonString(w, ctx->sectionNames[c->section]);
+            writerPuts(w, ", \"subject\": ");
+            writerJsonString(w, subjects[c->subIdx].name);
+            writerPuts(w, "}");
+        }
+        writerPuts(w, fs->first[f + 1] > fs->first[f] ? "\n    ]}" : "]}");
+    }
+    writerPrintf(w, "\n  ],\n  \"unplaced\": %d\n}\n", sch->unplaced);
+    
+    if (writerClose(w) != 0) {
+        printf("Error writing to file timetable.json\n");
+        return -1;
+    }
+    LOG(ctx->options.verbose, LOG_INFO, "JSON export written to timetable.json\n");
+    return 0;
+}
+
+// Write the requested OUTPUT_* formats to the current directory.
+// Returns 0, or -1 if any file could not be written.
+int writeOutputs(const SchedulerContext *ctx, int formats) {
+    LOG(ctx->options.verbose, LOG_INFO, "Generating timetable output files...\n");
+    
+    FacultySchedule fs;
+    if (buildFacultySchedule(ctx->schedule, &fs) != 0) {
+        printf("ERROR: Out of memory while writing the output\n");
+        return -1;
+    }
+    
+    int result = 0;
+    if (formats & OUTPUT_TEXT) {
+        for (int sec = 0; sec < ctx->sectionCount; sec++) {
+            if (writeSectionText(ctx, sec) != 0) result = -1;
+        }
+        if (writeWorkloadText(ctx, &fs) != 0) result = -1;
+    }
+    if ((formats & OUTPUT_CSV) && writeCsv(ctx, &fs) != 0) result = -1;
+    if ((formats & OUTPUT_JSON) && writeJson(ctx, &fs) != 0) result = -1;
+    
+    releaseFacultySchedule(&fs);
+    LOG(ctx->options.verbose, LOG_INFO, "All timetable files have been generated.\n");
+    return result;
+}
+
+// Names of the SOLVE_* results in the stats and the daemon's replies
+const char *statusNames[] = {"feasible", "infeasible", "budget_exhausted", "incomplete"};
+
+// Counters and phase timings of the last run as one JSON object
+int writeStats(const SchedulerContext *ctx, const char *filename) {
+    const Schedule *sch = ctx->schedule;
+    const SolveStats *st = &sch->stats;
+    
+    Writer *w = writerOpen(filename);
+    if (!w) return -1;
+    
+    writerPrintf(w, "{\n  \"subjects\": %d,\n  \"sections\": %d,\n  \"faculty\": %d,\n",
+                 ctx->subjectCount, ctx->sectionCount, ctx->totalFaculties);
+    writerPrintf(w, "  \"status\": \"%s\",\n  \"unplaced\": %d,\n  \"softCost\": %ld,\n",
+                 statusNames[sch->status], sch->unplaced, sch->storage ? softCost(sch) : 0L);
+    writerPrintf(w, "  \"checks\": %ld,\n  \"rejectedStarts\": {\"lunch\": %ld, \"occupied\": %ld, "
+                 "\"facultyBusy\": %ld, \"roomBusy\": %ld, \"sameDay\": %ld},\n",
+                 st->checks, st->rejectedLunch, st->rejectedOccupied, st->rejectedFaculty,
+                 st->rejectedRoom, st->rejectedSameDay);
+    writerPrintf(w, "  \"placements\": %ld,\n  \"fillInsertions\": %ld,\n  \"nodes\": %ld,\n",
+                 st->placements, st->fillInsertions, st->nodes);
+    writerPuts(w, "  \"phaseMs\": {");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        writerPrintf(w, "%s\"%s\": %.3f", p > 0 ? ", " : "", phaseNames[p], ctx->phaseSeconds[p] * 1e3);
+    }
+    writerPuts(w, "}\n}\n");
+    
+    if (writerClose(w) != 0) {
+        printf("Error writing to file %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Library interface (see timetable.h)
+// ---------------------------------------------------------------------------
+
+void schedulerDefaultOptions(SolverOptions *options) {
+    options->solver = SOLVER_GREEDY;
+    options->ordering = ORDER_DSATUR;
+    options->maxNodes = 5000000;
+    options->timeLimit = 10.0;
+    options->threads = 1;
+    options->attempts = 256;
+    options->optimizeMoves = 200000;
+    options->lnsRounds = 500;
+    options->anytime = 0;
+    options->seed = 0;
+    options->verbose = 0;
+}
+
+SchedulerContext *schedulerInit(const SolverOptions *options) {
+    SchedulerContext *ctx = calloc(1, sizeof(SchedulerContext));
+    if (!ctx) return NULL;
+    
+    ctx->schedule = calloc(1, sizeof(Schedule));
+    if (!ctx->schedule || schedulerSetSections(ctx, DEFAULT_SECTIONS) != 0) {
+        schedulerFree(ctx);
+        return NULL;
+    }
+    
+    if (options) {
+        schedulerSetOptions(ctx, options);
+    } else {
+        schedulerDefaultOptions(&ctx->options);
+    }
+    setDefaultGrid(&ctx->baseGrid);
+    ctx->grid = ctx->baseGrid;
+    return ctx;
+}
+
+void schedulerSetOptions(SchedulerContext *ctx, const SolverOptions *options) {
+    ctx->options = *options;
+    if (ctx->options.threads < 1) ctx->options.threads = 1;
+    if (ctx->options.attempts < 1) ctx->options.attempts = 1;
+}
+
+int schedulerSetSections(SchedulerContext *ctx, int count) {
+    if (count < 1) return -1;
+    
+    char (*names)[SECTION_NAME_LEN] = realloc(ctx->sectionNames, count * sizeof(*names));
+    if (!names) return -1;
+    
+    // IT-A ... IT-Z, then IT-AA, IT-AB, ... like spreadsheet columns
+    for (int s = 0; s < count; s++) {
+        char letters[8];
+        int len = 0;
+        for (int n = s + 1; n > 0 && len < 7; n = (n - 1) / 26) {
+            letters[len++] = 'A' + (n - 1) % 26;
+        }
+        char *out = names[s] + sprintf(names[s], "IT-");
+        while (len > 0) *out++ = letters[--len];
+        *out = '\0';
+    }
+    ctx->sectionNames = names;
+    ctx->sectionCount = count;
+    return 0;
+}
+
+// Forget the loaded input in one shot
+void releaseInput(SchedulerContext *ctx) {
+    arenaFree(&ctx->arena);
+    if (ctx->mapping) munmap(ctx->mapping, ctx->mappingSize);
+    ctx->mapping = NULL;
+    ctx->mappingSize = 0;
+    ctx->subjects = NULL;
+    ctx->subjectCount = 0;
+    ctx->allFaculties = NULL;
+    ctx->totalFaculties = 0;
+    ctx->facultyHash = NULL;
+    ctx->facultyHashSize = 0;
+    ctx->sharesFaculty = NULL;
+    ctx->conflictFirst = NULL;
+    ctx->conflictSubjects = NULL;
+    ctx->facultyBlocked = NULL;
+    ctx->pins = NULL;
+    ctx->pinCount = 0;
+    ctx->rooms = NULL;
+    ctx->roomCount = 0;
+    memset(ctx->roomTypeCount, 0, sizeof(ctx->roomTypeCount));
+    ctx->inputSections = 0;
+    ctx->grid = ctx->baseGrid;
+}
+
+int schedulerLoadFile(SchedulerContext *ctx, const char *filename) {
+    releaseInput(ctx);
+    double started = wallClockSeconds();
+    
+    // Compiled instances are recognised by their magic, anything else is text
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        char magic[sizeof(COMPILED_MAGIC) - 1];
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CompiledHeader) &&
+            pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) &&
+            memcmp(magic, COMPILED_MAGIC, sizeof(magic)) == 0) {
+            int count = loadCompiledInstance(ctx, fd, (size_t)st.st_size, filename);
+            close(fd);
+            if (count < 0) releaseInput(ctx);
+            ctx->phaseSeconds[PHASE_LOAD] = wallClockSeconds() - started;
+            return count;
+        }
+        close(fd);
+    }
+    
+    int count = readSubjectsFromFile(ctx, filename);
+    if (count < 0) releaseInput(ctx);
+    ctx->phaseSeconds[PHASE_LOAD] = wallClockSeconds() - started;
+    return count;
+}
+
+int schedulerLoadText(SchedulerContext *ctx, const char *text, size_t length) {
+    releaseInput(ctx);
+    double started = wallClockSeconds();
+    
+    // The parser cuts the lines in place and keeps pointers into them
+    char *copy = arenaAlloc(&ctx->arena, length + 1);
+    int count = -1;
+    if (!copy) {
+        printf("ERROR: Out of memory while reading submitted input\n");
+    } else {
+        memcpy(copy, text, length);
+        copy[length] = '\0';
+        count = readSubjectsFromText(ctx, copy, length, "submitted input");
+    }
+    if (count < 0) releaseInput(ctx);
+    ctx->phaseSeconds[PHASE_LOAD] = wallClockSeconds() - started;
+    return count;
+}
+
+int schedulerLoadGrid(SchedulerContext *ctx, const char *filename) {
+    Grid grid;
+    if (readGridFile(&grid, filename) != 0) return -1;
+    ctx->baseGrid = grid;
+    if (!ctx->subjects) ctx->grid = grid; // Nothing loaded refers to the old grid
+    return 0;
+}
+
+int schedulerCompile(const SchedulerContext *ctx, const char *filename) {
+    int errors = validateInstance(ctx);
+    if (errors == 0) errors = checkPins(ctx);
+    if (errors > 0) {
+        printf("Not compiling: %d error(s) in the input\n", errors);
+        return -1;
+    }
+    return writeCompiledInstance(ctx, filename);
+}
+
+int schedulerSolve(SchedulerContext *ctx) {
+    if (scheduleInit(ctx->schedule, ctx) != 0 ||
+        (!ctx->conflictFirst && buildConflictGraph(ctx) != 0)) {
+        printf("ERROR: Out of memory for the timetable\n");
+        return SOLVE_INCOMPLETE;
+    }
+    if (ctx->pinCount > 0) {
+        // Report the pins that the current sections and blackouts rule out
+        clearTimetable(ctx->schedule);
+        placePins(ctx->schedule, "WARNING");
+    }
+    generateTimetable(ctx);
+    return ctx->schedule->status;
+}
+
+void schedulerSetProgress(SchedulerContext *ctx, SchedulerProgressCallback callback,
+                          double interval, void *userData) {
+    ctx->progress = callback;
+    ctx->progressData = userData;
+    ctx->progressInterval = interval;
+}
+
+long schedulerPlacementChecks(const SchedulerContext *ctx) {
+    return ctx->schedule->stats.checks;
+}
+
+long schedulerSoftCost(const SchedulerContext *ctx) {
+    return softCost(ctx->schedule);
+}
+
+int schedulerBlockFaculty(SchedulerContext *ctx, const char *faculty, int day, int slot) {
+    int id = findFaculty(ctx, faculty);
+    const Grid *grid = &ctx->grid;
+    if (id == -1 || day < 0 || day >= grid->days || slot < -1 || slot >= grid->slotsPerDay) {
+        return -1;
+    }
+    ctx->facultyBlocked[id] |= slot == -1 ? grid->dayCells[1 << day] : CELL_BIT(grid, day, slot);
+    return 0;
+}
+
+int schedulerSaveSolution(const SchedulerContext *ctx, const char *filename) {
+    return saveSolution(ctx->schedule, filename);
+}
+
+int schedulerLoadSolution(SchedulerContext *ctx, const char *filename) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) {
+        printf("Cannot open solution file: %s\n", filename);
+        return -1;
+    }
+    int kept = restoreSolution(ctx, fp, filename);
+    fclose(fp);
+    return kept;
+}
+
+int schedulerVerify(const SchedulerContext *ctx, const char *filename) {
+    return verifySolution(ctx, filename);
+}
+
+int schedulerDiff(const char *oldFile, const char *newFile) {
+    return diffSolutions(oldFile, newFile);
+}
+
+int schedulerRepair(SchedulerContext *ctx) {
+    Schedule *sch = ctx->schedule;
+    ctx->seed = ctx->options.seed ? ctx->options.seed : (uint64_t)time(NULL);
+    LOG(ctx->options.verbose, LOG_INFO, "Random seed: %llu\n", (unsigned long long)ctx->seed);
+    seedSchedule(sch, ctx->seed);
+    memset(&sch->stats, 0, sizeof(SolveStats));
+    // Repair starts from the loaded solution, so the log does as well
+    if (ctx->decisionLogFile && openDecisionLog(sch, ctx->decisionLogFile, ctx->seed, ctx->options.solver) == 0) {
+        logCheckpoint(sch);
+    }
+    ctx->phaseSeconds[PHASE_SOLVE] = 0;
+    ctx->phaseSeconds[PHASE_OPTIMIZE] = 0;
+    double started = wallClockSeconds();
+    int moved = repairSchedule(sch);
+    LOG(sch->verbose, LOG_INFO, "Repair moved %d placement(s); %d required occurrence(s) unplaced.\n",
+        moved, sch->unplaced);
+    if (sch->unplaced > 0 && ctx->options.lnsRounds > 0) {
+        runLns(ctx, sch, ctx->options.lnsRounds);
+    }
+    ctx->phaseSeconds[PHASE_REPAIR] = wallClockSeconds() - started;
+    sch->status = sch->unplaced > 0 ? SOLVE_INCOMPLETE : SOLVE_FEASIBLE;
+    started = wallClockSeconds();
+    fillFreeSlots(sch);
+    ctx->phaseSeconds[PHASE_FILL] = wallClockSeconds() - started;
+    closeDecisionLog(sch, ctx->decisionLogFile);
+    return sch->status;
+}
+
+int schedulerUnplaced(const SchedulerContext *ctx) {
+    return ctx->schedule->unplaced;
+}
+
+int schedulerFacultyHours(const SchedulerContext *ctx, const char *faculty, int day) {
+    int id = findFaculty(ctx, faculty);
+    if (id == -1 || day < -1 || day >= ctx->grid.days) return -1;
+    const Schedule *sch = ctx->schedule;
+    if (!sch->storage) return 0;
+    if (day == -1) return facultyHours(sch, id);
+    uint64_t taught = sch->facultyBusy[id] & ~ctx->facultyBlocked[id];
+    return POPCOUNT64(taught & ctx->grid.dayCells[1 << day]);
+}
+
+const char *schedulerFacultyClass(const SchedulerContext *ctx, const char *faculty, int day, int slot, int *section) {
+    int id = findFaculty(ctx, faculty);
+    const Schedule *sch = ctx->schedule;
+    if (id == -1 || !sch->storage || day < 0 || day >= ctx->grid.days || slot < 0 || slot >= ctx->grid.slotsPerDay) {
+        return NULL;
+    }
+    int cell = CELL_INDEX(&ctx->grid, day, slot);
+    int s = FACULTY_SECTION(sch, id, cell);
+    if (s < 0) return NULL;
+    if (section) *section = s;
+    return ctx->subjects[sch->timetable[s * MAX_TOTAL_SLOTS + cell]].name;
+}
+
+unsigned long long schedulerSeed(const SchedulerContext *ctx) {
+    return ctx->seed;
+}
+
+int schedulerSetDecisionLog(SchedulerContext *ctx, const char *filename) {
+    char *copy = NULL;
+    if (filename && !(copy = strdup(filename))) return -1;
+    free(ctx->decisionLogFile);
+    ctx->decisionLogFile = copy;
+    return 0;
+}
+
+long schedulerReplay(SchedulerContext *ctx, const char *filename, long steps) {
+    return replayDecisions(ctx, filename, steps);
+}
+
+int schedulerCoreFacultyCount(const SchedulerContext *ctx) {
+    return ctx->schedule->coreFacultyCount;
+}
+
+const char *schedulerCoreFaculty(const SchedulerContext *ctx, int index) {
+    return ctx->allFaculties[ctx->schedule->coreFaculty[index]];
+}
+
+void schedulerWriteFiles(SchedulerContext *ctx) {
+    schedulerWriteOutputs(ctx, OUTPUT_TEXT);
+}
+
+int schedulerWriteOutputs(SchedulerContext *ctx, int formats) {
+    double started = wallClockSeconds();
+    int result = writeOutputs(ctx, formats);
+    ctx->phaseSeconds[PHASE_WRITE] = wallClockSeconds() - started;
+    return result;
+}
+
+int schedulerWriteStats(const SchedulerContext *ctx, const char *filename) {
+    return writeStats(ctx, filename);
+}
+
+void schedulerFree(SchedulerContext *ctx) {
+    if (!ctx) return;
+    for (int t = 0; t < ctx->workerCount; t++) {
+        scheduleRelease(&ctx->workers[t]);
+    }
+    free(ctx->workers);
+    if (ctx->schedule) scheduleRelease(ctx->schedule);
+    free(ctx->schedule);
+    free(ctx->sectionNames);
+    free(ctx->outputDirectory);
+    free(ctx->decisionLogFile);
+    releaseInput(ctx);
+    free(ctx);
+}
+
+int schedulerSetOutputDirectory(SchedulerContext *ctx, const char *directory) {
+    char *copy = NULL;
+    if (directory && !(copy = strdup(directory))) return -1;
+    free(ctx->outputDirectory);
+    ctx->outputDirectory = copy;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Batch mode: one context per department, sharing faculty members by name.
+// Departments form a conflict graph (an edge when they share a faculty
+// member), which greedy colouring in the order the departments were added
+// splits into waves. The departments of a wave share nobody and are solved
+// in parallel; every later wave sees the cells that earlier waves booked for
+// its faculty as blocked.
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char *name;
+    SchedulerContext *ctx;
+    int wave;
+    int status;               // SOLVE_* of the last batch solve
+    uint64_t *ownBlocked;     // The department's own blackouts while a batch solve runs
+} Department;
+
+struct SchedulerBatch {
+    SolverOptions options;
+    Grid grid;                // Grid every department's input starts from
+    Department *departments;
+    int count;
+    int capacity;
+    int waves;
+};
+
+// One wave of departments solved by a small thread pool
+typedef struct {
+    SchedulerBatch *batch;
+    const int *members;
+    int count;
+    atomic_int next;
+} BatchWave;
+
+void *batchWorker(void *arg) {
+    BatchWave *wave = arg;
+    for (;;) {
+        int i = atomic_fetch_add(&wave->next, 1);
+        if (i >= wave->count) break;
+        Department *dep = &wave->batch->departments[wave->members[i]];
+        dep->status = schedulerSolve(dep->ctx);
+    }
+    return NULL;
+}
+
+// Check if two departments have a faculty member in common
+int departmentsShareFaculty(const SchedulerContext *a, const SchedulerContext *b) {
+    for (int f = 0; f < a->totalFaculties; f++) {
+        if (findFaculty(b, a->allFaculties[f]) != -1) return 1;
+    }
+    return 0;
+}
+
+// Block the cells a solved department booked for every faculty member it
+// shares with a department of a later wave
+void shareFacultyBusy(const SchedulerContext *from, SchedulerContext *to) {
+    for (int f = 0; f < from->totalFaculties; f++) {
+        int id = findFaculty(to, from->allFaculties[f]);
+        if (id != -1) {
+            to->facultyBlocked[id] |= from->schedule->facultyBusy[f];
+        }
+    }
+}
+
+SchedulerBatch *schedulerBatchInit(const SolverOptions *options) {
+    SchedulerBatch *batch = calloc(1, sizeof(SchedulerBatch));
+    if (!batch) return NULL;
+    if (options) {
+        batch->options = *options;
+    } else {
+        schedulerDefaultOptions(&batch->options);
+    }
+    setDefaultGrid(&batch->grid);
+    return batch;
+}
+
+int schedulerBatchLoadGrid(SchedulerBatch *batch, const char *filename) {
+    return readGridFile(&batch->grid, filename);
+}
+
+// Week masks of two departments mean the same cells, so faculty bookings
+// can be passed between them
+int sameGridShape(const Grid *a, const Grid *b) {
+    return a->days == b->days && a->slotsPerDay == b->slotsPerDay && a->teachingMask == b->teachingMask;
+}
+
+int schedulerBatchAdd(SchedulerBatch *batch, const char *name, const char *filename, int sections) {
+    if (batch->count == batch->capacity) {
+        int capacity = batch->capacity ? batch->capacity * 2 : 8;
+        Department *departments = realloc(batch->departments, capacity * sizeof(Department));
+        if (!departments) return -1;
+        batch->departments = departments;
+        batch->capacity = capacity;
+    }
+    
+    Department *dep = &batch->departments[batch->count];
+    memset(dep, 0, sizeof(Department));
+    dep->name = strdup(name);
+    dep->ctx = schedulerInit(&batch->options);
+    if (dep->ctx) {
+        dep->ctx->baseGrid = batch->grid;
+        dep->ctx->grid = batch->grid;
+    }
+    if (!dep->name || !dep->ctx || schedulerSetSections(dep->ctx, sections) != 0 ||
+        schedulerSetOutputDirectory(dep->ctx, name) != 0 ||
+        schedulerLoadFile(dep->ctx, filename) < 0) {
+        free(dep->name);
+        schedulerFree(dep->ctx);
+        return -1;
+    }
+    if (batch->count > 0 && !sameGridShape(&dep->ctx->grid, &batch->departments[0].ctx->grid)) {
+        printf("ERROR: Department %s does not use the same grid as %s\n", name, batch->departments[0].name);
+        free(dep->name);
+        schedulerFree(dep->ctx);
+        return -1;
+    }
+    return batch->count++;
+}
+
+int schedulerBatchSolve(SchedulerBatch *batch) {
+    int n = batch->count;
+    unsigned char *shares = calloc((size_t)n * n + 1, 1);
+    int *members = malloc((n + 1) * sizeof(int));
+    int result = SOLVE_FEASIBLE;
+    if (!shares || !members) goto fail;
+    
+    // Keep every department's own blackouts; the batch adds others' bookings
+    for (int d = 0; d < n; d++) {
+        SchedulerContext *ctx = batch->departments[d].ctx;
+        size_t size = (ctx->totalFaculties + 1) * sizeof(uint64_t);
+        batch->departments[d].ownBlocked = malloc(size);
+        if (!batch->departments[d].ownBlocked) goto fail;
+        memcpy(batch->departments[d].ownBlocked, ctx->facultyBlocked, ctx->totalFaculties * sizeof(uint64_t));
+    }
+    
+    // Greedy colouring: the first wave not used by a conflicting earlier department
+    batch->waves = 0;
+    for (int d = 0; d < n; d++) {
+        unsigned char used[n + 1];
+        memset(used, 0, sizeof(used));
+        for (int e = 0; e < d; e++) {
+            if (departmentsShareFaculty(batch->departments[d].ctx, batch->departments[e].ctx)) {
+                shares[d * n + e] = shares[e * n + d] = 1;
+                used[batch->departments[e].wave] = 1;
+            }
+        }
+        int wave = 0;
+        while (used[wave]) wave++;
+        batch->departments[d].wave = wave;
+        if (wave + 1 > batch->waves) batch->waves = wave + 1;
+    }
+    
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int w = 0; w < batch->waves; w++) {
+        BatchWave wave;
+        wave.batch = batch;
+        wave.members = members;
+        wave.count = 0;
+        atomic_init(&wave.next, 0);
+        for (int d = 0; d < n; d++) {
+            if (batch->departments[d].wave == w) members[wave.count++] = d;
+        }
+        LOG(batch->options.verbose, LOG_INFO, "Batch wave %d: solving %d department(s)\n", w + 1, wave.count);
+        
+        int threads = cores > 1 && cores < wave.count ? (int)cores : wave.count;
+        pthread_t tids[threads];
+        int started = 0;
+        while (started < threads && pthread_create(&tids[started], NULL, batchWorker, &wave) == 0) {
+            started++;
+        }
+        if (started == 0) batchWorker(&wave);
+        for (int t = 0; t < started; t++) {
+            pthread_join(tids[t], NULL);
+        }
+        
+        for (int i = 0; i < wave.count; i++) {
+            Department *dep = &batch->departments[members[i]];
+            if (result == SOLVE_FEASIBLE) result = dep->status;
+            for (int e = 0; e < n; e++) {
+                if (shares[members[i] * n + e] && batch->departments[e].wave > w) {
+                    shareFacultyBusy(dep->ctx, batch->departments[e].ctx);
+                }
+            }
+        }
+    }
+    goto done;
+    
+fail:
+    printf("ERROR: Out of memory for the batch\n");
+    result = SOLVE_INCOMPLETE;
+done:
+    for (int d = 0; d < n; d++) {
+        Department *dep = &batch->departments[d];
+        if (dep->ownBlocked) {
+            memcpy(dep->ctx->facultyBlocked, dep->ownBlocked, dep->ctx->totalFaculties * sizeof(uint64_t));
+            free(dep->ownBlocked);
+            dep->ownBlocked = NULL;
+        }
+    }
+    free(shares);
+    free(members);
+    return result;
+}
+
+int schedulerBatchCount(const SchedulerBatch *batch) {
+    return batch->count;
+}
+
+SchedulerContext *schedulerBatchContext(SchedulerBatch *batch, int department) {
+    return batch->departments[department].ctx;
+}
+
+const char *schedulerBatchName(const SchedulerBatch *batch, int department) {
+    return batch->departments[department].name;
+}
+
+int schedulerBatchWave(const SchedulerBatch *batch, int department) {
+    return batch->departments[department].wave;
+}
+
+int schedulerBatchWriteOutputs(SchedulerBatch *batch, int formats) {
+    int result = 0;
+    for (int d = 0; d < batch->count; d++) {
+        Department *dep = &batch->departments[d];
+        if (mkdir(dep->name, 0777) != 0 && errno != EEXIST) {
+            printf("Cannot create output directory %s\n", dep->name);
+            result = -1;
+            continue;
+        }
+        if (schedulerWriteOutputs(dep->ctx, formats) != 0) result = -1;
+    }
+    return result;
+}
+
+void schedulerBatchFree(SchedulerBatch *batch) {
+    if (!batch) return;
+    for (int d = 0; d < batch->count; d++) {
+        free(batch->departments[d].name);
+        schedulerFree(batch->departments[d].ctx);
+    }
+    free(batch->departments);
+    free(batch);
+}
+
+// ---------------------------------------------------------------------------
+// Daemon mode: a resident server on a Unix domain socket. Every named
+// instance keeps its parsed input, blackouts and last timetable in memory,
+// so a client re-solves or repairs after an edit without starting a process
+// or parsing the input again. The accept loop queues connections for a fixed
+// pool of workers; requests on different instances run in parallel, and
+// requests on the same instance take turns.
+//
+// Every request is one line, and every reply starts with "OK" or with
+// "ERROR message":
+//   LOAD NAME PATH         read a subjects or compiled file   -> OK SUBJECTS
+//   SUBMIT NAME BYTES      the next BYTES bytes are subjects text -> OK SUBJECTS
+//   SECTIONS NAME N        set the number of sections
+//   UNAVAILABLE NAME SPEC  add a blackout FACULTY@DAY[:SLOT[-SLOT]]
+//   SOLVE NAME             generate a new timetable
+//   REPAIR NAME            refit the last timetable to the edits since
+//   GET NAME               the last timetable
+//   DROP NAME              forget the instance
+//   LIST                   -> OK COUNT, then one name per line
+//   SHUTDOWN               stop accepting and exit once requests finish
+// SOLVE, REPAIR and GET reply "OK STATUS UNPLACED LINES" followed by LINES
+// lines in the --save format, header included.
+// ---------------------------------------------------------------------------
+
+#define SERVE_NAME_LEN 64
+#define SERVE_LINE_LEN 4096
+#define SERVE_QUEUE_LENGTH 64       // Accepted connections waiting for a worker
+#define SERVE_MAX_SUBMIT (64 << 20) // Largest SUBMIT body in bytes
+
+typedef struct ServedInstance {
+    char name[SERVE_NAME_LEN];
+    SchedulerContext *ctx;
+    pthread_mutex_t lock;     // Held by the request using the instance
+    char *solution;           // Last timetable as writeSolution() lines, NULL before the first
+    size_t solutionLength;
+    int solutionLines;
+    int status;               // SOLVE_* and unplaced occurrences of that timetable
+    int unplaced;
+    int refs;                 // Requests holding the instance; guarded by the server lock
+    int dropped;
+    struct ServedInstance *next;
+} ServedInstance;
+
+typedef struct {
+    SolverOptions options;
+    Grid grid;                // Grid every instance starts from
+    int listenFd;
+    int wakeFds[2];           // Written once to stop the accept loop
+    pthread_mutex_t lock;     // Guards the fields below
+    pthread_cond_t changed;   // The queue or stopping changed
+    ServedInstance *instances;
+    int queue[SERVE_QUEUE_LENGTH];
+    int queueHead;
+    int queueCount;
+    int *active;              // Connection each worker serves, -1 when idle
+    int stopping;
+} Server;
+
+typedef struct {
+    Server *server;
+    int index;
+} ServeWorker;
+
+void freeInstance(ServedInstance *inst) {
+    schedulerFree(inst->ctx);
+    free(inst->solution);
+    pthread_mutex_destroy(&inst->lock);
+    free(inst);
+}
+
+// Find the instance called name, creating it when asked to, and lock it.
+// Returns NULL for an unknown name or when out of memory.
+ServedInstance *acquireInstance(Server *server, const char *name, int create) {
+    for (;;) {
+        pthread_mutex_lock(&server->lock);
+        ServedInstance *inst = server->instances;
+        while (inst && strcmp(inst->name, name) != 0) inst = inst->next;
+        if (!inst && create && (inst = calloc(1, sizeof(ServedInstance)))) {
+            inst->ctx = schedulerInit(&server->options);
+            if (inst->ctx) {
+                inst->ctx->baseGrid = server->grid;
+                inst->ctx->grid = server->grid;
+                snprintf(inst->name, sizeof(inst->name), "%s", name);
+                pthread_mutex_init(&inst->lock, NULL);
+                inst->next = server->instances;
+                server->instances = inst;
+            } else {
+                free(inst);
+                inst = NULL;
+            }
+        }
+        if (inst) inst->refs++;
+        pthread_mutex_unlock(&server->lock);
+        if (!inst) return NULL;
+        
+        pthread_mutex_lock(&inst->lock);
+        if (!inst->dropped) return inst;
+        
+        // Dropped while this request waited; it is no longer listed
+        pthread_mutex_unlock(&inst->lock);
+        pthread_mutex_lock(&server->lock);
+        int last = --inst->refs == 0;
+        pthread_mutex_unlock(&server->lock);
+        if (last) freeInstance(inst);
+    }
+}
+
+void releaseInstance(Server *server, ServedInstance *inst) {
+    pthread_mutex_unlock(&inst->lock);
+    pthread_mutex_lock(&server->lock);
+    int last = --inst->refs == 0 && inst->dropped;
+    pthread_mutex_unlock(&server->lock);
+    if (last) freeInstance(inst);
+}
+
+// Unlist a held instance; the last request holding it frees it
+void dropInstance(Server *server, ServedInstance *inst) {
+    pthread_mutex_lock(&server->lock);
+    ServedInstance **link = &server->instances;
+    while (*link != inst) link = &(*link)->next;
+    *link = inst->next;
+    inst->dropped = 1;
+    pthread_mutex_unlock(&server->lock);
+}
+
+// Keep the context's timetable as the instance's last solution
+int keepSolution(ServedInstance *inst) {
+    char *text = NULL;
+    size_t length = 0;
+    FILE *fp = open_memstream(&text, &length);
+    if (!fp) return -1;
+    writeSolution(inst->ctx->schedule, fp);
+    if (fclose(fp) != 0) {
+        free(text);
+        return -1;
+    }
+    
+    free(inst->solution);
+    inst->solution = text;
+    inst->solutionLength = length;
+    inst->solutionLines = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '\n') inst->solutionLines++;
+    }
+    inst->status = inst->ctx->schedule->status;
+    inst->unplaced = inst->ctx->schedule->unplaced;
+    return 0;
+}
+
+void replySolution(FILE *out, const ServedInstance *inst) {
+    fprintf(out, "OK %s %d %d\n", statusNames[inst->status], inst->unplaced, inst->solutionLines);
+    fwrite(inst->solution, 1, inst->solutionLength, out);
+}
+
+// Load the last solution against the current input and blackouts and
+// re-place what no longer fits
+int refitSolution(ServedInstance *inst) {
+    FILE *fp = fmemopen(inst->solution, inst->solutionLength, "r");
+    if (!fp) return -1;
+    int kept = restoreSolution(inst->ctx, fp, inst->name);
+    fclose(fp);
+    if (kept < 0) return -1;
+    schedulerRepair(inst->ctx);
+    return 0;
+}
+
+// Stop accepting, and end every open connection after its current request
+void stopServer(Server *server) {
+    pthread_mutex_lock(&server->lock);
+    if (!server->stopping) {
+        server->stopping = 1;
+        char byte = 0;
+        if (write(server->wakeFds[1], &byte, 1) != 1) printf("WARNING: Could not wake the daemon's accept loop\n");
+    }
+    for (int i = 0; server->active[i] != -2; i++) {
+        if (server->active[i] >= 0) shutdown(server->active[i], SHUT_RD);
+    }
+    pthread_cond_broadcast(&server->changed);
+    pthread_mutex_unlock(&server->lock);
+}
+
+// Cut the first word off text; returns the rest with leading spaces skipped
+char *splitWord(char *text) {
+    char *rest = text + strcspn(text, " ");
+    if (*rest) *rest++ = '\0';
+    while (*rest == ' ') rest++;
+    return rest;
+}
+
+// Answer one request line. Returns 0, or -1 when the connection can no
+// longer be read in step with the client.
+int handleRequest(Server *server, char *line, FILE *in, FILE *out) {
+    char *verb = line;
+    char *name = splitWord(verb);
+    char *argument = splitWord(name);
+    
+    if (strcmp(verb, "LIST") == 0) {
+        pthread_mutex_lock(&server->lock);
+        int count = 0;
+        for (ServedInstance *inst = server->instances; inst; inst = inst->next) count++;
+        fprintf(out, "OK %d\n", count);
+        for (ServedInstance *inst = server->instances; inst; inst = inst->next) {
+            fprintf(out, "%s\n", inst->name);
+        }
+        pthread_mutex_unlock(&server->lock);
+        return 0;
+    }
+    if (strcmp(verb, "SHUTDOWN") == 0) {
+        stopServer(server);
+        fprintf(out, "OK\n");
+        return 0;
+    }
+    
+    // The body of a SUBMIT follows even when the request is refused
+    char *body = NULL;
+    long bytes = 0;
+    if (strcmp(verb, "SUBMIT") == 0) {
+        char *end;
+        bytes = strtol(argument, &end, 10);
+        if (end == argument || *end != '\0' || bytes < 0 || bytes > SERVE_MAX_SUBMIT) {
+            fprintf(out, "ERROR Invalid SUBMIT size '%s' (at most %d bytes)\n", argument, SERVE_MAX_SUBMIT);
+            return -1;
+        }
+        body = malloc(bytes + 1);
+        if (!body || fread(body, 1, bytes, in) != (size_t)bytes) {
+            fprintf(out, "ERROR Could not read %ld bytes of input\n", bytes);
+            free(body);
+            return -1;
+        }
+    }
+    
+    if (name[0] == '\0' || strlen(name) >= SERVE_NAME_LEN) {
+        fprintf(out, "ERROR Missing or too long instance name\n");
+        free(body);
+        return 0;
+    }
+    int creates = strcmp(verb, "LOAD") == 0 || body;
+    if (!creates && strcmp(verb, "SECTIONS") != 0 && strcmp(verb, "UNAVAILABLE") != 0 &&
+        strcmp(verb, "SOLVE") != 0 && strcmp(verb, "REPAIR") != 0 &&
+        strcmp(verb, "GET") != 0 && strcmp(verb, "DROP") != 0) {
+        fprintf(out, "ERROR Unknown request %s\n", verb);
+        return 0;
+    }
+    
+    ServedInstance *inst = acquireInstance(server, name, creates);
+    if (!inst) {
+        fprintf(out, creates ? "ERROR Out of memory\n" : "ERROR Unknown instance %s\n", name);
+        free(body);
+        return 0;
+    }
+    SchedulerContext *ctx = inst->ctx;
+    int needsInput = strcmp(verb, "UNAVAILABLE") == 0 || strcmp(verb, "SOLVE") == 0 ||
+                     strcmp(verb, "REPAIR") == 0;
+    int needsSolution = strcmp(verb, "REPAIR") == 0 || strcmp(verb, "GET") == 0;
+    
+    if (needsInput && !ctx->subjects) {
+        fprintf(out, "ERROR No input loaded for %s\n", name);
+    } else if (needsSolution && !inst->solution) {
+        fprintf(out, "ERROR No timetable for %s yet\n", name);
+    } else if (body) {
+        int count = schedulerLoadText(ctx, body, bytes);
+        if (count < 0) {
+            fprintf(out, "ERROR Invalid input for %s\n", name);
+        } else {
+            fprintf(out, "OK %d\n", count);
+        }
+    } else if (strcmp(verb, "LOAD") == 0) {
+        int count = argument[0] ? schedulerLoadFile(ctx, argument) : -1;
+        if (count < 0) {
+            fprintf(out, "ERROR Could not load '%s'\n", argument);
+        } else {
+            fprintf(out, "OK %d\n", count);
+        }
+    } else if (strcmp(verb, "SECTIONS") == 0) {
+        if (schedulerSetSections(ctx, atoi(argument)) != 0) {
+            fprintf(out, "ERROR Invalid section count '%s'\n", argument);
+        } else {
+            fprintf(out, "OK\n");
+        }
+    } else if (strcmp(verb, "UNAVAILABLE") == 0) {
+        if (applyUnavailable(ctx, argument) != 0) {
+            fprintf(out, "ERROR Invalid blackout '%s' (unknown faculty, day or slot)\n", argument);
+        } else {
+            fprintf(out, "OK\n");
+        }
+    } else if (strcmp(verb, "SOLVE") == 0 || strcmp(verb, "REPAIR") == 0) {
+        if (strcmp(verb, "SOLVE") == 0) {
+            schedulerSolve(ctx);
+        } else if (refitSolution(inst) != 0) {
+            fprintf(out, "ERROR Could not repair %s\n", name);
+            releaseInstance(server, inst);
+            return 0;
+        }
+        if (keepSolution(inst) != 0) {
+            fprintf(out, "ERROR Out of memory\n");
+        } else {
+            replySolution(out, inst);
+        }
+    } else if (strcmp(verb, "GET") == 0) {
+        replySolution(out, inst);
+    } else {
+        dropInstance(server, inst);
+        fprintf(out, "OK\n");
+    }
+    
+    releaseInstance(server, inst);
+    free(body);
+    return 0;
+}
+
+// Answer the requests of one connection until the client closes it
+void serveConnection(Server *server, int fd) {
+    int inFd = dup(fd);
+    int outFd = dup(fd);
+    FILE *in = inFd >= 0 ? fdopen(inFd, "r") : NULL;
+    FILE *out = outFd >= 0 ? fdopen(outFd, "w") : NULL;
+    if (!in || !out) {
+        if (in) fclose(in); else if (inFd >= 0) close(inFd);
+        if (out) fclose(out); else if (outFd >= 0) close(outFd);
+        return;
+    }
+    
+    char line[SERVE_LINE_LEN];
+    while (fgets(line, sizeof(line), in)) {
+        size_t length = strcspn(line, "\r\n");
+        if (line[length] == '\0' && !feof(in)) {
+            fprintf(out, "ERROR Request longer than %d bytes\n", SERVE_LINE_LEN - 1);
+            break;
+        }
+        line[length] = '\0';
+        if (handleRequest(server, line, in, out) != 0 || fflush(out) != 0) break;
+    }
+    fclose(out);
+    fclose(in);
+}
+
+void *serveWorker(void *arg) {
+    ServeWorker *worker = arg;
+    Server *server = worker->server;
+    pthread_mutex_lock(&server->lock);
+    for (;;) {
+        while (server->queueCount == 0 && !server->stopping) {
+            pthread_cond_wait(&server->changed, &server->lock);
+        }
+        if (server->stopping) break;
+        
+        int fd = server->queue[server->queueHead];
+        server->queueHead = (server->queueHead + 1) % SERVE_QUEUE_LENGTH;
+        server->queueCount--;
+        server->active[worker->index] = fd;
+        pthread_cond_broadcast(&server->changed);
+        pthread_mutex_unlock(&server->lock);
+        
+        serveConnection(server, fd);
+        
+        // Leave the list before closing, so stopServer() never sees a reused fd
+        pthread_mutex_lock(&server->lock);
+        server->active[worker->index] = -1;
+        close(fd);
+    }
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+int schedulerServe(const char *socketPath, const SolverOptions *options, const char *gridFile, int workers) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    if (options) {
+        server.options = *options;
+    } else {
+        schedulerDefaultOptions(&server.options);
+    }
+    setDefaultGrid(&server.grid);
+    if (gridFile && readGridFile(&server.grid, gridFile) != 0) return -1;
+    if (workers < 1) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cores > 1 ? (int)cores : 1;
+    }
+    
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        printf("ERROR: Socket path too long: %s\n", socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+    
+    // A socket left behind by an earlier run is replaced, any other file is not
+    struct stat st;
+    if (lstat(socketPath, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(socketPath);
+    server.listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server.listenFd < 0 || bind(server.listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(server.listenFd, SERVE_QUEUE_LENGTH) != 0) {
+        printf("ERROR: Cannot listen on %s: %s\n", socketPath, strerror(errno));
+        if (server.listenFd >= 0) close(server.listenFd);
+        return -1;
+    }
+    server.active = malloc((workers + 1) * sizeof(int));
+    ServeWorker *pool = malloc(workers * sizeof(ServeWorker));
+    pthread_t *tids = malloc(workers * sizeof(pthread_t));
+    if (!server.active || !pool || !tids || pipe(server.wakeFds) != 0) {
+        printf("ERROR: Out of memory\n");
+        free(server.active);
+        free(pool);
+        free(tids);
+        close(server.listenFd);
+        unlink(socketPath);
+        return -1;
+    }
+    for (int i = 0; i < workers; i++) server.active[i] = -1;
+    server.active[workers] = -2; // End of the list
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.changed, NULL);
+    
+    // A client that hangs up must not kill the daemon while a reply is written
+    signal(SIGPIPE, SIG_IGN);
+    
+    int started = 0;
+    while (started < workers) {
+        pool[started].server = &server;
+        pool[started].index = started;
+        if (pthread_create(&tids[started], NULL, serveWorker, &pool[started]) != 0) break;
+        started++;
+    }
+    int result = started > 0 ? 0 : -1;
+    if (started == 0) printf("ERROR: Could not start any worker thread\n");
+    LOG(server.options.verbose, LOG_INFO, "Serving on %s with %d worker(s)\n", socketPath, started);
+    
+    while (started > 0) {
+        struct pollfd fds[2] = {{server.listenFd, POLLIN, 0}, {server.wakeFds[0], POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+        int client = accept(server.listenFd, NULL, NULL);
+        if (client < 0) continue;
+        
+        pthread_mutex_lock(&server.lock);
+        while (server.queueCount == SERVE_QUEUE_LENGTH && !server.stopping) {
+            pthread_cond_wait(&server.changed, &server.lock);
+        }
+        if (server.stopping) {
+            close(client);
+        } else {
+            server.queue[(server.queueHead + server.queueCount) % SERVE_QUEUE_LENGTH] = client;
+            server.queueCount++;
+            pthread_cond_broadcast(&server.changed);
+        }
+        pthread_mutex_unlock(&server.lock);
+    }
+    
+    stopServer(&server);
+    for (int t = 0; t < started; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    for (int i = 0; i < server.queueCount; i++) {
+        close(server.queue[(server.queueHead + i) % SERVE_QUEUE_LENGTH]);
+    }
+    while (server.instances) {
+        ServedInstance *inst = server.instances;
+        server.instances = inst->next;
+        freeInstance(inst);
+    }
+    close(server.listenFd);
+    close(server.wakeFds[0]);
+    close(server.wakeFds[1]);
+    unlink(socketPath);
+    pthread_cond_destroy(&server.changed);
+    pthread_mutex_destroy(&server.lock);
+    free(server.active);
+    free(pool);
+    free(tids);
+    LOG(server.options.verbose, LOG_INFO, "Daemon on %s stopped\n", socketPath);
+    return result;
+}
+
+#ifndef TIMETABLE_LIBRARY
+
+void printUsage(const char *program) {
+    printf("Usage: %s [--solver=greedy|backtrack|sat] [--order=dsatur|degree|duration]\n"
+           "          [--max-nodes=N] [--time-limit=SECONDS] [--anytime=SECONDS]\n"
+           "          [--portfolio[=THREADS]] [--attempts=N] [--sections=N]\n"
+           "          [--optimize=MOVES] [--lns=ROUNDS] [--input=FILE] [--compile=OUTPUT]\n"
+           "          [--format=text,csv,json]\n"
+           "          [--save=FILE] [--repair=FILE] [--unavailable=FACULTY@DAY[:SLOT[-SLOT]]]...\n"
+           "          [--quiet | --log-level=0|1|2] [--stats[=FILE]] [--grid=FILE]\n"
+           "          [--department=NAME:FILE[:SECTIONS]]...\n"
+           "          [--daemon=SOCKET [--workers=N]] [--verify=SOLUTION] [--diff=OLD:NEW]\n"
+           "          [--seed=N] [--decision-log=FILE] [--replay=LOG[:STEPS]]\n", program);
+}
+
+// Periodic stats line of an --anytime run
+int printProgress(const SchedulerProgress *progress, void *userData) {
+    (void)userData;
+    printf("[%7.3fs] %d attempt(s), %ld nodes, best: %d unplaced, soft cost %ld%s\n",
+           progress->elapsed, progress->attempts, progress->nodes, progress->unplaced,
+           progress->softCost, progress->done ? " (done)" : progress->improved ? " (improved)" : "");
+    return 0;
+}
+
+// Parse a --format list such as "text,json"; returns 0 if a name is unknown
+int parseFormats(const char *list) {
+    int formats = 0;
+    while (*list) {
+        size_t length = strcspn(list, ",");
+        if (length == 4 && strncmp(list, "text", 4) == 0) {
+            formats |= OUTPUT_TEXT;
+        } else if (length == 3 && strncmp(list, "csv", 3) == 0) {
+            formats |= OUTPUT_CSV;
+        } else if (length == 4 && strncmp(list, "json", 4) == 0) {
+            formats |= OUTPUT_JSON;
+        } else {
+            return 0;
+        }
+        list += length;
+        if (*list == ',') list++;
+    }
+    return formats;
+}
+
+// Batch mode: solve every --department=NAME:FILE[:SECTIONS] together and
+// write each one's files to the directory NAME
+int runBatch(const SolverOptions *options, const char **specs, int count, int sections, int formats,
+             const char *gridFile) {
+    SchedulerBatch *batch = schedulerBatchInit(options);
+    if (!batch) {
+        printf("ERROR: Out of memory\n");
+        return 1;
+    }
+    if (gridFile && schedulerBatchLoadGrid(batch, gridFile) != 0) {
+        schedulerBatchFree(batch);
+        return 1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        char spec[4096];
+        snprintf(spec, sizeof(spec), "%s", specs[i]);
+        char *file = strchr(spec, ':');
+        if (!file || file == spec || memchr(spec, '/', file - spec)) {
+            printf("ERROR: Invalid --department=%s (expected NAME:FILE[:SECTIONS])\n", specs[i]);
+            schedulerBatchFree(batch);
+            return 1;
+        }
+        *file++ = '\0';
+        int departmentSections = sections;
+        char *last = strrchr(file, ':');
+        if (last && last[1] && strspn(last + 1, "0123456789") == strlen(last + 1)) {
+            *last = '\0';
+            departmentSections = atoi(last + 1);
+        }
+        if (schedulerBatchAdd(batch, spec, file, departmentSections) < 0) {
+            printf("\nERROR: Could not load department %s from %s\n", spec, file);
+            schedulerBatchFree(batch);
+            return 1;
+        }
+    }
+    
+    schedulerBatchSolve(batch);
+    schedulerBatchWriteOutputs(batch, formats);
+    
+    for (int d = 0; d < schedulerBatchCount(batch); d++) {
+        SchedulerContext *ctx = schedulerBatchContext(batch, d);
+        printf("Department %s: wave %d, %d subjects, %d unplaced occurrence(s)\n",
+               schedulerBatchName(batch, d), schedulerBatchWave(batch, d) + 1,
+               ctx->subjectCount, schedulerUnplaced(ctx));
+    }
+    schedulerBatchFree(batch);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    SolverOptions options;
+    schedulerDefaultOptions(&options);
+    options.verbose = LOG_DEBUG;
+    int sections = DEFAULT_SECTIONS;
+    const char *inputFile = NULL;
+    int formats = OUTPUT_TEXT;
+    const char *compileFile = NULL;
+    const char *saveFile = NULL;
+    const char *repairFile = NULL;
+    const char *unavailable[argc];
+    int unavailableCount = 0;
+    const char *statsFile = NULL;
+    const char *gridFile = NULL;
+    const char *departments[argc];
+    int departmentCount = 0;
+    const char *daemonSocket = NULL;
+    const char *verifyFile = NULL;
+    const char *diffFiles = NULL;
+    const char *decisionLog = NULL;
+    const char *replayFile = NULL;
+    int workers = 0;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--solver=greedy") == 0) {
+            options.solver = SOLVER_GREEDY;
+        } else if (strcmp(argv[i], "--solver=backtrack") == 0) {
+            options.solver = SOLVER_BACKTRACK;
+        } else if (strcmp(argv[i], "--solver=sat") == 0) {
+            options.solver = SOLVER_SAT;
+        } else if (strcmp(argv[i], "--order=dsatur") == 0) {
+            options.ordering = ORDER_DSATUR;
+        } else if (strcmp(argv[i], "--order=degree") == 0) {
+            options.ordering = ORDER_DEGREE;
+        } else if (strcmp(argv[i], "--order=duration") == 0) {
+            options.ordering = ORDER_DURATION;
+        } else if (strncmp(argv[i], "--max-nodes=", 12) == 0) {
+            options.maxNodes = atol(argv[i] + 12);
+        } else if (strncmp(argv[i], "--time-limit=", 13) == 0) {
+            options.timeLimit = atof(argv[i] + 13);
+        } else if (strncmp(argv[i], "--anytime=", 10) == 0) {
+            options.anytime = atof(argv[i] + 10);
+        } else if (strcmp(argv[i], "--portfolio") == 0) {
+            // One thread per online core
+            long cores = sysconf(_SC_NPROCESSORS_ONLN);
+            options.threads = cores > 1 ? (int)cores : 2;
+        } else if (strncmp(argv[i], "--portfolio=", 12) == 0) {
+            options.threads = atoi(argv[i] + 12);
+        } else if (strncmp(argv[i], "--attempts=", 11) == 0) {
+            options.attempts = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--sections=", 11) == 0) {
+            sections = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--optimize=", 11) == 0) {
+            options.optimizeMoves = atol(argv[i] + 11);
+        } else if (strncmp(argv[i], "--lns=", 6) == 0) {
+            options.lnsRounds = atol(argv[i] + 6);
+        } else if (strncmp(argv[i], "--format=", 9) == 0) {
+            formats = parseFormats(argv[i] + 9);
+            if (formats == 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--input=", 8) == 0) {
+            inputFile = argv[i] + 8;
+        } else if (strncmp(argv[i], "--compile=", 10) == 0) {
+            compileFile = argv[i] + 10;
+        } else if (strncmp(argv[i], "--save=", 7) == 0) {
+            saveFile = argv[i] + 7;
+        } else if (strncmp(argv[i], "--repair=", 9) == 0) {
+            repairFile = argv[i] + 9;
+        } else if (strncmp(argv[i], "--unavailable=", 14) == 0) {
+            unavailable[unavailableCount++] = argv[i] + 14;
+        } else if (strncmp(argv[i], "--grid=", 7) == 0) {
+            gridFile = argv[i] + 7;
+        } else if (strncmp(argv[i], "--department=", 13) == 0) {
+            departments[departmentCount++] = argv[i] + 13;
+        } else if (strncmp(argv[i], "--daemon=", 9) == 0) {
+            daemonSocket = argv[i] + 9;
+        } else if (strncmp(argv[i], "--workers=", 10) == 0) {
+            workers = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--verify=", 9) == 0) {
+            verifyFile = argv[i] + 9;
+        } else if (strncmp(argv[i], "--diff=", 7) == 0) {
+            diffFiles = argv[i] + 7;
+        } else if (strncmp(argv[i], "--seed=", 7) == 0) {
+            options.seed = strtoull(argv[i] + 7, NULL, 10);
+        } else if (strncmp(argv[i], "--decision-log=", 15) == 0) {
+            decisionLog = argv[i] + 15;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replayFile = argv[i] + 9;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            options.verbose = LOG_QUIET;
+        } else if (strncmp(argv[i], "--log-level=", 12) == 0) {
+            options.verbose = atoi(argv[i] + 12);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            statsFile = "-";
+        } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+            statsFile = argv[i] + 8;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    LOG(options.verbose, LOG_INFO, "Timetable Generator starting...\n");
+    if (diffFiles) {
+        // Exit like diff(1): 0 when the solutions match, 1 when they differ
+        char oldFile[4096];
+        snprintf(oldFile, sizeof(oldFile), "%s", diffFiles);
+        char *newFile = strchr(oldFile, ':');
+        if (!newFile || newFile == oldFile || newFile[1] == '\0') {
+            printf("ERROR: Invalid --diff=%s (expected OLD:NEW)\n", diffFiles);
+            return 2;
+        }
+        *newFile++ = '\0';
+        int differences = schedulerDiff(oldFile, newFile);
+        return differences < 0 ? 2 : differences > 0;
+    }
+    if (daemonSocket) {
+        return schedulerServe(daemonSocket, &options, gridFile, workers) == 0 ? 0 : 1;
+    }
+    if (departmentCount > 0) {
+        return runBatch(&options, departments, departmentCount, sections, formats, gridFile);
+    }
+    
+    // Read subjects - try different possible filenames
+    const char* filenames[] = {
+        "Subjects.txt",
+        "subjects.txt",
+        "Subjects .txt", // Note the space
+        "../Subjects.txt",
+        "./Subjects.txt"
+    };
+    
+    SchedulerContext *ctx = schedulerInit(&options);
+    if (!ctx) {
+        printf("ERROR: Out of memory\n");
+        return 1;
+    }
+    if (schedulerSetSections(ctx, sections) != 0) {
+        printUsage(argv[0]);
+        schedulerFree(ctx);
+        return 1;
+    }
+    if (LOG_ENABLED(options.verbose, LOG_INFO)) {
+        schedulerSetProgress(ctx, printProgress, 0.25, NULL);
+    }
+    if (gridFile && schedulerLoadGrid(ctx, gridFile) != 0) {
+        schedulerFree(ctx);
+        return 1;
+    }
+    if (decisionLog && schedulerSetDecisionLog(ctx, decisionLog) != 0) {
+        printf("ERROR: Out of memory\n");
+        schedulerFree(ctx);
+        return 1;
+    }
+    
+    int file_found = 0;
+    if (inputFile) {
+        file_found = schedulerLoadFile(ctx, inputFile) >= 0;
+    }
+    for (int i = 0; i < 5 && !file_found && !inputFile; i++) {
+        FILE *test = fopen(filenames[i], "r");
+        if (test) {
+            fclose(test);
+            LOG(options.verbose, LOG_INFO, "Found file: %s\n", filenames[i]);
+            file_found = schedulerLoadFile(ctx, filenames[i]) >= 0;
+        }
+    }
+    
+    if (!file_found && inputFile) {
+        printf("\nERROR: Could not load %s\n", inputFile);
+        schedulerFree(ctx);
+        return 1;
+    }
+    if (!file_found) {
+        printf("\nERROR: Could not find Subjects.txt file!\n");
+        printf("Please ensure the file exists in the current directory.\n");
+        printf("Current working directory is: ");
+        char cwd[256];
+        if (getcwd(cwd, sizeof(cwd)) != NULL) {
+            printf("%s\n", cwd);
+        } else {
+            printf("unknown\n");
+        }
+        schedulerFree(ctx);
+        return 1;
+    }
+    
+    if (ctx->subjectCount == 0) {
+        printf("No subjects were read from the file. Exiting.\n");
+        schedulerFree(ctx);
+        return 1;
+    }
+    
+    LOG(options.verbose, LOG_INFO, "Successfully read %d subjects from file\n", ctx->subjectCount);
+    
+    if (compileFile) {
+        if (schedulerCompile(ctx, compileFile) != 0) {
+            schedulerFree(ctx);
+            return 1;
+        }
+        printf("Compiled instance written to %s\n", compileFile);
+        schedulerFree(ctx);
+        return 0;
+    }
+    
+    for (int i = 0; i < unavailableCount; i++) {
+        if (applyUnavailable(ctx, unavailable[i]) != 0) {
+            printf("ERROR: Invalid --unavailable=%s (unknown faculty, day or slot)\n", unavailable[i]);
+            schedulerFree(ctx);
+            return 1;
+        }
+    }
+    
+    if (verifyFile) {
+        int violations = schedulerVerify(ctx, verifyFile);
+        schedulerFree(ctx);
+        return violations != 0;
+    }
+    
+    // Generate the timetable, rebuild it from a decision log, or repair a
+    // previous one after an input change
+    if (replayFile) {
+        // A trailing :STEPS stops the replay after that many records
+        char logFile[4096];
+        snprintf(logFile, sizeof(logFile), "%s", replayFile);
+        long steps = -1;
+        char *colon = strrchr(logFile, ':');
+        if (colon && colon[1] != '\0' && strspn(colon + 1, "0123456789") == strlen(colon + 1)) {
+            *colon = '\0';
+            steps = atol(colon + 1);
+        }
+        if (schedulerReplay(ctx, logFile, steps) < 0) {
+            schedulerFree(ctx);
+            return 1;
+        }
+    } else if (repairFile) {
+        if (schedulerLoadSolution(ctx, repairFile) < 0) {
+            schedulerFree(ctx);
+            return 1;
+        }
+        schedulerRepair(ctx);
+    } else {
+        schedulerSolve(ctx);
+    }
+    
+    if (saveFile && schedulerSaveSolution(ctx, saveFile) == 0) {
+        LOG(options.verbose, LOG_INFO, "Solution saved to %s\n", saveFile);
+    }
+    
+    // Generate output files
+    schedulerWriteOutputs(ctx, formats);
+    
+    LOG(options.verbose, LOG_INFO, "Timetable generation completed successfully!\n");
+    
+    if (statsFile) schedulerWriteStats(ctx, statsFile);
+    
+    schedulerFree(ctx);
+    return 0;
+}
+
+#endif // TIMETABLE_LIBRARY
\ No newline at end of file
@@ -0,0 +1,300 @@
+#ifndef TIMETABLE_H
+#define TIMETABLE_H
+
+// Library interface of the timetable generator.
+//
+// All state lives in a SchedulerContext, so one process can load and solve
+// several department instances at the same time (one context per instance,
+// one thread per context). A context keeps its parsed input and its
+// allocations between solves; call schedulerSolve() again to re-generate.
+//
+// Build the library by compiling maincode.c with -DTIMETABLE_LIBRARY, which
+// leaves out the command-line main().
+
+#include <stddef.h>
+
+typedef struct SchedulerContext SchedulerContext;
+typedef struct SchedulerBatch SchedulerBatch;
+
+// Solver used for the required occurrences
+enum {
+    SOLVER_GREEDY,    // Single randomized pass in priority order
+    SOLVER_BACKTRACK, // Complete search with a node/time budget
+    SOLVER_SAT        // CNF encoding and a built-in CDCL solver; maxNodes limits conflicts, core shrinking included
+};
+
+// Order in which the greedy solver places (subject, section) units
+enum {
+    ORDER_DSATUR,   // Fewest spare start cells first, re-ranked after every placement
+    ORDER_DEGREE,   // Most hours competing for the same faculty first
+    ORDER_DURATION  // Longest subjects first, then by weekly occurrences
+};
+
+// Result of schedulerSolve()
+enum {
+    SOLVE_FEASIBLE,         // Every required occurrence was placed
+    SOLVE_INFEASIBLE,       // Proven impossible by the backtracking solver
+    SOLVE_BUDGET_EXHAUSTED, // Backtracking ran out of nodes or time
+    SOLVE_INCOMPLETE        // The greedy pass left occurrences unplaced
+};
+
+// Output formats for schedulerWriteOutputs(), combined with |
+enum {
+    OUTPUT_TEXT = 1,  // sectionIT-A_timetable.txt, ... and faculty_workload.txt
+    OUTPUT_CSV = 2,   // timetable.csv and faculty_workload.csv
+    OUTPUT_JSON = 4   // timetable.json
+};
+
+// Log levels for SolverOptions.verbose. Builds with
+// -DTIMETABLE_MAX_LOG_LEVEL=LOG_QUIET (or LOG_INFO) compile the more
+// detailed messages out of the solver loops.
+enum {
+    LOG_QUIET,  // Errors and warnings only
+    LOG_INFO,   // Progress and a summary of every phase
+    LOG_DEBUG   // Every parsed field and every placement
+};
+
+typedef struct {
+    int solver;             // SOLVER_*
+    int ordering;           // ORDER_* used by the greedy solver
+    long maxNodes;          // Backtracking node limit
+    double timeLimit;       // Backtracking wall-clock limit in seconds
+    int threads;            // Portfolio threads; 1 runs a single attempt
+    int attempts;           // Portfolio attempts in total
+    long optimizeMoves;     // Local-search moves on the soft objective (0 = off)
+    long lnsRounds;         // Destroy/repair rounds when the solver leaves occurrences unplaced (0 = off)
+    double anytime;         // Anytime budget in seconds (0 = off); maxNodes then covers all attempts
+    unsigned long long seed; // Random seed; 0 seeds from the clock
+    int verbose;            // LOG_* level of the messages printed to stdout
+} SolverOptions;
+
+// Progress of an anytime solve, passed to the progress callback
+typedef struct {
+    double elapsed;         // Seconds since the solve started
+    int attempts;           // Construction attempts finished
+    long nodes;             // Backtracking nodes used by all attempts
+    int unplaced;           // Required occurrences missing from the best timetable
+    long softCost;          // Soft cost of the best timetable
+    int improved;           // The best timetable changed since the previous call
+    int done;               // Last call of this solve
+} SchedulerProgress;
+
+// Called on the solving thread. While it runs, the context holds the best
+// timetable so far, which the callback may read, save or write out
+// (schedulerSaveSolution(), schedulerWriteOutputs()). Return nonzero to
+// stop the solve and keep that timetable.
+typedef int (*SchedulerProgressCallback)(const SchedulerProgress *progress, void *userData);
+
+// Fill in the default options
+void schedulerDefaultOptions(SolverOptions *options);
+
+// Create an empty context; options may be NULL for the defaults.
+// Returns NULL when out of memory.
+SchedulerContext *schedulerInit(const SolverOptions *options);
+
+// Replace the options used by the next schedulerSolve()
+void schedulerSetOptions(SchedulerContext *ctx, const SolverOptions *options);
+
+// Set the number of sections (default 3, named IT-A, IT-B, ...).
+// Returns 0, or -1 when count is not positive or out of memory.
+int schedulerSetSections(SchedulerContext *ctx, int count);
+
+// Read subjects in the Subjects.txt format or a compiled instance written by
+// schedulerCompile(), replacing any previous input. Text lines are
+// "NAME,DURATION,FACULTY;FACULTY[,key=value...]" (DURATION is 1 to 4 slots)
+// with the optional fields occurrences=N, section=IT-B and
+// room=lab|classroom, or directives:
+//   @sections N
+//   @unavailable FACULTY@DAY[:SLOT[-SLOT]]
+//   @pin SECTION,DAY,SLOT,SUBJECT
+//   @room NAME,lab|classroom
+// and the grid directives of schedulerLoadGrid(), which change the grid for
+// this input only. Returns the number of subjects read, or -1 if the file
+// cannot be opened or is invalid.
+int schedulerLoadFile(SchedulerContext *ctx, const char *filename);
+
+// Read subjects text in the format of schedulerLoadFile() from memory,
+// replacing any previous input. The text is copied. Returns the number of
+// subjects read, or -1 if the input is invalid.
+int schedulerLoadText(SchedulerContext *ctx, const char *text, size_t length);
+
+// Read the calendar grid that later input starts from (by default Monday
+// to Saturday, seven slots from 9:40 with lunch as the 4th). The file has
+// one directive per line, applied to the default grid:
+//   @days NAME,NAME,...      the days of the week (at most 7)
+//   @slots LABEL,LABEL,...   the slots of a day (at most 16, and at most
+//                            64 cells in the whole week)
+//   @break SLOT[,NAME]       a slot that is a break on every day
+//   @dayslots DAY,N          a day that only has its first N slots
+// Returns 0, or -1 if the file cannot be read or the grid is invalid.
+int schedulerLoadGrid(SchedulerContext *ctx, const char *filename);
+
+// Validate the loaded input and write it as a compiled instance, which
+// schedulerLoadFile() maps without parsing. Returns 0, or -1 if the input
+// has errors or the file cannot be written.
+int schedulerCompile(const SchedulerContext *ctx, const char *filename);
+
+// Generate a timetable for the loaded input; returns one of SOLVE_*
+int schedulerSolve(SchedulerContext *ctx);
+
+// Report the progress of anytime solves (options.anytime > 0) to callback
+// at most every interval seconds, between attempts and annealing rounds,
+// and once when the budget expires. A NULL callback turns reports off.
+void schedulerSetProgress(SchedulerContext *ctx, SchedulerProgressCallback callback,
+                          double interval, void *userData);
+
+// Placement checks made by the last solve: evaluations of every start cell
+// of one occurrence against the section and faculty masks, summed over
+// all portfolio attempts
+long schedulerPlacementChecks(const SchedulerContext *ctx);
+
+// Weighted soft cost of the current timetable (gaps, spread, faculty daily
+// overload and load balance); lower is better
+long schedulerSoftCost(const SchedulerContext *ctx);
+
+// Mark a faculty member unavailable on a day (0 = the grid's first) in one slot
+// (0-based, or -1 for the whole day). Blackouts apply to every later solve
+// or repair and are cleared when new input is loaded. Returns 0, or -1 for
+// an unknown faculty member or cell.
+int schedulerBlockFaculty(SchedulerContext *ctx, const char *faculty, int day, int slot);
+
+// Write the last timetable as CSV lines "section,day,slot,subject".
+// Returns 0, or -1 if the file cannot be written.
+int schedulerSaveSolution(const SchedulerContext *ctx, const char *filename);
+
+// Load a saved solution against the current input and blackouts, keeping
+// every placement that still fits. Returns the number kept, or -1 if the
+// file cannot be read.
+int schedulerLoadSolution(SchedulerContext *ctx, const char *filename);
+
+// Check a solution file (schedulerSaveSolution() lines, or any CSV with
+// section, day, slot and subject columns such as timetable.csv) against the
+// loaded input and blackouts, printing one VIOLATION line per broken hard
+// constraint and a summary. Extra occurrences are allowed; missing required
+// ones are counted but are not violations. Returns the number of
+// violations, or -1 if the file cannot be read.
+int schedulerVerify(const SchedulerContext *ctx, const char *filename);
+
+// Print the placements that moved, were removed or were added between two
+// solution files, and a summary. Needs no input. Returns the number of
+// differences, or -1 if a file cannot be read.
+int schedulerDiff(const char *oldFile, const char *newFile);
+
+// Place the required occurrences missing from the loaded solution, moving
+// as few of the existing placements as possible; returns one of SOLVE_*
+int schedulerRepair(SchedulerContext *ctx);
+
+// Required occurrences left unplaced by the last solve
+int schedulerUnplaced(const SchedulerContext *ctx);
+
+// Hours a faculty member teaches in the last timetable on a day (0 = the
+// grid's first), or in the whole week for day -1. Returns -1 for an unknown
+// faculty member or day.
+int schedulerFacultyHours(const SchedulerContext *ctx, const char *faculty, int day);
+
+// Subject a faculty member teaches in a cell of the last timetable (day and
+// slot 0-based), storing the 0-based section in *section if that is not
+// NULL. Returns NULL when the faculty member is free there or unknown.
+// Both queries read the schedule's faculty index and take constant time.
+const char *schedulerFacultyClass(const SchedulerContext *ctx, const char *faculty, int day, int slot, int *section);
+
+// Seed of the last solve or repair: options.seed, or the one taken from the
+// clock when that is 0. Solving again with it as options.seed repeats a
+// single-attempt run exactly (portfolio and anytime runs depend on timing).
+unsigned long long schedulerSeed(const SchedulerContext *ctx);
+
+// Log every decision of later solves and repairs to filename (NULL turns
+// logging off): each placement, removal and rejected start, resets to the
+// pins and a checkpoint whenever a better attempt replaces the timetable.
+// The log is a compact binary file of a few bytes per decision. Returns 0,
+// or -1 when out of memory.
+int schedulerSetDecisionLog(SchedulerContext *ctx, const char *filename);
+
+// Rebuild the timetable from the first steps records (all if steps < 0) of
+// a decision log written for the loaded input, checking that every record
+// repeats. The outputs then show the solver state after that step.
+// Returns the number of records replayed, or -1 if the log cannot be read
+// or diverges from the input.
+long schedulerReplay(SchedulerContext *ctx, const char *filename, long steps);
+
+// Faculty members named by the unsat core of the last SOLVER_SAT solve
+// that proved the input infeasible (none otherwise): the core is a
+// minimal set of constraint groups that cannot all hold, and these are the
+// faculty members whose one-class-at-a-time rule and blackouts are in it
+int schedulerCoreFacultyCount(const SchedulerContext *ctx);
+const char *schedulerCoreFaculty(const SchedulerContext *ctx, int index);
+
+// Write the section timetables and the faculty workload report to the
+// current directory
+void schedulerWriteFiles(SchedulerContext *ctx);
+
+// Write the given OUTPUT_* formats to the current directory.
+// Returns 0, or -1 if any file could not be written.
+int schedulerWriteOutputs(SchedulerContext *ctx, int formats);
+
+// Write the counters and phase timings of the last load, solve and write
+// as one JSON object ("-" writes to stdout). The rejection counters are
+// zero in builds with -DTIMETABLE_STATS=0. Returns 0, or -1 if the file
+// cannot be written.
+int schedulerWriteStats(const SchedulerContext *ctx, const char *filename);
+
+// Write later output files into directory (NULL = the current directory).
+// The directory must exist. Returns 0, or -1 when out of memory.
+int schedulerSetOutputDirectory(SchedulerContext *ctx, const char *directory);
+
+// Release the context and everything it owns
+void schedulerFree(SchedulerContext *ctx);
+
+// Batch mode: several departments, one context each, whose faculty members
+// are matched by name. Departments that share no faculty are solved in
+// parallel; departments that do are solved in waves, and each wave treats
+// the cells earlier waves booked for a shared faculty member as blocked.
+
+// Create an empty batch; options (NULL for the defaults) apply to every
+// department. Returns NULL when out of memory.
+SchedulerBatch *schedulerBatchInit(const SolverOptions *options);
+
+// Read the grid that departments added later start from (see
+// schedulerLoadGrid()). Returns 0, or -1 if the grid cannot be read.
+int schedulerBatchLoadGrid(SchedulerBatch *batch, const char *filename);
+
+// Load a department's input with the given number of sections. Its output
+// files go to a directory named after it. Departments added earlier get
+// the earlier waves. Returns the department index, or -1 if the input
+// cannot be loaded or its grid differs from the first department's.
+int schedulerBatchAdd(SchedulerBatch *batch, const char *name, const char *filename, int sections);
+
+// Solve every department. Returns SOLVE_FEASIBLE when all of them are
+// complete, otherwise the SOLVE_* result of the first one that is not.
+int schedulerBatchSolve(SchedulerBatch *batch);
+
+// Departments in the batch, and the context, name and wave (0-based) of one
+int schedulerBatchCount(const SchedulerBatch *batch);
+SchedulerContext *schedulerBatchContext(SchedulerBatch *batch, int department);
+const char *schedulerBatchName(const SchedulerBatch *batch, int department);
+int schedulerBatchWave(const SchedulerBatch *batch, int department);
+
+// Create every department's directory and write its OUTPUT_* formats there.
+// Returns 0, or -1 if any file could not be written.
+int schedulerBatchWriteOutputs(SchedulerBatch *batch, int formats);
+
+// Release the batch and every department's context
+void schedulerBatchFree(SchedulerBatch *batch);
+
+// Daemon mode: serve requests on the Unix domain socket socketPath until a
+// client sends SHUTDOWN. Instances are kept by name with their parsed
+// input and last timetable, so edits are followed by a re-solve or repair
+// without parsing again. One request line each, answered with "OK ..." or
+// "ERROR message":
+//   LOAD NAME PATH, SUBMIT NAME BYTES (then BYTES bytes of subjects text),
+//   SECTIONS NAME N, UNAVAILABLE NAME FACULTY@DAY[:SLOT[-SLOT]],
+//   SOLVE NAME, REPAIR NAME, GET NAME, DROP NAME, LIST, SHUTDOWN
+// SOLVE, REPAIR and GET reply "OK STATUS UNPLACED LINES" and then LINES
+// lines of "section,day,slot,subject". options (NULL for the defaults)
+// apply to every instance, gridFile (NULL for the default grid) is the
+// grid they start from, and workers (< 1 for one per core) connections
+// are served at a time. SIGPIPE is ignored from then on. Returns 0 after
+// SHUTDOWN, or -1 if the socket or the grid cannot be set up.
+int schedulerServe(const char *socketPath, const SolverOptions *options, const char *gridFile, int workers);
+
+#endif